@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include "save_state.h"
 #include "utils.h"
 
 using namespace gbemu;
@@ -398,10 +399,8 @@ unsigned GetReloadedTimerValue(unsigned divider, unsigned shift) {
 }  // namespace
 
 void Apu::NoiseChannel::StepFrequencyTimer() {
-  static unsigned timer = GetReloadedTimerValue(clock_divider_, clock_shift_);
-
-  if (--timer == 0) {
-    timer = GetReloadedTimerValue(clock_divider_, clock_shift_);
+  if (--timer_ == 0) {
+    timer_ = GetReloadedTimerValue(clock_divider_, clock_shift_);
 
     unsigned xor_result = (lfsr_ & 1) ^ ((lfsr_ & 0b10) >> 1);
     lfsr_ &= ~(1 << 15);
@@ -499,10 +498,11 @@ void Apu::Step() {
     }
   }
 
-  static int sample_counter = 95;
-  if (--sample_counter == 0) {
-    sample_counter = 95;
-    PushSample();
+  if (--sample_counter_ == 0) {
+    sample_counter_ = kSampleInterval;
+    if (is_output_enabled_) {
+      PushSample();
+    }
   }
 }
 
@@ -543,3 +543,155 @@ void Apu::PushSample() {
 
   audio_.PushSample(left_sample, right_sample);
 }
+
+void Apu::FrameSequencer::SaveState(StateWriter& writer) const {
+  writer.Write(static_cast<std::uint32_t>(timer_));
+  writer.Write(static_cast<std::uint32_t>(pos_));
+}
+
+void Apu::FrameSequencer::LoadState(StateReader& reader) {
+  timer_ = reader.Read<std::uint32_t>();
+  pos_ = reader.Read<std::uint32_t>();
+}
+
+void Apu::FrequencyTimer::SaveState(StateWriter& writer) const {
+  writer.Write(static_cast<std::uint32_t>(frequency_));
+  writer.Write(static_cast<std::uint32_t>(frequency_timer_));
+}
+
+void Apu::FrequencyTimer::LoadState(StateReader& reader) {
+  frequency_ = reader.Read<std::uint32_t>() & 0x7FF;
+  frequency_timer_ = reader.Read<std::uint32_t>();
+}
+
+void Apu::Envelope::SaveState(StateWriter& writer) const {
+  writer.Write(static_cast<std::uint32_t>(initial_volume_));
+  writer.Write(is_upward_);
+  writer.Write(static_cast<std::uint32_t>(period_));
+  writer.Write(static_cast<std::uint32_t>(current_volume_));
+  writer.Write(static_cast<std::uint32_t>(period_timer_));
+}
+
+void Apu::Envelope::LoadState(StateReader& reader) {
+  initial_volume_ = reader.Read<std::uint32_t>();
+  is_upward_ = reader.Read<bool>();
+  period_ = reader.Read<std::uint32_t>();
+  current_volume_ = reader.Read<std::uint32_t>();
+  period_timer_ = reader.Read<std::uint32_t>();
+}
+
+void Apu::LengthTimer::SaveState(StateWriter& writer) const {
+  writer.Write(is_enabled_);
+  writer.Write(static_cast<std::uint32_t>(timer_));
+}
+
+void Apu::LengthTimer::LoadState(StateReader& reader) {
+  is_enabled_ = reader.Read<bool>();
+  timer_ = reader.Read<std::uint32_t>();
+}
+
+void Apu::Sweep::SaveState(StateWriter& writer) const {
+  writer.Write(static_cast<std::uint32_t>(period_));
+  writer.Write(is_decrementing_);
+  writer.Write(static_cast<std::uint32_t>(shift_amount_));
+  writer.Write(static_cast<std::uint32_t>(current_frequency_));
+  writer.Write(static_cast<std::uint32_t>(timer_));
+}
+
+void Apu::Sweep::LoadState(StateReader& reader) {
+  period_ = reader.Read<std::uint32_t>();
+  is_decrementing_ = reader.Read<bool>();
+  shift_amount_ = reader.Read<std::uint32_t>();
+  current_frequency_ = reader.Read<std::uint32_t>();
+  timer_ = reader.Read<std::uint32_t>();
+}
+
+void Apu::PulseChannel::SaveState(StateWriter& writer) const {
+  sweep_.SaveState(writer);
+  length_timer_.SaveState(writer);
+  envelope_.SaveState(writer);
+  frequency_timer_.SaveState(writer);
+  writer.Write(is_enabled_);
+  writer.Write(is_dac_enabled_);
+  writer.Write(static_cast<std::uint32_t>(wave_duty_pattern_));
+  writer.Write(static_cast<std::uint32_t>(wave_duty_position_));
+}
+
+void Apu::PulseChannel::LoadState(StateReader& reader) {
+  sweep_.LoadState(reader);
+  length_timer_.LoadState(reader);
+  envelope_.LoadState(reader);
+  frequency_timer_.LoadState(reader);
+  is_enabled_ = reader.Read<bool>();
+  is_dac_enabled_ = reader.Read<bool>();
+  wave_duty_pattern_ = reader.Read<std::uint32_t>() & 0b11;
+  wave_duty_position_ = reader.Read<std::uint32_t>() & 0b111;
+}
+
+void Apu::WaveChannel::SaveState(StateWriter& writer) const {
+  length_timer_.SaveState(writer);
+  frequency_timer_.SaveState(writer);
+  writer.Write(is_enabled_);
+  writer.Write(is_dac_enabled_);
+  writer.Write(static_cast<std::uint8_t>(volume_));
+  writer.Write(static_cast<std::uint32_t>(wave_position_));
+}
+
+void Apu::WaveChannel::LoadState(StateReader& reader) {
+  length_timer_.LoadState(reader);
+  frequency_timer_.LoadState(reader);
+  is_enabled_ = reader.Read<bool>();
+  is_dac_enabled_ = reader.Read<bool>();
+  volume_ = static_cast<Volume>(reader.Read<std::uint8_t>() & 0b11);
+  wave_position_ = reader.Read<std::uint32_t>() & 31;
+}
+
+void Apu::NoiseChannel::SaveState(StateWriter& writer) const {
+  length_timer_.SaveState(writer);
+  envelope_.SaveState(writer);
+  writer.Write(lfsr_);
+  writer.Write(is_enabled_);
+  writer.Write(is_dac_enabled_);
+  writer.Write(static_cast<std::uint32_t>(clock_divider_));
+  writer.Write(static_cast<std::uint32_t>(clock_shift_));
+  writer.Write(static_cast<std::uint8_t>(lfsr_width_));
+  writer.Write(static_cast<std::uint32_t>(timer_));
+}
+
+void Apu::NoiseChannel::LoadState(StateReader& reader) {
+  length_timer_.LoadState(reader);
+  envelope_.LoadState(reader);
+  lfsr_ = reader.Read<std::uint16_t>();
+  is_enabled_ = reader.Read<bool>();
+  is_dac_enabled_ = reader.Read<bool>();
+  clock_divider_ = reader.Read<std::uint32_t>();
+  clock_shift_ = reader.Read<std::uint32_t>();
+  lfsr_width_ = reader.Read<std::uint8_t>() ? kLfsr7Bit : kLfsr15Bit;
+  timer_ = reader.Read<std::uint32_t>();
+}
+
+void Apu::SaveState(StateWriter& writer) const {
+  writer.Write(nr50_.get());
+  writer.Write(nr51_.get());
+  writer.WriteBytes(wave_ram_.data(), wave_ram_.size());
+  writer.Write(is_apu_enabled_);
+  writer.Write(static_cast<std::int32_t>(sample_counter_));
+  frame_sequencer_.SaveState(writer);
+  channel1_.SaveState(writer);
+  channel2_.SaveState(writer);
+  channel3_.SaveState(writer);
+  channel4_.SaveState(writer);
+}
+
+void Apu::LoadState(StateReader& reader) {
+  nr50_.set(reader.Read<std::uint8_t>());
+  nr51_.set(reader.Read<std::uint8_t>());
+  reader.ReadBytes(wave_ram_.data(), wave_ram_.size());
+  is_apu_enabled_ = reader.Read<bool>();
+  sample_counter_ = reader.Read<std::int32_t>();
+  frame_sequencer_.LoadState(reader);
+  channel1_.LoadState(reader);
+  channel2_.LoadState(reader);
+  channel3_.LoadState(reader);
+  channel4_.LoadState(reader);
+}
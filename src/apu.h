@@ -4,13 +4,14 @@
 #include <array>
 #include <cstdint>
 
-#include "audio.h"
+#include "audio_sink.h"
+#include "save_state.h"
 
 namespace gbemu {
 
 class Apu {
  public:
-  Apu(Audio& audio) : channel3_(wave_ram_), audio_(audio) {}
+  Apu(AudioSink& audio) : channel3_(wave_ram_), audio_(audio) {}
   std::uint8_t get_nr10() const { return channel1_.GetNrX0(); }
   std::uint8_t get_nr11() const { return channel1_.GetNrX1(); }
   std::uint8_t get_nr12() const { return channel1_.GetNrX2(); }
@@ -138,6 +139,22 @@ class Apu {
 
   void Run(unsigned tcycles);
 
+  // サンプルを出力するかどうか設定する。
+  // 無効にしてもサンプルを出力しないだけで、APUの状態は同じように進む。
+  void set_output_enabled(bool enabled) { is_output_enabled_ = enabled; }
+
+  // 状態をセーブステートに書き出す。
+  void SaveState(StateWriter& writer) const;
+  // セーブステートから状態を復元する。
+  void LoadState(StateReader& reader);
+
+  // サンプルを出力する間隔（T-cycle数）
+  static constexpr int kSampleInterval = 95;
+  // 出力するサンプルのレート（Hz）を整数に丸めたもの。
+  // T-cycleのクロック（4194304Hz）をサンプルを出力する間隔で割って求める。
+  static constexpr unsigned kSampleRate =
+      (4194304 + kSampleInterval / 2) / kSampleInterval;
+
  private:
   class Nr50 {
    public:
@@ -186,6 +203,9 @@ class Apu {
       return false;
     }
 
+    void SaveState(StateWriter& writer) const;
+    void LoadState(StateReader& reader);
+
    private:
     // 8192 T-cycleをカウントするタイマー
     unsigned timer_{8192};
@@ -230,6 +250,10 @@ class Apu {
       return false;
     }
 
+    // dots_per_clock_はコンストラクタで決まるので書き出さない
+    void SaveState(StateWriter& writer) const;
+    void LoadState(StateReader& reader);
+
    private:
     unsigned dots_per_clock_;
     unsigned frequency_{};
@@ -249,6 +273,8 @@ class Apu {
     void Step();
     // トリガー時の処理
     void Trigger();
+    void SaveState(StateWriter& writer) const;
+    void LoadState(StateReader& reader);
 
    private:
     // Envelope開始時の音量
@@ -290,6 +316,10 @@ class Apu {
       }
     }
 
+    // timer_max_value_はコンストラクタで決まるので書き出さない
+    void SaveState(StateWriter& writer) const;
+    void LoadState(StateReader& reader);
+
    private:
     bool is_enabled_{};
     unsigned timer_{};
@@ -312,6 +342,9 @@ class Apu {
     // 周波数がオーバーフローしたかどうかを返す
     bool Step();
 
+    void SaveState(StateWriter& writer) const;
+    void LoadState(StateReader& reader);
+
    private:
     unsigned CalculateNewFrequency() const;
     unsigned period_{};
@@ -338,6 +371,8 @@ class Apu {
     void SetNrX3(std::uint8_t value);
     void SetNrX4(std::uint8_t value);
     double GetDacOutput() const;
+    void SaveState(StateWriter& writer) const;
+    void LoadState(StateReader& reader);
 
    private:
     void Trigger();
@@ -372,6 +407,9 @@ class Apu {
     void StepLengthTimer();
     void StepFrequencyTimer();
     double GetDacOutput() const;
+    // Wave RAMはApuが書き出す
+    void SaveState(StateWriter& writer) const;
+    void LoadState(StateReader& reader);
 
    private:
     // NR32の設定
@@ -416,6 +454,8 @@ class Apu {
     void StepLengthTimer();
     void StepEnvelope();
     bool IsEnabled() const { return is_enabled_; }
+    void SaveState(StateWriter& writer) const;
+    void LoadState(StateReader& reader);
 
    private:
     void Trigger();
@@ -430,6 +470,9 @@ class Apu {
 
     enum LfsrWidth { kLfsr15Bit, kLfsr7Bit };
     LfsrWidth lfsr_width_{};
+
+    // LFSRを進めるまでの残りT-cycle数
+    unsigned timer_{8};
   };
 
   static const unsigned wave_duty_table[4][8];
@@ -440,9 +483,17 @@ class Apu {
 
   Nr50 nr50_{};
   Nr51 nr51_{};
-  std::array<std::uint8_t, 16> wave_ram_;
+  std::array<std::uint8_t, 16> wave_ram_{};
+
+  // ブートROM実行後の状態に合わせて有効にしておく
+  bool is_apu_enabled_{true};
+
+  // 次のサンプルを出力するまでの残りT-cycle数
+  int sample_counter_{kSampleInterval};
 
-  bool is_apu_enabled_;
+  // サンプルを出力するかどうか。エミュレーションの状態ではないので
+  // セーブステートには含めない。
+  bool is_output_enabled_{true};
 
   FrameSequencer frame_sequencer_;
   PulseChannel channel1_;
@@ -450,7 +501,7 @@ class Apu {
   WaveChannel channel3_;
   NoiseChannel channel4_;
 
-  Audio& audio_;
+  AudioSink& audio_;
 };
 
 }  // namespace gbemu
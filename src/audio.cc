@@ -2,6 +2,13 @@
 
 #include <SDL.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include "apu.h"
+#include "audio_resampler.h"
 #include "utils.h"
 
 using namespace gbemu;
@@ -13,21 +20,37 @@ void AudioCallback(void *userdata, Uint8 *_stream, int _length) {
   audio->AudioCallback(_stream, _length);
 }
 
+Sint16 ToSint16(double sample, int amplitude) {
+  return static_cast<Sint16>(
+      std::lround(std::clamp(sample, -1.0, 1.0) * amplitude));
+}
+
 };  // namespace
 
-Audio::Audio() {
+Audio::Audio() : resampler_(Apu::kSampleRate, kFreqency) {
   SDL_AudioSpec desired;
 
   desired.freq = kFreqency;
   desired.format = AUDIO_S16SYS;
   desired.channels = 2;
-  desired.samples = 2048;
+  desired.samples = 1024;
   desired.callback = ::AudioCallback;
   desired.userdata = this;
 
-  SDL_AudioSpec obtained;
+  // デバイスが対応していない形式はSDLに変換させる
+  if (SDL_OpenAudio(&desired, nullptr) < 0) {
+    Error("SDL_OpenAudio Error: %s", SDL_GetError());
+  }
+  spec_ = desired;
 
-  SDL_OpenAudio(&desired, &obtained);
+  // コールバック2回分を溜めておけば、コールバックが少し遅れても途切れない。
+  // 動的レート制御の目標は、WaitForPlaybackの直後から次のフレームの分を
+  // 積むまでの平均にする
+  wait_level_ = 2 * spec_.samples;
+  target_level_ = wait_level_ + spec_.freq / 60 / 2;
+  capacity_ = 8 * wait_level_;
+  buffer_.resize(2 * capacity_);
+  pending_.reserve(4 * kFlushInterval);
 
   SDL_PauseAudio(0);
 }
@@ -35,42 +58,92 @@ Audio::Audio() {
 Audio::~Audio() { SDL_CloseAudio(); }
 
 void Audio::PushSample(double left, double right) {
-  // 音が遅れすぎている（サンプルが過剰に溜まっている）場合、
-  // 消費されるのを待つ
-  while (samples_.size() > kMaxBufferSize) {
-    SDL_Delay(1);
+  resampler_.Push(left, right, [this](double l, double r) {
+    pending_.push_back(ToSint16(l, kAmplitude));
+    pending_.push_back(ToSint16(r, kAmplitude));
+  });
+  if (--samples_until_flush_ == 0) {
+    samples_until_flush_ = kFlushInterval;
+    Flush();
   }
+}
 
+void Audio::Flush() {
   SDL_LockAudio();
-  samples_.push_back(left);
-  samples_.push_back(right);
+  std::size_t frames = pending_.size() / 2;
+  std::size_t accepted = std::min(frames, capacity_ - size_);
+  for (std::size_t i = 0; i < accepted; i++) {
+    std::size_t index = (head_ + size_ + i) % capacity_;
+    buffer_[2 * index] = pending_[2 * i];
+    buffer_[2 * index + 1] = pending_[2 * i + 1];
+  }
+  size_ += accepted;
+  std::size_t queued = GetQueuedFrames();
+  is_started_ |= accepted != 0;
   SDL_UnlockAudio();
+
+  num_overruns_ += frames - accepted;
+  pending_.clear();
+  resampler_.set_rate_adjust(
+      ComputeRateAdjust(queued, target_level_, kMaxRateAdjust));
 }
 
-namespace {
+std::size_t Audio::GetQueuedFrames() const {
+  // デバイスに渡した分は、コールバックからの経過時間だけ再生が進んだとみなす
+  double elapsed = static_cast<double>(SDL_GetPerformanceCounter() -
+                                       last_callback_) /
+                   SDL_GetPerformanceFrequency();
+  double played = elapsed * spec_.freq;
+  std::size_t in_device = 0;
+  if (last_callback_ != 0 && played < spec_.samples) {
+    in_device = spec_.samples - static_cast<std::size_t>(played);
+  }
+  return size_ + in_device;
+}
 
-// キューの先頭要素をキューから削除したうえで返す。
-// キューが空の場合は0を返す。
-double PopSample(std::deque<double> &buf) {
-  double ret = 0.0;
-  if (!buf.empty()) {
+void Audio::set_speed(double speed) {
+  ASSERT(speed > 0, "Invalid speed.");
+  resampler_.set_input_rate(Apu::kSampleRate * speed);
+}
+
+void Audio::WaitForPlayback() {
+  Flush();
+  for (;;) {
     SDL_LockAudio();
-    ret = buf.front();
-    buf.pop_front();
+    std::size_t queued = GetQueuedFrames();
     SDL_UnlockAudio();
+    if (queued <= wait_level_) {
+      return;
+    }
+    // 目標の量まで再生されるまでの時間だけ眠る
+    Uint32 ms = (queued - wait_level_) * 1000 / spec_.freq;
+    SDL_Delay(std::max<Uint32>(ms, 1));
   }
-  return ret;
 }
 
-}  // namespace
-
 void Audio::AudioCallback(Uint8 *_stream, int _length) {
   Sint16 *stream = (Sint16 *)_stream;
   int length = _length / 2;
   ASSERT(length % 2 == 0,
          "The number of left/right samples required are mismatched.");
 
-  for (int i = 0; i < length; i++) {
-    stream[i] = kAmplitude * PopSample(samples_);
+  // コールバックの中はオーディオのロックが取られている
+  std::size_t frames = length / 2;
+  std::size_t copied = std::min(frames, size_);
+  for (std::size_t i = 0; i < copied; i++) {
+    std::size_t index = (head_ + i) % capacity_;
+    stream[2 * i] = buffer_[2 * index];
+    stream[2 * i + 1] = buffer_[2 * index + 1];
+  }
+  head_ = (head_ + copied) % capacity_;
+  size_ -= copied;
+  if (copied < frames) {
+    std::memset(stream + 2 * copied, 0,
+                (frames - copied) * 2 * sizeof(Sint16));
+    // 最初のサンプルが届く前は数えない
+    if (is_started_) {
+      num_underruns_++;
+    }
   }
+  last_callback_ = SDL_GetPerformanceCounter();
 }
@@ -3,26 +3,84 @@
 
 #include <SDL.h>
 
-#include <deque>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "audio_resampler.h"
+#include "audio_sink.h"
 
 namespace gbemu {
 
-// 外からサンプルの供給を受けて音を鳴らすクラス
-class Audio {
+// 外からサンプルの供給を受けてSDLで音を鳴らすクラス。
+// サンプルはデバイスのサンプルレートに変換してリングバッファに溜め、
+// オーディオのコールバックが取り出す。溜まっている量は動的レート制御
+// （ComputeRateAdjust）で目標に保つ。
+// PushSampleは待たない。バッファが一杯なら溢れたサンプルを捨て
+// （オーバーラン）、コールバックの時点で足りなければ無音で埋める
+// （アンダーラン）。
+class Audio : public AudioSink {
  public:
   Audio();
-  ~Audio();
+  ~Audio() override;
 
-  void PushSample(double left, double right);
+  void PushSample(double left, double right) override;
   void AudioCallback(Uint8 *_stream, int _length);
 
+  // エミュレーションの速さ（実機に対する倍率）を設定する。
+  // 垂直同期に合わせて実機と少し違う速さで進めるときに、
+  // 音のピッチが変わらないように変換の比を変える。
+  void set_speed(double speed);
+
+  // 再生待ちのサンプルが目標の量に減るまで待つ。
+  // 音の再生を基準にフレームの間隔を決めるために使う。
+  void WaitForPlayback();
+
+  // 再生待ちのサンプルが足りず、無音で埋めた回数。
+  std::uint64_t num_underruns() const { return num_underruns_; }
+  // バッファが一杯で捨てたサンプルの組数。
+  std::uint64_t num_overruns() const { return num_overruns_; }
+  // 直近の変換の比の調整量（ComputeRateAdjustを参照）。
+  double rate_adjust() const { return resampler_.rate_adjust(); }
+
  private:
+  // 変換したサンプルをリングバッファに移して、変換の比を調整する。
+  void Flush();
+  // 再生待ちのサンプルの組数を見積もる。リングバッファにあるものに、
+  // デバイスに渡したうちまだ再生していないものを加える。
+  // オーディオのロックを取った状態で呼ぶ。
+  std::size_t GetQueuedFrames() const;
+
   static constexpr int kFreqency = 44100;
   static constexpr int kAmplitude = 3000;
-  static constexpr int kMaxBufferSize = 8192;
+  // この数の入力ごとにリングバッファに移す
+  static constexpr int kFlushInterval = 256;
+  // 変換の比の調整量の上限
+  static constexpr double kMaxRateAdjust = 0.005;
+
+  SDL_AudioSpec spec_;
+  AudioResampler resampler_;
+  int samples_until_flush_{kFlushInterval};
+  // 変換したがまだリングバッファに移していないサンプル（左右を交互に格納）
+  std::vector<Sint16> pending_;
+
+  // 左右のサンプルを交互に格納するリングバッファ。
+  // buffer_[2 * head_]から順にsize_組が再生待ち。オーディオのロックで保護する
+  std::vector<Sint16> buffer_;
+  std::size_t capacity_;
+  std::size_t head_{0};
+  std::size_t size_{0};
+  // 直前にコールバックが呼ばれた時刻（SDL_GetPerformanceCounter）
+  Uint64 last_callback_{0};
 
-  // 左右の音のサンプルを交互に格納するキュー
-  std::deque<double> samples_;
+  // WaitForPlaybackが待つ目標の量（組数）
+  std::size_t wait_level_;
+  // 動的レート制御の目標の量（組数）
+  std::size_t target_level_;
+  bool is_started_{false};
+  std::atomic<std::uint64_t> num_underruns_{0};
+  std::atomic<std::uint64_t> num_overruns_{0};
 };
 
 }  // namespace gbemu
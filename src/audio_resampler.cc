@@ -0,0 +1,42 @@
+#include "audio_resampler.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "utils.h"
+
+namespace gbemu {
+
+AudioResampler::AudioResampler(double input_rate, double output_rate)
+    : input_rate_(input_rate), output_rate_(output_rate) {
+  ASSERT(input_rate_ > 0 && output_rate_ > 0, "Invalid sample rate.");
+  UpdateStep();
+}
+
+void AudioResampler::set_input_rate(double input_rate) {
+  ASSERT(input_rate > 0, "Invalid sample rate.");
+  input_rate_ = input_rate;
+  UpdateStep();
+}
+
+void AudioResampler::set_rate_adjust(double adjust) {
+  ASSERT(adjust > -1.0, "Invalid rate adjustment.");
+  rate_adjust_ = adjust;
+  UpdateStep();
+}
+
+void AudioResampler::UpdateStep() {
+  step_ = input_rate_ / (output_rate_ * (1.0 + rate_adjust_));
+}
+
+double ComputeRateAdjust(std::size_t queued, std::size_t target,
+                         double max_adjust) {
+  if (target == 0) {
+    return 0.0;
+  }
+  double error = (static_cast<double>(target) - static_cast<double>(queued)) /
+                 static_cast<double>(target);
+  return std::clamp(error, -1.0, 1.0) * max_adjust;
+}
+
+}  // namespace gbemu
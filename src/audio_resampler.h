@@ -0,0 +1,68 @@
+#ifndef GBEMU_AUDIO_RESAMPLER_H_
+#define GBEMU_AUDIO_RESAMPLER_H_
+
+#include <cstddef>
+
+namespace gbemu {
+
+// APUのサンプルレートのサンプルを、オーディオデバイスのサンプルレートに
+// 線形補間で変換するクラス。
+// 変換の比はわずかに増減でき（set_rate_adjust）、デバイスのバッファに
+// 溜まっている量を一定に保つために使う（ComputeRateAdjustを参照）。
+// Example:
+//   AudioResampler resampler(Apu::kSampleRate, 48000);
+//   resampler.Push(left, right, [&](double l, double r) { Output(l, r); });
+class AudioResampler {
+ public:
+  AudioResampler(double input_rate, double output_rate);
+
+  // 入力のサンプルレート。エミュレーションを実機より速く（遅く）進めるときは
+  // そのぶん高く（低く）する。
+  void set_input_rate(double input_rate);
+  double input_rate() const { return input_rate_; }
+  double output_rate() const { return output_rate_; }
+
+  // 出力するサンプル数を(1 + adjust)倍にする。
+  void set_rate_adjust(double adjust);
+  double rate_adjust() const { return rate_adjust_; }
+
+  // 1組の入力を渡し、それまでに出力すべき組（0組以上）をemit(left, right)で
+  // 順に渡す。
+  template <class Emit>
+  void Push(double left, double right, Emit&& emit) {
+    // 直前の入力から今回の入力までの区間に入る出力を補間する
+    while (phase_ <= 1.0) {
+      emit(previous_left_ + (left - previous_left_) * phase_,
+           previous_right_ + (right - previous_right_) * phase_);
+      phase_ += step_;
+    }
+    phase_ -= 1.0;
+    previous_left_ = left;
+    previous_right_ = right;
+  }
+
+ private:
+  void UpdateStep();
+
+  double input_rate_;
+  double output_rate_;
+  double rate_adjust_{0.0};
+  // 出力1組あたりに進む入力の組の数
+  double step_;
+  // 次の出力の位置。直前の入力を0、次の入力を1とする
+  double phase_{0.0};
+  double previous_left_{0.0};
+  double previous_right_{0.0};
+};
+
+// 動的レート制御（dynamic rate control）。バッファに溜まっている量queuedを
+// 目標targetに近づけるための変換の比の調整量を、[-max_adjust, max_adjust]の
+// 範囲で求める。少なければ出力を増やし、多ければ減らす。
+// 0.5%程度までのピッチの変化は聞き取れないので、ずれを音の途切れや遅延の
+// 増加ではなく、わずかなピッチの変化として吸収できる。
+double ComputeRateAdjust(std::size_t queued, std::size_t target,
+                         double max_adjust);
+
+}  // namespace gbemu
+
+#endif  // GBEMU_AUDIO_RESAMPLER_H_
@@ -0,0 +1,41 @@
+#ifndef GBEMU_AUDIO_SINK_H_
+#define GBEMU_AUDIO_SINK_H_
+
+namespace gbemu {
+
+// APUが生成したサンプルの出力先のインターフェース。
+// SDLに依存しないので、ヘッドレスで動かす場合もこのインターフェースを介する。
+class AudioSink {
+ public:
+  // このクラスは継承されるためデストラクタは仮想関数にする。
+  virtual ~AudioSink() = default;
+  // 左右の音のサンプル（それぞれ[-1.0, 1.0]）を1組受け取る。
+  virtual void PushSample(double left, double right) = 0;
+};
+
+// 受け取ったサンプルを捨てるAudioSink。音を鳴らさない実行のために使う。
+class NullAudioSink : public AudioSink {
+ public:
+  void PushSample(double /* left */, double /* right */) override {}
+};
+
+// 受け取ったサンプルを2つのAudioSinkに順に渡すAudioSink。
+// 音を鳴らしながら記録するときなどに使う。
+class TeeAudioSink : public AudioSink {
+ public:
+  TeeAudioSink(AudioSink& first, AudioSink& second)
+      : first_(first), second_(second) {}
+
+  void PushSample(double left, double right) override {
+    first_.PushSample(left, right);
+    second_.PushSample(left, right);
+  }
+
+ private:
+  AudioSink& first_;
+  AudioSink& second_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_AUDIO_SINK_H_
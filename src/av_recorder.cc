@@ -0,0 +1,275 @@
+#include "av_recorder.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "apu.h"
+#include "gameboy.h"
+#include "lcd.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+// 書き出し先を開く。"-"なら標準出力を複製したものを返し、
+// 元の標準出力は標準エラー出力に付け替える。
+std::FILE* OpenOutput(const std::string& path) {
+  std::FILE* file;
+  if (path == "-") {
+    std::fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+      Error("Cannot redirect the standard output.");
+    }
+    file = fdopen(fd, "wb");
+  } else {
+    file = std::fopen(path.c_str(), "wb");
+  }
+  if (file == nullptr) {
+    Error("File cannot open: %s", path.c_str());
+  }
+  return file;
+}
+
+void AppendLe16(std::vector<std::uint8_t>& bytes, std::uint16_t value) {
+  bytes.push_back(value & 0xFF);
+  bytes.push_back(value >> 8);
+}
+
+void AppendLe32(std::vector<std::uint8_t>& bytes, std::uint32_t value) {
+  AppendLe16(bytes, value & 0xFFFF);
+  AppendLe16(bytes, value >> 16);
+}
+
+// 16ビットのステレオのWAVのヘッダを作る。
+// データのバイト数が分からないとき（パイプに書き出すとき）は
+// ffmpegなどが長さ不明として扱う0xFFFFFFFFにしておく。
+std::vector<std::uint8_t> MakeWavHeader(std::uint32_t data_size) {
+  constexpr unsigned kChannels = 2;
+  constexpr unsigned kBytesPerSample = 2;
+  std::vector<std::uint8_t> header;
+  auto append_tag = [&header](const char* tag) {
+    for (int i = 0; i < 4; i++) {
+      header.push_back(tag[i]);
+    }
+  };
+  append_tag("RIFF");
+  AppendLe32(header, data_size == 0xFFFFFFFF ? data_size : 36 + data_size);
+  append_tag("WAVE");
+  append_tag("fmt ");
+  AppendLe32(header, 16);
+  AppendLe16(header, 1);  // PCM
+  AppendLe16(header, kChannels);
+  AppendLe32(header, Apu::kSampleRate);
+  AppendLe32(header, Apu::kSampleRate * kChannels * kBytesPerSample);
+  AppendLe16(header, kChannels * kBytesPerSample);
+  AppendLe16(header, 8 * kBytesPerSample);
+  append_tag("data");
+  AppendLe32(header, data_size);
+  return header;
+}
+
+// [-1.0, 1.0]のサンプルを16ビットの値にする。
+std::int16_t ToPcm16(double sample) {
+  return static_cast<std::int16_t>(
+      std::lround(std::clamp(sample, -1.0, 1.0) * 32767));
+}
+
+std::uint8_t ClampToByte(double value) {
+  return static_cast<std::uint8_t>(std::lround(std::clamp(value, 0.0, 255.0)));
+}
+
+}  // namespace
+
+AvRecorder::AvRecorder(const Config& config)
+    : config_(config), queue_(std::max(config.queue_frames, 1u)) {
+  if (config_.video_path == "-" && config_.audio_path == "-") {
+    Error("Video and audio cannot both be written to the standard output.");
+  }
+
+  // 各色を書き出す形式のバイト列にしておく。
+  // Y4MはBT.601のリミテッドレンジとする（ffmpegの既定の解釈）
+  for (int i = 0; i < lcd::kColorNum; i++) {
+    std::uint32_t rgb = config_.palette.colors[i];
+    double r = (rgb >> 16) & 0xFF;
+    double g = (rgb >> 8) & 0xFF;
+    double b = rgb & 0xFF;
+    if (config_.video_format == VideoFormat::kY4m) {
+      color_bytes_[i][0] =
+          ClampToByte(16 + (65.481 * r + 128.553 * g + 24.966 * b) / 255);
+      color_bytes_[i][1] =
+          ClampToByte(128 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255);
+      color_bytes_[i][2] =
+          ClampToByte(128 + (112.0 * r - 93.786 * g - 18.214 * b) / 255);
+    } else {
+      color_bytes_[i][0] = r;
+      color_bytes_[i][1] = g;
+      color_bytes_[i][2] = b;
+    }
+  }
+  frame_bytes_.resize(3 * lcd::kTotalPixelNum);
+
+  if (!config_.video_path.empty()) {
+    video_file_ = OpenOutput(config_.video_path);
+    if (config_.video_format == VideoFormat::kY4m) {
+      // フレームレートは1秒のT-cycle数 / 1フレームのT-cycle数（約59.73fps）
+      std::string header = "YUV4MPEG2 W" + std::to_string(lcd::kWidth) +
+                           " H" + std::to_string(lcd::kHeight) + " F4194304:" +
+                           std::to_string(GameBoy::kCyclesPerFrame) +
+                           " Ip A1:1 C444\n";
+      Write(video_file_, header.data(), header.size());
+    }
+  }
+  if (!config_.audio_path.empty()) {
+    audio_file_ = OpenOutput(config_.audio_path);
+    std::vector<std::uint8_t> header = MakeWavHeader(0xFFFFFFFF);
+    Write(audio_file_, header.data(), header.size());
+  }
+
+  writer_ = std::thread([this] { WriterLoop(); });
+}
+
+AvRecorder::~AvRecorder() { Finish(); }
+
+void AvRecorder::PushFrame(const GbLcdPixelMatrix& frame,
+                           std::uint64_t /* vblank_ns */) {
+  ASSERT(!is_finished_, "The recorder is already finished.");
+  num_frames_++;
+  Push(&frame);
+}
+
+void AvRecorder::PushSample(double left, double right) {
+  if (audio_file_ == nullptr) {
+    return;
+  }
+  pending_samples_.push_back(ToPcm16(left));
+  pending_samples_.push_back(ToPcm16(right));
+}
+
+void AvRecorder::Push(const GbLcdPixelMatrix* frame) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (count_ == queue_.size()) {
+    num_stalls_++;
+    space_available_.wait(lock, [this] { return count_ < queue_.size(); });
+  }
+  // 積む位置の要素は書き込みのスレッドから見えないので、ロックを外して埋める
+  Entry& entry = queue_[(head_ + count_) % queue_.size()];
+  lock.unlock();
+
+  entry.has_frame = frame != nullptr && video_file_ != nullptr;
+  if (entry.has_frame) {
+    entry.frame = *frame;
+  }
+  // 確保済みの領域を使い回すために入れ替える
+  entry.samples.swap(pending_samples_);
+  pending_samples_.clear();
+
+  lock.lock();
+  count_++;
+  work_available_.notify_one();
+}
+
+void AvRecorder::Finish() {
+  if (is_finished_) {
+    return;
+  }
+  is_finished_ = true;
+
+  if (!pending_samples_.empty()) {
+    Push(nullptr);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  work_available_.notify_one();
+  writer_.join();
+
+  if (video_file_ != nullptr) {
+    std::fclose(video_file_);
+  }
+  if (audio_file_ != nullptr) {
+    // シークできればデータのバイト数を書き直す。パイプなら長さ不明のままにする
+    if (audio_bytes_ <= 0xFFFFFFFF - 36 &&
+        std::fseek(audio_file_, 0, SEEK_SET) == 0) {
+      std::vector<std::uint8_t> header = MakeWavHeader(audio_bytes_);
+      Write(audio_file_, header.data(), header.size());
+    }
+    std::fclose(audio_file_);
+  }
+}
+
+void AvRecorder::WriterLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    work_available_.wait(lock, [this] { return count_ != 0 || is_stopping_; });
+    if (count_ == 0) {
+      return;
+    }
+    Entry& entry = queue_[head_];
+    lock.unlock();
+
+    if (entry.has_frame) {
+      WriteFrame(entry.frame);
+    }
+    WriteSamples(entry.samples);
+
+    lock.lock();
+    head_ = (head_ + 1) % queue_.size();
+    count_--;
+    space_available_.notify_one();
+  }
+}
+
+void AvRecorder::WriteFrame(const GbLcdPixelMatrix& frame) {
+  std::uint8_t* out = frame_bytes_.data();
+  if (config_.video_format == VideoFormat::kY4m) {
+    static constexpr char kFrameHeader[] = "FRAME\n";
+    Write(video_file_, kFrameHeader, sizeof(kFrameHeader) - 1);
+    // Y、U、Vの平面を順に並べる
+    for (int plane = 0; plane < 3; plane++) {
+      for (const GbLcdPixelRow& row : frame) {
+        for (lcd::GbLcdColor color : row) {
+          *out++ = color_bytes_[color][plane];
+        }
+      }
+    }
+  } else {
+    for (const GbLcdPixelRow& row : frame) {
+      for (lcd::GbLcdColor color : row) {
+        std::memcpy(out, color_bytes_[color], 3);
+        out += 3;
+      }
+    }
+  }
+  Write(video_file_, frame_bytes_.data(), frame_bytes_.size());
+}
+
+void AvRecorder::WriteSamples(const std::vector<std::int16_t>& samples) {
+  if (audio_file_ == nullptr || samples.empty()) {
+    return;
+  }
+  sample_bytes_.clear();
+  for (std::int16_t sample : samples) {
+    AppendLe16(sample_bytes_, sample);
+  }
+  Write(audio_file_, sample_bytes_.data(), sample_bytes_.size());
+  audio_bytes_ += sample_bytes_.size();
+}
+
+void AvRecorder::Write(std::FILE* file, const void* data, std::size_t size) {
+  if (std::fwrite(data, 1, size, file) != size) {
+    Error("Failed to write the recording.");
+  }
+}
+
+}  // namespace gbemu
@@ -0,0 +1,138 @@
+#ifndef GBEMU_AV_RECORDER_H_
+#define GBEMU_AV_RECORDER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio_sink.h"
+#include "dmg_palette.h"
+#include "frame_sink.h"
+#include "lcd.h"
+
+namespace gbemu {
+
+// 画面と音を、ffmpegなどで読める形式でファイルかパイプに書き出すクラス。
+// 画面はY4M（YUV 4:4:4）か、ヘッダのないRGB24の列として書き出す。
+// 音はAPUが出力したサンプルを16ビットのステレオのWAVとして
+// 別のファイルに書き出す。
+// 書き込みは専用のスレッドで行い、エミュレーションのスレッドはフレームと
+// その間のサンプルを有限のキューに積むだけにする。キューが一杯になったときだけ
+// 書き込みが追いつくのを待つ（フレームは捨てない）。
+// Example:
+//   AvRecorder::Config config;
+//   config.video_path = "out.y4m";
+//   config.audio_path = "out.wav";
+//   AvRecorder recorder(config);
+//   GameBoy gb(&cartridge, recorder);
+//   for (;;) {
+//     gb.Step();
+//     recorder.PushFrame(gb.GetPpuBuffer(), GetMonotonicNs());
+//   }
+class AvRecorder : public FrameSink, public AudioSink {
+ public:
+  // 画面の形式。
+  enum class VideoFormat {
+    // YUV4MPEG2。フレームレートなどをヘッダに持つので、そのまま再生できる
+    kY4m,
+    // 1ピクセル3バイト（R、G、B）を並べただけのもの
+    // （ffmpegでは -f rawvideo -pix_fmt rgb24 -s 160x144 -r 59.7275）
+    kRawRgb,
+  };
+
+  struct Config {
+    // 画面の書き出し先。"-"なら標準出力、空なら画面を記録しない。
+    std::string video_path{};
+    VideoFormat video_format{VideoFormat::kY4m};
+    // WAVの書き出し先。"-"なら標準出力、空なら音を記録しない。
+    std::string audio_path{};
+    // 画面の4階調の色
+    DmgPalette palette{kDefaultDmgPalette};
+    // 書き込みを待たずに積めるフレーム数
+    unsigned queue_frames{120};
+  };
+
+  // 書き出し先を開いてヘッダを書き出す。開けなければプログラムを終了する。
+  // 書き出し先に標準出力を指定すると、記録と混ざらないように
+  // 以降に標準出力へ書かれるものは標準エラー出力に回す。
+  explicit AvRecorder(const Config& config);
+  // Finishを呼んでいなければ呼ぶ。
+  ~AvRecorder() override;
+
+  AvRecorder(const AvRecorder&) = delete;
+  AvRecorder& operator=(const AvRecorder&) = delete;
+
+  // 1フレーム分の画面を積む。
+  void PushFrame(const GbLcdPixelMatrix& frame,
+                 std::uint64_t vblank_ns) override;
+  // 1組のサンプルを積む。次のPushFrameかFinishでまとめて書き込みに回す。
+  void PushSample(double left, double right) override;
+
+  // 積んだものをすべて書き込んでからファイルを閉じる。
+  // WAVの書き出し先がシーク可能なら、ヘッダのデータサイズを書き直す。
+  void Finish();
+
+  // 積んだフレームの数。
+  std::uint64_t num_frames() const { return num_frames_; }
+  // キューが一杯で書き込みを待った回数。
+  std::uint64_t num_stalls() const { return num_stalls_; }
+
+ private:
+  // キューの要素。1フレームと、その前のフレームから積んだサンプル。
+  struct Entry {
+    GbLcdPixelMatrix frame;
+    bool has_frame;
+    // 左右のサンプルを交互に並べたもの
+    std::vector<std::int16_t> samples;
+  };
+
+  // pending_samples_とframe（あれば）をキューに積む。
+  void Push(const GbLcdPixelMatrix* frame);
+  // 書き込みのスレッドの処理。
+  void WriterLoop();
+  // 1フレーム分の画面を書き出す。
+  void WriteFrame(const GbLcdPixelMatrix& frame);
+  // サンプルを書き出す。
+  void WriteSamples(const std::vector<std::int16_t>& samples);
+  // 書き出し先に書き込む。失敗したらプログラムを終了する。
+  static void Write(std::FILE* file, const void* data, std::size_t size);
+
+  Config config_;
+  std::FILE* video_file_{};
+  std::FILE* audio_file_{};
+  // WAVのデータ部に書き込んだバイト数
+  std::uint64_t audio_bytes_{0};
+
+  // 各色をそれぞれの形式の1ピクセル分のバイト列にしたもの。
+  // Y4MならY、U、V、RGB24ならR、G、Bの順に並べる。
+  std::uint8_t color_bytes_[lcd::kColorNum][3];
+  // 書き出すバイト列を組み立てるバッファ
+  std::vector<std::uint8_t> frame_bytes_;
+  std::vector<std::uint8_t> sample_bytes_;
+
+  // エミュレーションのスレッドで積んでいるサンプル
+  std::vector<std::int16_t> pending_samples_;
+  std::uint64_t num_frames_{0};
+  std::uint64_t num_stalls_{0};
+  bool is_finished_{false};
+
+  // queue_[head_]から順にcount_個が書き込み待ち
+  std::vector<Entry> queue_;
+  std::size_t head_{0};
+  std::size_t count_{0};
+  bool is_stopping_{false};
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable space_available_;
+
+  std::thread writer_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_AV_RECORDER_H_
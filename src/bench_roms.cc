@@ -0,0 +1,458 @@
+#include "bench_roms.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "cartridge_header.h"
+#include "rom_builder.h"
+
+namespace gbemu {
+
+namespace {
+
+// I/Oレジスタ（$FF00からのオフセット）
+constexpr std::uint8_t kP1 = 0x00;
+constexpr std::uint8_t kDiv = 0x04;
+constexpr std::uint8_t kIf = 0x0F;
+constexpr std::uint8_t kNr10 = 0x10;
+constexpr std::uint8_t kNr11 = 0x11;
+constexpr std::uint8_t kNr12 = 0x12;
+constexpr std::uint8_t kNr13 = 0x13;
+constexpr std::uint8_t kNr14 = 0x14;
+constexpr std::uint8_t kNr21 = 0x16;
+constexpr std::uint8_t kNr22 = 0x17;
+constexpr std::uint8_t kNr23 = 0x18;
+constexpr std::uint8_t kNr24 = 0x19;
+constexpr std::uint8_t kNr30 = 0x1A;
+constexpr std::uint8_t kNr32 = 0x1C;
+constexpr std::uint8_t kNr33 = 0x1D;
+constexpr std::uint8_t kNr34 = 0x1E;
+constexpr std::uint8_t kNr42 = 0x21;
+constexpr std::uint8_t kNr43 = 0x22;
+constexpr std::uint8_t kNr44 = 0x23;
+constexpr std::uint8_t kNr50 = 0x24;
+constexpr std::uint8_t kNr51 = 0x25;
+constexpr std::uint8_t kNr52 = 0x26;
+constexpr std::uint8_t kWaveRam = 0x30;
+constexpr std::uint8_t kLcdc = 0x40;
+constexpr std::uint8_t kStat = 0x41;
+constexpr std::uint8_t kScy = 0x42;
+constexpr std::uint8_t kScx = 0x43;
+constexpr std::uint8_t kLy = 0x44;
+constexpr std::uint8_t kDma = 0x46;
+constexpr std::uint8_t kBgp = 0x47;
+constexpr std::uint8_t kObp0 = 0x48;
+constexpr std::uint8_t kObp1 = 0x49;
+constexpr std::uint8_t kWy = 0x4A;
+constexpr std::uint8_t kWx = 0x4B;
+constexpr std::uint8_t kIe = 0xFF;
+
+constexpr std::uint16_t kVBlankVector = 0x0040;
+// BGのタイルマップ（LCDCのビット3が0のとき）
+constexpr std::uint16_t kBgTileMap = 0x9800;
+
+// OAM DMAを待つルーチンを置くHRAMのアドレス
+constexpr std::uint8_t kDmaRoutine = 0x80;
+// OAMに転送するデータを置くWRAMのアドレス
+constexpr std::uint16_t kShadowOam = 0xC000;
+
+void EmitInit(RomBuilder& b) {
+  b.Di();
+  b.Ld(Reg16::kSp, 0xFFFE);
+}
+
+// 指定したラインになるまで待つ。
+void EmitWaitLine(RomBuilder& b, std::uint8_t line) {
+  RomBuilder::Label wait = b.NewLabel();
+  b.Bind(wait);
+  b.LdhA(kLy);
+  b.Alu(AluOp::kCp, line);
+  b.Jr(Condition::kNz, wait);
+}
+
+// VBlankを待ってLCDを止める。ブートROMを通さずに起動した場合は既に止まっている。
+void EmitLcdOff(RomBuilder& b) {
+  RomBuilder::Label done = b.NewLabel();
+  b.LdhA(kLcdc);
+  b.Alu(AluOp::kAnd, std::uint8_t{0x80});
+  b.Jr(Condition::kZ, done);
+  EmitWaitLine(b, 144);
+  b.WriteIo(kLcdc, 0x00);
+  b.Bind(done);
+}
+
+// hlにdst、bcにsizeを入れ、1バイトごとにbodyを実行するループを書き込む。
+// bodyはaに書き込む値を入れる。
+template <class Body>
+void EmitFill(RomBuilder& b, std::uint16_t dst, std::uint16_t size,
+              Body body) {
+  b.Ld(Reg16::kHl, dst);
+  b.Ld(Reg16::kBc, size);
+  RomBuilder::Label loop = b.NewLabel();
+  b.Bind(loop);
+  body();
+  b.StoreAHlInc();
+  b.Dec(Reg16::kBc);
+  b.Ld(Reg8::kA, Reg8::kB);
+  b.Alu(AluOp::kOr, Reg8::kC);
+  b.Jr(Condition::kNz, loop);
+}
+
+// dstからsizeバイトを0, step, step*2, ...で埋める。eを使う。
+void EmitFillSequence(RomBuilder& b, std::uint16_t dst, std::uint16_t size,
+                      std::uint8_t step) {
+  b.Ld(Reg8::kE, std::uint8_t{0});
+  EmitFill(b, dst, size, [&] {
+    b.Ld(Reg8::kA, Reg8::kE);
+    b.Alu(AluOp::kAdd, step);
+    b.Ld(Reg8::kE, Reg8::kA);
+  });
+}
+
+// タイルデータとBGのタイルマップに模様を書き込む。LCDを止めてから呼ぶ。
+void EmitLoadTiles(RomBuilder& b) {
+  EmitFillSequence(b, 0x8000, 0x1000, 0x35);
+  EmitFillSequence(b, 0x9800, 0x0400, 0x01);
+  EmitFillSequence(b, 0x9C00, 0x0400, 0x07);
+  b.WriteIo(kBgp, 0xE4);
+  b.WriteIo(kObp0, 0xE4);
+  b.WriteIo(kObp1, 0x1B);
+}
+
+// VBlank割り込みを有効にし、BGだけを表示してLCDをオンにする。
+// EmitLoadTilesの後で呼ぶ。
+void EmitEnableVBlank(RomBuilder& b) {
+  b.WriteIo(kIf, 0x00);
+  b.WriteIo(kIe, 0x01);
+  b.WriteIo(kLcdc, 0x91);
+  b.Ei();
+}
+
+// VBlank割り込みのハンドラを書き込み、ベクタから飛ぶようにする。
+// bodyは計算の途中結果を画面に書き出す処理で、レジスタはすべて退避して
+// あるので自由に使える。VBlankの間に実行されるのでVRAMに書き込める。
+// メインのループの後（そこまで実行が進まない位置）で呼ぶ。
+template <class Body>
+void EmitVBlankHandler(RomBuilder& b, Body body) {
+  RomBuilder::Label handler = b.NewLabel();
+  b.Bind(handler);
+  b.Db({0xF5, 0xC5, 0xD5, 0xE5});  // push af; push bc; push de; push hl
+  body();
+  b.Db({0xE1, 0xD1, 0xC1, 0xF1});  // pop hl; pop de; pop bc; pop af
+  b.Reti();
+  b.SetVectorAddress(kVBlankVector);
+  b.Jp(handler);
+}
+
+// aの下位と上位の4ビットを、この順にタイルの番号として(hl+)に書き込む。
+// EmitLoadTilesのタイルは16個ごとに同じ模様なので、4ビットずつ書き込めば
+// 値の違いがすべて画面に表れる。
+void EmitShowByte(RomBuilder& b) {
+  b.StoreAHlInc();
+  b.Swap(Reg8::kA);
+  b.StoreAHlInc();
+}
+
+std::vector<std::uint8_t> BuildAluRom() {
+  RomBuilder b("BENCH ALU", CartridgeType::kRomOnly, 2);
+  EmitInit(b);
+  EmitLcdOff(b);
+  b.WriteIo(kNr52, 0x00);
+  EmitLoadTiles(b);
+  EmitEnableVBlank(b);
+
+  b.Ld(Reg8::kC, std::uint8_t{0x5A});
+  RomBuilder::Label outer = b.NewLabel();
+  RomBuilder::Label inner = b.NewLabel();
+  b.Bind(outer);
+  b.Ld(Reg8::kB, std::uint8_t{0});
+  b.Bind(inner);
+  b.Alu(AluOp::kAdd, Reg8::kB);
+  b.Alu(AluOp::kAdc, Reg8::kC);
+  b.Alu(AluOp::kXor, Reg8::kC);
+  b.Alu(AluOp::kSub, Reg8::kB);
+  b.Alu(AluOp::kAnd, std::uint8_t{0xF3});
+  b.Alu(AluOp::kOr, Reg8::kB);
+  b.Swap(Reg8::kA);
+  b.Rlca();
+  b.Ld(Reg8::kD, Reg8::kA);
+  b.Inc(Reg8::kE);
+  b.Alu(AluOp::kSbc, Reg8::kE);
+  b.Alu(AluOp::kCp, Reg8::kD);
+  b.Inc(Reg8::kB);
+  b.Jr(Condition::kNz, inner);
+  b.Inc(Reg8::kC);
+  b.Jr(outer);
+
+  // 演算に使っているレジスタを画面の左上に表示する
+  EmitVBlankHandler(b, [&] {
+    b.Ld(Reg16::kHl, kBgTileMap);
+    EmitShowByte(b);
+    for (Reg8 reg : {Reg8::kB, Reg8::kC, Reg8::kD, Reg8::kE}) {
+      b.Ld(Reg8::kA, reg);
+      EmitShowByte(b);
+    }
+  });
+  return b.Build();
+}
+
+std::vector<std::uint8_t> BuildMbc1CopyRom() {
+  constexpr unsigned kNumBanks = 8;
+  RomBuilder b("BENCH MBC1", CartridgeType::kMbc1, kNumBanks);
+  EmitInit(b);
+  EmitLcdOff(b);
+  b.WriteIo(kNr52, 0x00);
+  EmitLoadTiles(b);
+  EmitEnableVBlank(b);
+
+  // バンク1から順に先頭の256バイトをWRAMにコピーする
+  RomBuilder::Label main = b.NewLabel();
+  RomBuilder::Label bank_loop = b.NewLabel();
+  RomBuilder::Label copy = b.NewLabel();
+  b.Bind(main);
+  b.Ld(Reg8::kD, std::uint8_t{1});
+  b.Bind(bank_loop);
+  b.Ld(Reg8::kA, Reg8::kD);
+  b.StoreA(std::uint16_t{0x2000});  // ROMバンクの選択
+  b.Ld(Reg16::kHl, 0x4000);
+  b.Ld(Reg16::kBc, 0xC000);
+  b.Ld(Reg8::kE, std::uint8_t{0});
+  b.Bind(copy);
+  b.LoadAHlInc();
+  b.StoreA(Reg16::kBc);
+  b.Inc(Reg16::kBc);
+  b.Dec(Reg8::kE);
+  b.Jr(Condition::kNz, copy);
+  b.Inc(Reg8::kD);
+  b.Ld(Reg8::kA, Reg8::kD);
+  b.Alu(AluOp::kCp, std::uint8_t{kNumBanks});
+  b.Jr(Condition::kNz, bank_loop);
+  b.Jr(main);
+
+  // コピー先の先頭の16バイトと選択中のバンクを画面の左上に表示する
+  EmitVBlankHandler(b, [&] {
+    RomBuilder::Label show = b.NewLabel();
+    b.Ld(Reg8::kA, Reg8::kD);
+    b.Ld(Reg16::kHl, kBgTileMap);
+    EmitShowByte(b);
+    b.Ld(Reg16::kDe, 0xC000);
+    b.Ld(Reg8::kB, std::uint8_t{16});
+    b.Bind(show);
+    b.LoadA(Reg16::kDe);
+    b.Inc(Reg16::kDe);
+    EmitShowByte(b);
+    b.Dec(Reg8::kB);
+    b.Jr(Condition::kNz, show);
+  });
+
+  // 各バンクの先頭にバンクごとに異なるデータを置く
+  for (unsigned bank = 1; bank < kNumBanks; bank++) {
+    b.SetBank(bank);
+    std::vector<std::uint8_t> data(256);
+    for (unsigned i = 0; i < data.size(); i++) {
+      data[i] = static_cast<std::uint8_t>(bank * 37 + i);
+    }
+    b.Db(data);
+  }
+  return b.Build();
+}
+
+std::vector<std::uint8_t> BuildIoPollRom() {
+  RomBuilder b("BENCH IO POLL", CartridgeType::kRomOnly, 2);
+  EmitInit(b);
+  EmitLcdOff(b);
+  EmitLoadTiles(b);
+  b.WriteIo(kLcdc, 0x91);
+
+  // 多くのゲームと同様に、LYを読み続けてVBlankを待ち、キー入力を読む
+  RomBuilder::Label frame = b.NewLabel();
+  RomBuilder::Label wait_vblank = b.NewLabel();
+  RomBuilder::Label wait_end = b.NewLabel();
+  b.Bind(frame);
+  b.Bind(wait_vblank);
+  b.LdhA(kStat);
+  b.LdhA(kDiv);
+  b.LdhA(kIf);
+  b.LdhA(kLy);
+  b.Alu(AluOp::kCp, std::uint8_t{144});
+  b.Jr(Condition::kNz, wait_vblank);
+  b.WriteIo(kP1, 0x20);
+  for (int i = 0; i < 4; i++) {
+    b.LdhA(kP1);
+  }
+  b.WriteIo(kP1, 0x10);
+  for (int i = 0; i < 4; i++) {
+    b.LdhA(kP1);
+  }
+  b.WriteIo(kP1, 0x30);
+  b.Bind(wait_end);
+  b.LdhA(kLy);
+  b.Alu(AluOp::kCp, std::uint8_t{144});
+  b.Jr(Condition::kZ, wait_end);
+  b.Jr(frame);
+  return b.Build();
+}
+
+std::vector<std::uint8_t> BuildSpritesRom() {
+  RomBuilder b("BENCH SPRITES", CartridgeType::kRomOnly, 2);
+  EmitInit(b);
+  EmitLcdOff(b);
+  EmitLoadTiles(b);
+
+  // HRAMにOAM DMAのルーチンを置く
+  const std::uint8_t dma_routine[] = {
+      0xE0, kDma,  // ldh (DMA),a
+      0x3E, 40,    // ld a,40
+      0x3D,        // dec a
+      0x20, 0xFD,  // jr nz,-3
+      0xC9};       // ret
+  for (unsigned i = 0; i < sizeof(dma_routine); i++) {
+    b.WriteIo(kDmaRoutine + i, dma_routine[i]);
+  }
+
+  // 8x16のオブジェクトを10個ずつ4つの帯に並べる。
+  // 帯の間隔は36ラインで、毎フレーム1ラインずつ下に動かす。
+  b.Ld(Reg16::kHl, kShadowOam);
+  for (unsigned band = 0; band < 4; band++) {
+    for (unsigned i = 0; i < 10; i++) {
+      b.Ld(Reg8::kHlIndirect, static_cast<std::uint8_t>(16 + band * 36));
+      b.Inc(Reg16::kHl);
+      b.Ld(Reg8::kHlIndirect, static_cast<std::uint8_t>(8 + i * 14 + band));
+      b.Inc(Reg16::kHl);
+      b.Ld(Reg8::kHlIndirect, static_cast<std::uint8_t>(i * 2));
+      b.Inc(Reg16::kHl);
+      // 反転とパレットを交互に変える
+      b.Ld(Reg8::kHlIndirect,
+           static_cast<std::uint8_t>(((i & 1) << 5) | ((band & 1) << 4)));
+      b.Inc(Reg16::kHl);
+    }
+  }
+  b.WriteIo(kLcdc, 0x97);
+
+  RomBuilder::Label frame = b.NewLabel();
+  RomBuilder::Label move = b.NewLabel();
+  b.Bind(frame);
+  EmitWaitLine(b, 144);
+  b.Ld(Reg8::kA, static_cast<std::uint8_t>(kShadowOam >> 8));
+  b.Db({0xCD, kDmaRoutine, 0xFF});  // call $FF80
+  b.Ld(Reg16::kHl, kShadowOam);
+  b.Ld(Reg8::kB, std::uint8_t{40});
+  b.Bind(move);
+  b.Inc(Reg8::kHlIndirect);
+  b.Ld(Reg8::kA, Reg8::kL);
+  b.Alu(AluOp::kAdd, std::uint8_t{4});
+  b.Ld(Reg8::kL, Reg8::kA);
+  b.Dec(Reg8::kB);
+  b.Jr(Condition::kNz, move);
+  EmitWaitLine(b, 0);
+  b.Jr(frame);
+  return b.Build();
+}
+
+std::vector<std::uint8_t> BuildWindowScrollRom() {
+  RomBuilder b("BENCH WINDOW", CartridgeType::kRomOnly, 2);
+  EmitInit(b);
+  EmitLcdOff(b);
+  EmitLoadTiles(b);
+  b.WriteIo(kLcdc, 0xF1);
+
+  // cはフレーム数
+  b.Ld(Reg8::kC, std::uint8_t{0});
+  RomBuilder::Label frame = b.NewLabel();
+  RomBuilder::Label line = b.NewLabel();
+  RomBuilder::Label wait_next = b.NewLabel();
+  b.Bind(frame);
+  EmitWaitLine(b, 0);
+  b.Inc(Reg8::kC);
+  b.Ld(Reg8::kA, Reg8::kC);
+  b.Alu(AluOp::kAnd, std::uint8_t{0x3F});
+  b.Ldh(kWy);
+  b.Alu(AluOp::kAdd, std::uint8_t{7});
+  b.Ldh(kWx);
+  b.Ld(Reg8::kA, Reg8::kC);
+  b.Ldh(kScy);
+  // 毎ラインSCXを書き換えて背景を波打たせる
+  b.Bind(line);
+  b.LdhA(kLy);
+  b.Ld(Reg8::kB, Reg8::kA);
+  b.Alu(AluOp::kAdd, Reg8::kC);
+  b.Ldh(kScx);
+  b.Bind(wait_next);
+  b.LdhA(kLy);
+  b.Alu(AluOp::kCp, Reg8::kB);
+  b.Jr(Condition::kZ, wait_next);
+  b.Alu(AluOp::kCp, std::uint8_t{144});
+  b.Jr(Condition::kC, line);
+  b.Jr(frame);
+  return b.Build();
+}
+
+std::vector<std::uint8_t> BuildApuRom() {
+  RomBuilder b("BENCH APU", CartridgeType::kRomOnly, 2);
+  EmitInit(b);
+  EmitLcdOff(b);
+  EmitLoadTiles(b);
+
+  b.WriteIo(kNr52, 0x80);
+  b.WriteIo(kNr50, 0x77);
+  b.WriteIo(kNr51, 0xFF);
+  // 波形メモリ
+  for (std::uint8_t i = 0; i < 16; i++) {
+    b.WriteIo(kWaveRam + i, static_cast<std::uint8_t>(i * 0x11 ^ 0x0F));
+  }
+  b.WriteIo(kNr10, 0x1F);
+  b.WriteIo(kNr11, 0x80);
+  b.WriteIo(kNr12, 0xF3);
+  b.WriteIo(kNr21, 0x40);
+  b.WriteIo(kNr22, 0xF3);
+  b.WriteIo(kNr30, 0x80);
+  b.WriteIo(kNr32, 0x20);
+  b.WriteIo(kNr42, 0xF3);
+  EmitEnableVBlank(b);
+
+  // 周波数を変えながら4チャネルを鳴らし直し続ける
+  b.Ld(Reg8::kC, std::uint8_t{0});
+  RomBuilder::Label loop = b.NewLabel();
+  RomBuilder::Label delay = b.NewLabel();
+  b.Bind(loop);
+  b.Inc(Reg8::kC);
+  b.Ld(Reg8::kA, Reg8::kC);
+  b.Ldh(kNr13);
+  b.Ldh(kNr23);
+  b.Ldh(kNr33);
+  b.Ldh(kNr43);
+  b.WriteIo(kNr14, 0x87);
+  b.WriteIo(kNr24, 0x86);
+  b.WriteIo(kNr34, 0x85);
+  b.WriteIo(kNr44, 0x80);
+  b.Ld(Reg8::kB, std::uint8_t{0});
+  b.Bind(delay);
+  b.Dec(Reg8::kB);
+  b.Jr(Condition::kNz, delay);
+  b.Jr(loop);
+
+  // 各チャネルが鳴っているか（NR52）と周波数を画面の左上に表示する
+  EmitVBlankHandler(b, [&] {
+    b.Ld(Reg16::kHl, kBgTileMap);
+    b.LdhA(kNr52);
+    EmitShowByte(b);
+    b.Ld(Reg8::kA, Reg8::kC);
+    EmitShowByte(b);
+  });
+  return b.Build();
+}
+
+}  // namespace
+
+std::vector<BenchRom> BuildBenchRoms() {
+  return {
+      {"alu", BuildAluRom()},
+      {"mbc1_copy", BuildMbc1CopyRom()},
+      {"io_poll", BuildIoPollRom()},
+      {"sprites", BuildSpritesRom()},
+      {"window_scroll", BuildWindowScrollRom()},
+      {"apu", BuildApuRom()},
+  };
+}
+
+}  // namespace gbemu
@@ -0,0 +1,30 @@
+#ifndef GBEMU_BENCH_ROMS_H_
+#define GBEMU_BENCH_ROMS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gbemu {
+
+// ベンチマーク用のROM。
+struct BenchRom {
+  std::string name;
+  std::vector<std::uint8_t> rom;
+};
+
+// 特定の処理に負荷をかけるベンチマーク用のROMをすべて生成する。
+// 市販のROMやテストROMを同梱せずに、各コンポーネントの速度を個別に測るためのもの。
+// ゴールデンで結果を照合できるよう、alu、mbc1_copy、apuはVBlank割り込みで
+// 途中結果を画面の左上に表示する（BGのみで、描画の負荷は小さい）。
+//   alu            APUを止めてレジスタ間の算術論理演算を繰り返す
+//   mbc1_copy      MBC1のバンクを切り替えながらROMからWRAMへコピーする
+//   io_poll        ldhでLY、STAT、P1などのI/Oレジスタを読み続ける
+//   sprites        8x16のオブジェクトを1ラインに10個ずつ並べ、毎フレームDMAで動かす
+//   window_scroll  ウィンドウを表示し、毎ラインSCXを、毎フレームWX/WYを書き換える
+//   apu            4チャネルすべてを鳴らし、周波数を変え続ける
+std::vector<BenchRom> BuildBenchRoms();
+
+}  // namespace gbemu
+
+#endif  // GBEMU_BENCH_ROMS_H_
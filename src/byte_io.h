@@ -0,0 +1,97 @@
+#ifndef GBEMU_BYTE_IO_H_
+#define GBEMU_BYTE_IO_H_
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+// ファイルに保存する形式（ムービー、フレームの記録など）で共通して使う、
+// 整数の読み書きの関数。
+// 固定長の整数はリトルエンディアンで、可変長の整数はLEB128（下位から7ビット
+// ずつ、続きがあれば最上位ビットを立てる）で表す。
+// セーブステートと違ってホストのバイトオーダーに依存しない。
+
+namespace gbemu {
+
+template <class T>
+void WriteLittleEndian(std::ostream& out, T value) {
+  static_assert(std::is_unsigned_v<T>, "Only unsigned values can be written.");
+  for (unsigned i = 0; i < sizeof(T); i++) {
+    out.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+  }
+}
+
+template <class T>
+void AppendLittleEndian(std::vector<std::uint8_t>& out, T value) {
+  static_assert(std::is_unsigned_v<T>, "Only unsigned values can be written.");
+  for (unsigned i = 0; i < sizeof(T); i++) {
+    out.push_back(static_cast<std::uint8_t>((value >> (i * 8)) & 0xFF));
+  }
+}
+
+// 途中で終端に達したらfalseを返す。
+template <class T>
+bool ReadLittleEndian(std::istream& in, T& value) {
+  static_assert(std::is_unsigned_v<T>, "Only unsigned values can be read.");
+  value = 0;
+  for (unsigned i = 0; i < sizeof(T); i++) {
+    int c = in.get();
+    if (c == std::istream::traits_type::eof()) {
+      return false;
+    }
+    value |= static_cast<T>(c) << (i * 8);
+  }
+  return true;
+}
+
+inline void WriteVarint(std::ostream& out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.put(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.put(static_cast<char>(value));
+}
+
+inline void AppendVarint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<std::uint8_t>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<std::uint8_t>(value));
+}
+
+// 途中で終端に達するか長すぎればfalseを返す。
+inline bool ReadVarint(std::istream& in, std::uint64_t& value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    int c = in.get();
+    if (c == std::istream::traits_type::eof()) {
+      return false;
+    }
+    value |= static_cast<std::uint64_t>(c & 0x7F) << shift;
+    if ((c & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// pから読んで、読んだ分だけpを進める。endを越えるか長すぎればfalseを返す。
+inline bool ReadVarint(const std::uint8_t*& p, const std::uint8_t* end,
+                       std::uint64_t& value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+    std::uint8_t byte = *p++;
+    value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace gbemu
+
+#endif  // GBEMU_BYTE_IO_H_
@@ -1,25 +1,25 @@
 #include "cartridge.h"
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include "cartridge_header.h"
 #include "mbc.h"
+#include "save_state.h"
 #include "utils.h"
 
 namespace gbemu {
 
-Cartridge::Cartridge(std::vector<std::uint8_t>& rom,
+Cartridge::Cartridge(const std::vector<std::uint8_t>& rom,
                      std::vector<std::uint8_t>* ram)
     : header_(), rom_(rom), ram_(ram), mbc_() {
-  // カートリッジヘッダのパース
-  header_.Parse(rom_);
-
-  // ROMサイズのチェック
-  auto rom_size_in_header = header_.rom_size() * 1024;
-  if (rom_.size() != rom_size_in_header) {
-    Error("Actual ROM size is not consistent with the header.");
+  // カートリッジヘッダとROMサイズのチェック
+  std::string error;
+  if (!Validate(rom_, error)) {
+    Error("%s", error.c_str());
   }
+  header_.Parse(rom_);
 
   // RAMの初期化
   ASSERT(ram_ != nullptr, "Invalid argument.");
@@ -35,6 +35,19 @@ Cartridge::Cartridge(std::vector<std::uint8_t>& rom,
   mbc_ = Mbc::Create(header_.type(), rom_, *ram_);
 }
 
+bool Cartridge::Validate(const std::vector<std::uint8_t>& rom,
+                         std::string& error) {
+  CartridgeHeader header;
+  if (!header.TryParse(rom, error)) {
+    return false;
+  }
+  if (rom.size() != header.rom_size() * 1024) {
+    error = "Actual ROM size is not consistent with the header.";
+    return false;
+  }
+  return true;
+}
+
 std::uint8_t Cartridge::Read8(std::uint16_t address) const {
   return mbc_->Read8(address);
 }
@@ -43,4 +56,14 @@ void Cartridge::Write8(std::uint16_t address, std::uint8_t value) {
   mbc_->Write8(address, value);
 }
 
+void Cartridge::SaveState(StateWriter& writer) const {
+  mbc_->SaveState(writer);
+  writer.WriteBytes(ram_->data(), ram_->size());
+}
+
+void Cartridge::LoadState(StateReader& reader) {
+  mbc_->LoadState(reader);
+  reader.ReadBytes(ram_->data(), ram_->size());
+}
+
 }  // namespace gbemu
@@ -1,22 +1,32 @@
 #ifndef GBEMU_CARTRIDGE_H_
 #define GBEMU_CARTRIDGE_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "cartridge_header.h"
 #include "mbc.h"
+#include "save_state.h"
 
 namespace gbemu {
 
 // カートリッジを表すクラス。
 // セーブデータの入出力に対応できるように、RAMのデータは内部に持たずポインタで管理する。
+// ROMは書き換えないので、同じROMを複数のインスタンスで共有してよい。
 class Cartridge {
  public:
   // ROMの内容をもとにインスタンスを生成する。
   // ROMの内容が不正な場合はプログラムを終了する。
-  Cartridge(std::vector<std::uint8_t>& rom, std::vector<std::uint8_t>* ram);
+  Cartridge(const std::vector<std::uint8_t>& rom,
+            std::vector<std::uint8_t>* ram);
+
+  // romからインスタンスを生成できるか（ヘッダとROMのサイズが正しいか）を
+  // 調べる。生成できなければ理由をerrorに入れてfalseを返す。
+  static bool Validate(const std::vector<std::uint8_t>& rom,
+                       std::string& error);
 
   // アドレスに応じてROMまたは(External)RAMから1バイトの値を読み出す。
   // 範囲外へのアクセスはエラーとしプログラムを終了する。
@@ -26,9 +36,25 @@ class Cartridge {
   // 範囲外へのアクセスはエラーとしプログラムを終了する。
   void Write8(std::uint16_t address, std::uint8_t value);
 
+  const CartridgeHeader& header() const { return header_; }
+
+  // $0000-$7FFFのアドレスに現在割り当てられているROMバンクの番号を返す。
+  unsigned GetRomBank(std::uint16_t address) const {
+    return mbc_->GetRomBank(address);
+  }
+
+  // (External)RAMのサイズ（単位：バイト）を得る。
+  std::size_t ram_size() const { return ram_->size(); }
+
+  // MBCの状態とRAMの内容をセーブステートに書き出す。
+  void SaveState(StateWriter& writer) const;
+  // セーブステートからMBCの状態とRAMの内容を復元する。
+  // RAMのサイズはセーブステートと一致していなければならない。
+  void LoadState(StateReader& reader);
+
  private:
   CartridgeHeader header_;
-  std::vector<std::uint8_t>& rom_;
+  const std::vector<std::uint8_t>& rom_;
   std::vector<std::uint8_t>* ram_;
   std::unique_ptr<Mbc> mbc_;
 };
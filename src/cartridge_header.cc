@@ -2,6 +2,7 @@
 
 #include <cctype>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
 #include <string>
@@ -13,72 +14,100 @@ namespace gbemu {
 
 namespace {
 
+// ヘッダのaddressの値valueが不正であることを表すメッセージ
+std::string InvalidHeaderMessage(unsigned address, std::uint8_t value) {
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "Invalid cartridge header at $%04X: %d.",
+                address, static_cast<int>(value));
+  return buf;
+}
+
 // $0143（CGB flag）を取得
-CartridgeTarget GetCartridgeTarget(const std::vector<std::uint8_t>& rom) {
+bool GetCartridgeTarget(const std::vector<std::uint8_t>& rom,
+                        CartridgeTarget& target, std::string& error) {
   std::uint8_t value = rom[0x143];
   switch (value) {
     case 0x80:
-      return CartridgeTarget::kGbAndGbc;
+      target = CartridgeTarget::kGbAndGbc;
+      return true;
     case 0xC0:
-      return CartridgeTarget::kGbc;
+      target = CartridgeTarget::kGbc;
+      return true;
     default:
       if (isprint(value) || (value == 0x00)) {
-        return CartridgeTarget::kGb;
-      } else {
-        Error("Invalid cartridge header at $0143: %d.",
-              static_cast<int>(value));
+        target = CartridgeTarget::kGb;
+        return true;
       }
+      error = InvalidHeaderMessage(0x143, value);
+      return false;
   }
 }
 
 // ROMの$0134から15または16バイトを取得
-std::string GetTitle(const std::vector<std::uint8_t>& rom) {
-  auto title_size = GetCartridgeTarget(rom) == CartridgeTarget::kGb ? 16 : 15;
+std::string GetTitle(const std::vector<std::uint8_t>& rom,
+                     CartridgeTarget target) {
+  auto title_size = target == CartridgeTarget::kGb ? 16 : 15;
   return std::string(reinterpret_cast<const char*>(&rom[0x134]), title_size);
 }
 
 // $0147（Cartridge type）を取得
-CartridgeType GetCartridgeType(const std::vector<std::uint8_t>& rom) {
+bool GetCartridgeType(const std::vector<std::uint8_t>& rom,
+                      CartridgeType& type, std::string& error) {
   std::uint8_t value = rom[0x147];
   switch (value) {
     case 0x00:
-      return CartridgeType::kRomOnly;
+      type = CartridgeType::kRomOnly;
+      return true;
     case 0x01:
-      return CartridgeType::kMbc1;
+      type = CartridgeType::kMbc1;
+      return true;
     case 0x02:
-      return CartridgeType::kMbc1Ram;
+      type = CartridgeType::kMbc1Ram;
+      return true;
     case 0x03:
-      return CartridgeType::kMbc1RamBattery;
+      type = CartridgeType::kMbc1RamBattery;
+      return true;
     default:
-      Error("Invalid cartridge header at $0147: %d.", static_cast<int>(value));
+      error = InvalidHeaderMessage(0x147, value);
+      return false;
   }
 }
 
 // $0148（ROM size）を取得
-unsigned GetRomSize(const std::vector<std::uint8_t>& rom) {
-  unsigned value = rom[0x148];
-  if (0 <= value && value <= 8) {
-    return (32 << value);
+bool GetRomSize(const std::vector<std::uint8_t>& rom, unsigned& size,
+                std::string& error) {
+  std::uint8_t value = rom[0x148];
+  if (value <= 8) {
+    size = 32 << value;
+    return true;
   }
-  Error("Invalid cartridge header at $0148: %d.", static_cast<int>(value));
+  error = InvalidHeaderMessage(0x148, value);
+  return false;
 }
 
 // $0149（RAM size）を取得
-unsigned GetRamSize(const std::vector<std::uint8_t>& rom) {
-  unsigned value = rom[0x149];
+bool GetRamSize(const std::vector<std::uint8_t>& rom, unsigned& size,
+                std::string& error) {
+  std::uint8_t value = rom[0x149];
   switch (value) {
     case 0x00:
-      return 0;
+      size = 0;
+      return true;
     case 0x02:
-      return 8;
+      size = 8;
+      return true;
     case 0x03:
-      return 32;
+      size = 32;
+      return true;
     case 0x04:
-      return 128;
+      size = 128;
+      return true;
     case 0x05:
-      return 64;
+      size = 64;
+      return true;
     default:
-      Error("Invalid cartridge header at $0149: %d.", static_cast<int>(value));
+      error = InvalidHeaderMessage(0x149, value);
+      return false;
   }
 }
 
@@ -111,23 +140,34 @@ std::string GetCartridgeTypeString(CartridgeType type) {
 }  // namespace
 
 void CartridgeHeader::Parse(const std::vector<std::uint8_t>& rom) {
+  std::string error;
+  if (!TryParse(rom, error)) {
+    Error("%s", error.c_str());
+  }
+}
+
+bool CartridgeHeader::TryParse(const std::vector<std::uint8_t>& rom,
+                               std::string& error) {
   auto size = rom.size();
   auto header_end_address = 0x150U;
   if (size < header_end_address) {
-    Error("ROM size is too small.");
+    error = "ROM size is too small.";
+    return false;
   }
 
-  title_ = GetTitle(rom);
-  target_ = GetCartridgeTarget(rom);
-  type_ = GetCartridgeType(rom);
-  rom_size_ = GetRomSize(rom);
-  ram_size_ = GetRamSize(rom);
+  if (!GetCartridgeTarget(rom, target_, error) ||
+      !GetCartridgeType(rom, type_, error) ||
+      !GetRomSize(rom, rom_size_, error) ||
+      !GetRamSize(rom, ram_size_, error)) {
+    return false;
+  }
+  title_ = GetTitle(rom, target_);
 
   if (!HasMbcWithRam() && (ram_size() != 0)) {
-    Error("Ram size is not consistent with cartridge type.");
+    error = "Ram size is not consistent with cartridge type.";
+    return false;
   }
-
-  Print();
+  return true;
 }
 
 bool CartridgeHeader::HasMbcWithRam() const {
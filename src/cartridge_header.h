@@ -52,8 +52,12 @@ class CartridgeHeader {
   CartridgeHeader() {}
 
   // ROMのヘッダーをパースしメンバ変数を設定する。
-  // 入力データが0x150バイトに満たない場合はエラーとしプログラムを終了する。
+  // 入力データが0x150バイトに満たない場合や、ヘッダーの値が不正な場合は
+  // エラーとしプログラムを終了する。
   void Parse(const std::vector<std::uint8_t>& rom);
+  // Parseと同じだが、不正な場合はプログラムを終了せずに、理由をerrorに
+  // 入れてfalseを返す。
+  bool TryParse(const std::vector<std::uint8_t>& rom, std::string& error);
   // RAMを内蔵しているか否かを返す。
   bool HasMbcWithRam() const;
 
@@ -61,15 +65,15 @@ class CartridgeHeader {
   unsigned rom_size() const { return rom_size_; }
   unsigned ram_size() const { return ram_size_; }
 
+  // 各メンバ変数の値を標準出力に出力する
+  void Print() const;
+
  private:
   std::string title_;
   CartridgeTarget target_;
   CartridgeType type_;
   unsigned rom_size_;  // 単位：KiB
   unsigned ram_size_;  // 単位：KiB
-
-  // 各メンバ変数の値を標準出力に出力する（デバッグ用）
-  void Print() const;
 };
 
 }  // namespace gbemu
@@ -1,5 +1,6 @@
 #include "command_line.h"
 
+#include <cstdlib>
 #include <string>
 
 #include "utils.h"
@@ -34,6 +35,107 @@ bool Options::Parse(int argc, char* argv[]) {
       }
       rom_file_name_ = argv[i];
       i++;
+    } else if (str == "--rewind") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      rewind_budget_mib_ = std::atoi(argv[i]);
+      i++;
+    } else if (str == "--run-ahead") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      run_ahead_frames_ = std::atoi(argv[i]);
+      i++;
+    } else if (str == "--run-ahead-instance") {
+      run_ahead_instance_ = true;
+      i++;
+    } else if (str == "--record-movie") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      movie_file_name_ = argv[i];
+      i++;
+    } else if (str == "--stats") {
+      stats_ = true;
+      i++;
+    } else if (str == "--stats-trace") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      stats_trace_file_name_ = argv[i];
+      stats_ = true;
+      i++;
+    } else if (str == "--guest-profile") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      guest_profile_file_name_ = argv[i];
+      i++;
+    } else if (str == "--render-thread") {
+      render_thread_ = true;
+      i++;
+    } else if (str == "--palette") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      palette_ = argv[i];
+      i++;
+    } else if (str == "--shm-export") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      shm_export_name_ = argv[i];
+      i++;
+    } else if (str == "--record") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      record_file_name_ = argv[i];
+      i++;
+    } else if (str == "--record-format") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      record_format_ = argv[i];
+      if (record_format_ != "y4m" && record_format_ != "rgb") {
+        return false;
+      }
+      i++;
+    } else if (str == "--record-audio") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      record_audio_file_name_ = argv[i];
+      i++;
+    } else if (str == "--record-frames") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      record_frames_file_name_ = argv[i];
+      i++;
+    } else if (str == "--pacing") {
+      i++;
+      if (i == argc) {
+        return false;
+      }
+      pacing_ = argv[i];
+      if (pacing_ != "auto" && pacing_ != "audio" && pacing_ != "vsync" &&
+          pacing_ != "free") {
+        return false;
+      }
+      i++;
     } else {
       return false;
     }
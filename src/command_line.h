@@ -14,12 +14,57 @@ class Options {
   bool has_boot_rom() { return has_boot_rom_; }
   std::string boot_rom_file_name() { return boot_rom_file_name_; }
   std::string rom_file_name() { return rom_file_name_; }
+  // 巻き戻し用に記録するスナップショットの上限（MiB）。0なら巻き戻しを無効にする。
+  unsigned rewind_budget_mib() { return rewind_budget_mib_; }
+  // 先読みするフレーム数。0なら先読みしない。
+  unsigned run_ahead_frames() { return run_ahead_frames_; }
+  // 先読みを別のインスタンスで行うかどうか。
+  bool run_ahead_instance() { return run_ahead_instance_; }
+  // キー入力を記録するムービーファイルの名前。空なら記録しない。
+  std::string movie_file_name() { return movie_file_name_; }
+  // 処理時間の統計を表示するかどうか。
+  bool stats() { return stats_; }
+  // 処理時間のトレースを書き出すファイルの名前。空なら書き出さない。
+  std::string stats_trace_file_name() { return stats_trace_file_name_; }
+  // ゲストのコードのプロファイルを書き出すファイルの名前。空ならプロファイルしない。
+  std::string guest_profile_file_name() { return guest_profile_file_name_; }
+  // ピクセルの生成を別のスレッドで行うかどうか。
+  bool render_thread() { return render_thread_; }
+  // 画面の4階調の色の指定（ParseDmgPaletteを参照）。空なら既定の色にする。
+  std::string palette() { return palette_; }
+  // 画面を書き込む共有メモリの名前。空なら書き込まない。
+  std::string shm_export_name() { return shm_export_name_; }
+  // 画面を記録するファイルの名前。"-"なら標準出力、空なら記録しない。
+  std::string record_file_name() { return record_file_name_; }
+  // 画面を記録する形式（"y4m"または"rgb"）。
+  std::string record_format() { return record_format_; }
+  // 音を記録するWAVファイルの名前。空なら記録しない。
+  std::string record_audio_file_name() { return record_audio_file_name_; }
+  // 画面を2ビットの差分で記録するファイルの名前。空なら記録しない。
+  std::string record_frames_file_name() { return record_frames_file_name_; }
+  // フレームの間隔の決め方（"auto"、"audio"、"vsync"、"free"）。
+  std::string pacing() { return pacing_; }
 
  private:
   bool debug_;
   bool has_boot_rom_;
   std::string boot_rom_file_name_;
   std::string rom_file_name_;
+  unsigned rewind_budget_mib_{32};
+  unsigned run_ahead_frames_{0};
+  bool run_ahead_instance_{false};
+  std::string movie_file_name_;
+  bool stats_{false};
+  std::string stats_trace_file_name_;
+  std::string guest_profile_file_name_;
+  bool render_thread_{false};
+  std::string palette_;
+  std::string shm_export_name_;
+  std::string record_file_name_;
+  std::string record_format_{"y4m"};
+  std::string record_audio_file_name_;
+  std::string record_frames_file_name_;
+  std::string pacing_{"auto"};
 };
 
 extern Options options;
@@ -9,6 +9,7 @@
 #include "instruction.h"
 #include "interrupt.h"
 #include "memory.h"
+#include "save_state.h"
 #include "utils.h"
 
 namespace gbemu {
@@ -108,6 +109,16 @@ void PrintInstruction(std::shared_ptr<Instruction> inst) {
 }  // namespace
 
 unsigned Cpu::Step() {
+  if (observer_ == nullptr) {
+    return ExecuteNext();
+  }
+  std::uint16_t pc = registers_.pc.get();
+  unsigned mcycles = ExecuteNext();
+  observer_->OnStep(pc, mcycles);
+  return mcycles;
+}
+
+unsigned Cpu::ExecuteNext() {
   // haltなら割り込みを確認。
   // haltバグは未実装。
   if (is_halted_) {
@@ -133,6 +144,7 @@ unsigned Cpu::Step() {
       memory_.Write16(sp - 2, pc);
       registers_.sp.set(sp - 2);
       registers_.pc.set(address);
+      NotifyCall(address);
       return 5;
     }
   }
@@ -149,4 +161,34 @@ unsigned Cpu::Step() {
   return mcycles;
 }
 
+void Cpu::SaveState(StateWriter& writer) const {
+  writer.Write(registers_.a.get());
+  writer.Write(registers_.b.get());
+  writer.Write(registers_.c.get());
+  writer.Write(registers_.d.get());
+  writer.Write(registers_.e.get());
+  writer.Write(registers_.h.get());
+  writer.Write(registers_.l.get());
+  writer.Write(registers_.flags.get());
+  writer.Write(registers_.sp.get());
+  writer.Write(registers_.pc.get());
+  writer.Write(registers_.ime);
+  writer.Write(is_halted_);
+}
+
+void Cpu::LoadState(StateReader& reader) {
+  registers_.a.set(reader.Read<std::uint8_t>());
+  registers_.b.set(reader.Read<std::uint8_t>());
+  registers_.c.set(reader.Read<std::uint8_t>());
+  registers_.d.set(reader.Read<std::uint8_t>());
+  registers_.e.set(reader.Read<std::uint8_t>());
+  registers_.h.set(reader.Read<std::uint8_t>());
+  registers_.l.set(reader.Read<std::uint8_t>());
+  registers_.flags.set(reader.Read<std::uint8_t>());
+  registers_.sp.set(reader.Read<std::uint16_t>());
+  registers_.pc.set(reader.Read<std::uint16_t>());
+  registers_.ime = reader.Read<bool>();
+  is_halted_ = reader.Read<bool>();
+}
+
 }  // namespace gbemu
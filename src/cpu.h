@@ -6,9 +6,26 @@
 
 #include "memory.h"
 #include "register.h"
+#include "save_state.h"
 
 namespace gbemu {
 
+// CPUの実行の流れを受け取るインターフェース。ゲストのコードのプロファイルに使う。
+class CpuObserver {
+ public:
+  // このクラスは継承されるためデストラクタは仮想関数にする。
+  virtual ~CpuObserver() = default;
+  // call、rst、割り込みで分岐したときに呼ばれる。
+  // spは戻りアドレスを積んだ後の値。
+  virtual void OnCall(std::uint16_t target, std::uint16_t sp) = 0;
+  // ret、retiで戻ったとき（条件付きのretは条件が成立したときのみ）に呼ばれる。
+  // spは戻りアドレスを降ろした後の値。
+  virtual void OnReturn(std::uint16_t sp) = 0;
+  // 1命令（割り込みの処理とHALT中の1サイクルも1命令と数える）を実行した後に呼ばれる。
+  // pcはその命令を実行する前のPC、mcyclesは経過したM-cycle数。
+  virtual void OnStep(std::uint16_t pc, unsigned mcycles) = 0;
+};
+
 // CPUを表すクラス。
 // Example:
 //   std::vector<std::uint8_t> rom = LoadRom();
@@ -79,13 +96,41 @@ class Cpu {
   // haltする
   void Halt() { is_halted_ = true; }
 
+  // 実行の流れを受け取るオブザーバを設定する。nullptrで解除する。
+  void set_observer(CpuObserver* observer) { observer_ = observer; }
+
+  // call、rst、割り込みで分岐したことをオブザーバに通知する。
+  // 戻りアドレスを積んでPCを変更した後に呼ぶこと。
+  void NotifyCall(std::uint16_t target) {
+    if (observer_ != nullptr) {
+      observer_->OnCall(target, registers_.sp.get());
+    }
+  }
+
+  // ret、retiで戻ったことをオブザーバに通知する。
+  // 戻りアドレスを降ろした後に呼ぶこと。
+  void NotifyReturn() {
+    if (observer_ != nullptr) {
+      observer_->OnReturn(registers_.sp.get());
+    }
+  }
+
+  // 状態をセーブステートに書き出す。
+  void SaveState(StateWriter& writer) const;
+  // セーブステートから状態を復元する。
+  void LoadState(StateReader& reader);
+
   Registers& registers() { return registers_; }
   Memory& memory() { return memory_; }
 
  private:
+  // Step()の本体。割り込みの処理か1命令の実行を行う。
+  unsigned ExecuteNext();
+
   Registers registers_;
   Memory& memory_;
   Interrupt& interrupt_;
+  CpuObserver* observer_{nullptr};
 
   bool is_halted_{false};
 };
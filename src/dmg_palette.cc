@@ -0,0 +1,71 @@
+#include "dmg_palette.h"
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "lcd.h"
+
+namespace gbemu {
+
+namespace {
+
+struct NamedPalette {
+  const char* name;
+  DmgPalette palette;
+};
+
+// 組み込みのパレット
+const NamedPalette kNamedPalettes[] = {
+    {"gray", kDefaultDmgPalette},
+    // 初代ゲームボーイの緑がかった液晶
+    {"green", {{0x9BBC0F, 0x8BAC0F, 0x306230, 0x0F380F}}},
+    // ゲームボーイポケットの白黒液晶
+    {"pocket", {{0xC4CFA1, 0x8B956D, 0x4D533C, 0x1F1F1F}}},
+};
+
+// 6桁の16進数を解釈する。
+bool ParseRgb(const std::string& str, std::uint32_t& rgb) {
+  if (str.size() != 6) {
+    return false;
+  }
+  std::uint32_t value = 0;
+  for (char c : str) {
+    if (!std::isxdigit(static_cast<unsigned char>(c))) {
+      return false;
+    }
+    value = value * 16 + std::stoi(std::string(1, c), nullptr, 16);
+  }
+  rgb = value;
+  return true;
+}
+
+}  // namespace
+
+bool ParseDmgPalette(const std::string& spec, DmgPalette& palette) {
+  for (const NamedPalette& named : kNamedPalettes) {
+    if (spec == named.name) {
+      palette = named.palette;
+      return true;
+    }
+  }
+
+  DmgPalette parsed;
+  std::size_t begin = 0;
+  for (int i = 0; i < lcd::kColorNum; i++) {
+    std::size_t end = spec.find(',', begin);
+    bool is_last = i == lcd::kColorNum - 1;
+    if ((end == std::string::npos) != is_last) {
+      return false;
+    }
+    if (!ParseRgb(spec.substr(begin, end - begin), parsed.colors[i])) {
+      return false;
+    }
+    begin = end + 1;
+  }
+  palette = parsed;
+  return true;
+}
+
+}  // namespace gbemu
@@ -0,0 +1,31 @@
+#ifndef GBEMU_DMG_PALETTE_H_
+#define GBEMU_DMG_PALETTE_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "lcd.h"
+
+namespace gbemu {
+
+// LCDの4階調を表示するときの色。
+// 各要素はGbLcdColorの値（0が最も明るい）に対応する0xRRGGBBの値。
+struct DmgPalette {
+  std::array<std::uint32_t, lcd::kColorNum> colors;
+};
+
+// 既定のパレット（灰色の4階調）。
+constexpr DmgPalette kDefaultDmgPalette{
+    {0xE8E8E8, 0xA0A0A0, 0x585858, 0x101010}};
+
+// パレットの指定を解釈する。指定は次のいずれか。
+// - 組み込みのパレットの名前（gray、green、pocket）
+// - 明るい順に並べた4色の16進数のRRGGBBをカンマで区切ったもの
+//   （例: "9bbc0f,8bac0f,306230,0f380f"）
+// 解釈できなければpaletteを変更せずにfalseを返す。
+bool ParseDmgPalette(const std::string& spec, DmgPalette& palette);
+
+}  // namespace gbemu
+
+#endif  // GBEMU_DMG_PALETTE_H_
@@ -0,0 +1,34 @@
+#include "frame_hash.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "ppu.h"
+
+namespace gbemu {
+
+std::uint64_t HashFrame(const GbLcdPixelMatrix& frame) {
+  // 4ピクセルを1バイトに詰めてからFNV-1aでハッシュする
+  constexpr std::uint64_t kFnvOffsetBasis = 0xCBF29CE484222325ULL;
+  constexpr std::uint64_t kFnvPrime = 0x100000001B3ULL;
+  std::uint64_t hash = kFnvOffsetBasis;
+  for (const GbLcdPixelRow& row : frame) {
+    for (int i = 0; i < lcd::kWidth; i += 4) {
+      std::uint8_t packed = (row[i] & 3) | ((row[i + 1] & 3) << 2) |
+                            ((row[i + 2] & 3) << 4) | ((row[i + 3] & 3) << 6);
+      hash ^= packed;
+      hash *= kFnvPrime;
+    }
+  }
+  return hash;
+}
+
+std::string FrameHashToString(std::uint64_t hash) {
+  char buf[17];
+  std::snprintf(buf, sizeof(buf), "%016llX",
+                static_cast<unsigned long long>(hash));
+  return std::string(buf);
+}
+
+}  // namespace gbemu
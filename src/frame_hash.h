@@ -0,0 +1,20 @@
+#ifndef GBEMU_FRAME_HASH_H_
+#define GBEMU_FRAME_HASH_H_
+
+#include <cstdint>
+#include <string>
+
+#include "ppu.h"
+
+namespace gbemu {
+
+// 画面のハッシュ値を計算する（非暗号学的ハッシュ）。
+// 各ピクセルの色だけから計算するので、バッファの内部表現には依存しない。
+std::uint64_t HashFrame(const GbLcdPixelMatrix& frame);
+
+// ハッシュ値を16桁の16進数の文字列にする。
+std::string FrameHashToString(std::uint64_t hash);
+
+}  // namespace gbemu
+
+#endif  // GBEMU_FRAME_HASH_H_
@@ -0,0 +1,66 @@
+#include "frame_pacer.h"
+
+#include <string>
+
+#include "audio.h"
+#include "gameboy.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+// 1秒あたりのフレーム数（4194304Hz / 70224サイクル）
+constexpr double kFramesPerSecond = 4194304.0 / GameBoy::kCyclesPerFrame;
+
+}  // namespace
+
+bool ParsePacingMode(const std::string& name, PacingMode& mode) {
+  if (name == "auto") {
+    mode = PacingMode::kAuto;
+  } else if (name == "audio") {
+    mode = PacingMode::kAudio;
+  } else if (name == "vsync") {
+    mode = PacingMode::kVsync;
+  } else if (name == "free") {
+    mode = PacingMode::kFree;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* GetPacingModeName(PacingMode mode) {
+  switch (mode) {
+    case PacingMode::kAuto:
+      return "auto";
+    case PacingMode::kAudio:
+      return "audio";
+    case PacingMode::kVsync:
+      return "vsync";
+    case PacingMode::kFree:
+      return "free";
+  }
+  UNREACHABLE("Unknown pacing mode.");
+}
+
+FramePacer::FramePacer(PacingMode mode, Audio& audio, int refresh_rate)
+    : mode_(mode), audio_(audio) {
+  ASSERT(mode_ != PacingMode::kAuto, "The pacing mode must be resolved.");
+  if (mode_ == PacingMode::kVsync) {
+    ASSERT(refresh_rate > 0, "Invalid refresh rate: %d", refresh_rate);
+    // 60Hzのディスプレイでは実機より約0.46%速く進むので、そのぶん音を低くせずに
+    // 済むように入力のサンプルレートを上げる
+    audio_.set_speed(refresh_rate / kFramesPerSecond);
+  } else {
+    audio_.set_speed(1.0);
+  }
+}
+
+void FramePacer::EndFrame() {
+  if (mode_ == PacingMode::kAudio) {
+    audio_.WaitForPlayback();
+  }
+}
+
+}  // namespace gbemu
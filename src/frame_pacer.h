@@ -0,0 +1,55 @@
+#ifndef GBEMU_FRAME_PACER_H_
+#define GBEMU_FRAME_PACER_H_
+
+#include <string>
+
+#include "audio.h"
+
+namespace gbemu {
+
+// フレームを進める間隔の決め方。
+enum class PacingMode {
+  // 垂直同期が使えればkVsync、使えなければkAudioにする
+  kAuto,
+  // 音の再生を基準にする。再生待ちのサンプルが目標の量に減るまで待ってから
+  // 次のフレームに進むので、実機のフレームレート（約59.73fps）で進む
+  kAudio,
+  // ディスプレイの垂直同期で待つ。リフレッシュレートと実機のフレームレートの
+  // 差は、音の変換の比を変えて吸収する
+  kVsync,
+  // 待たずに最速で進める。溢れた音は捨てる
+  kFree,
+};
+
+// "auto"、"audio"、"vsync"、"free"を読む。それ以外ならfalseを返す。
+bool ParsePacingMode(const std::string& name, PacingMode& mode);
+// 表示用の名前を返す。
+const char* GetPacingModeName(PacingMode mode);
+
+// フロントエンドのフレームの間隔を決めるクラス。
+// Example:
+//   FramePacer pacer(PacingMode::kAudio, audio);
+//   for (;;) {
+//     gb.Step();
+//     renderer.Render(gb.GetPpuBuffer());
+//     pacer.EndFrame();
+//   }
+class FramePacer {
+ public:
+  // modeはkAuto以外。kVsyncならrefresh_rateにディスプレイの
+  // リフレッシュレート（Hz）を渡す。
+  FramePacer(PacingMode mode, Audio& audio, int refresh_rate = 0);
+
+  // 1フレームを表示し終えたら呼ぶ。必要なら次のフレームまで待つ。
+  void EndFrame();
+
+  PacingMode mode() const { return mode_; }
+
+ private:
+  PacingMode mode_;
+  Audio& audio_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_FRAME_PACER_H_
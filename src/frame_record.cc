@@ -0,0 +1,276 @@
+#include "frame_record.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "byte_io.h"
+#include "lcd.h"
+#include "pixel_lz.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+constexpr char kFrameRecordMagic[4] = {'G', 'B', 'F', 'R'};
+constexpr char kIndexMagic[4] = {'G', 'B', 'F', 'I'};
+// 形式を変えたら上げる
+constexpr std::uint32_t kFrameRecordVersion = 2;
+
+constexpr char kKeyframeTag = 'K';
+constexpr char kDeltaTag = 'D';
+constexpr char kEndTag = 'E';
+
+// 1フレームを1ピクセル2ビットに詰めたときのバイト数
+constexpr std::size_t kPackedSize = lcd::kTotalPixelNum / 4;
+// 差分がこれより大きいときだけキーフレームにするか比べる
+constexpr std::size_t kKeyframeCheckSize = kPackedSize / 2;
+// 末尾の"GBFI"と'E'の位置
+constexpr std::size_t kTrailerSize = sizeof(kIndexMagic) + 8;
+
+static_assert(sizeof(GbLcdPixelMatrix) == lcd::kTotalPixelNum);
+
+void Flatten(const GbLcdPixelMatrix& frame, std::vector<std::uint8_t>& pixels) {
+  pixels.resize(lcd::kTotalPixelNum);
+  std::memcpy(pixels.data(), frame.data(), lcd::kTotalPixelNum);
+}
+
+// pixelsの値はDecodePixelLzで復元した0〜3
+void Unflatten(const std::vector<std::uint8_t>& pixels,
+               GbLcdPixelMatrix& frame) {
+  std::memcpy(frame.data(), pixels.data(), lcd::kTotalPixelNum);
+}
+
+bool ReadMagic(std::istream& in, const char (&magic)[4]) {
+  char bytes[4];
+  in.read(bytes, sizeof(bytes));
+  return in.gcount() == sizeof(bytes) &&
+         std::memcmp(bytes, magic, sizeof(bytes)) == 0;
+}
+
+}  // namespace
+
+FrameRecordWriter::FrameRecordWriter(std::ostream& out,
+                                     unsigned keyframe_interval)
+    : out_(out),
+      keyframe_interval_(keyframe_interval),
+      previous_(lcd::kTotalPixelNum),
+      blank_(lcd::kTotalPixelNum) {
+  ASSERT(keyframe_interval_ > 0, "keyframe_interval must be positive.");
+  record_.assign(kFrameRecordMagic,
+                 kFrameRecordMagic + sizeof(kFrameRecordMagic));
+  AppendLittleEndian(record_, kFrameRecordVersion);
+  WriteRecord();
+}
+
+FrameRecordWriter::~FrameRecordWriter() { Finish(); }
+
+void FrameRecordWriter::PushFrame(const GbLcdPixelMatrix& frame,
+                                  std::uint64_t /* vblank_ns */) {
+  ASSERT(!is_finished_, "The frame record is already finished.");
+  Flatten(frame, pixels_);
+  bool is_keyframe = num_frames_ == 0 ||
+                     frames_since_keyframe_ + 1 >= keyframe_interval_;
+  if (!is_keyframe) {
+    encoder_.Encode(pixels_.data(), previous_.data(), lcd::kTotalPixelNum,
+                    delta_);
+  }
+  // 差分が大きいとき（場面が切り替わったときなど）だけキーフレームも作って
+  // 比べる。同じ大きさなら差分にする
+  if (is_keyframe || delta_.size() > kKeyframeCheckSize) {
+    encoder_.Encode(pixels_.data(), blank_.data(), lcd::kTotalPixelNum,
+                    intra_);
+    is_keyframe = is_keyframe || intra_.size() < delta_.size();
+  }
+  const std::vector<std::uint8_t>& payload = is_keyframe ? intra_ : delta_;
+
+  if (is_keyframe) {
+    keyframes_.emplace_back(num_frames_, num_bytes_);
+    frames_since_keyframe_ = 0;
+  } else {
+    frames_since_keyframe_++;
+  }
+  record_.clear();
+  record_.push_back(is_keyframe ? kKeyframeTag : kDeltaTag);
+  AppendVarint(record_, payload.size());
+  record_.insert(record_.end(), payload.begin(), payload.end());
+  WriteRecord();
+
+  previous_.swap(pixels_);
+  num_frames_++;
+}
+
+void FrameRecordWriter::Finish() {
+  if (is_finished_) {
+    return;
+  }
+  is_finished_ = true;
+
+  std::uint64_t end_offset = num_bytes_;
+  record_.clear();
+  record_.push_back(kEndTag);
+  AppendLittleEndian(record_, num_frames_);
+  AppendLittleEndian(record_, static_cast<std::uint32_t>(keyframes_.size()));
+  for (auto [frame, offset] : keyframes_) {
+    AppendLittleEndian(record_, frame);
+    AppendLittleEndian(record_, offset);
+  }
+  record_.insert(record_.end(), kIndexMagic, kIndexMagic + sizeof(kIndexMagic));
+  AppendLittleEndian(record_, end_offset);
+  WriteRecord();
+  out_.flush();
+}
+
+void FrameRecordWriter::WriteRecord() {
+  out_.write(reinterpret_cast<const char*>(record_.data()), record_.size());
+  if (out_.fail()) {
+    Error("Failed to write the frame record.");
+  }
+  num_bytes_ += record_.size();
+}
+
+bool FrameRecordReader::Open() {
+  std::uint32_t version;
+  if (!ReadMagic(in_, kFrameRecordMagic) || !ReadLittleEndian(in_, version) ||
+      version != kFrameRecordVersion) {
+    return false;
+  }
+  records_begin_ = sizeof(kFrameRecordMagic) + sizeof(version);
+  if (!ReadIndex()) {
+    ScanRecords();
+  }
+  // 最初のフレームはつねにキーフレームになっている
+  if (keyframes_.empty() || keyframes_.front().first != 0) {
+    num_frames_ = 0;
+  }
+  current_.resize(lcd::kTotalPixelNum);
+  next_.resize(lcd::kTotalPixelNum);
+  blank_.assign(lcd::kTotalPixelNum, 0);
+  has_current_ = false;
+  return true;
+}
+
+bool FrameRecordReader::ReadIndex() {
+  keyframes_.clear();
+  in_.clear();
+  std::uint64_t end_offset;
+  std::uint64_t num_frames;
+  std::uint32_t num_keyframes;
+  char tag;
+  if (!in_.seekg(-static_cast<std::streamoff>(kTrailerSize), std::ios::end) ||
+      !ReadMagic(in_, kIndexMagic) || !ReadLittleEndian(in_, end_offset) ||
+      end_offset < records_begin_ ||
+      !in_.seekg(static_cast<std::streamoff>(end_offset)) || !in_.get(tag) ||
+      tag != kEndTag || !ReadLittleEndian(in_, num_frames) ||
+      !ReadLittleEndian(in_, num_keyframes)) {
+    return false;
+  }
+  for (std::uint32_t i = 0; i < num_keyframes; i++) {
+    std::uint64_t frame, offset;
+    if (!ReadLittleEndian(in_, frame) || !ReadLittleEndian(in_, offset) ||
+        frame >= num_frames || offset < records_begin_ ||
+        offset >= end_offset ||
+        (!keyframes_.empty() && frame <= keyframes_.back().first)) {
+      keyframes_.clear();
+      return false;
+    }
+    keyframes_.emplace_back(frame, offset);
+  }
+  num_frames_ = num_frames;
+  is_complete_ = true;
+  return true;
+}
+
+void FrameRecordReader::ScanRecords() {
+  keyframes_.clear();
+  in_.clear();
+  in_.seekg(static_cast<std::streamoff>(records_begin_));
+  std::uint64_t frame = 0;
+  for (;;) {
+    std::uint64_t offset = static_cast<std::uint64_t>(in_.tellg());
+    char tag;
+    std::uint64_t size;
+    if (!in_.get(tag)) {
+      break;
+    }
+    if (tag == kEndTag) {
+      is_complete_ = true;
+      break;
+    }
+    if ((tag != kKeyframeTag && tag != kDeltaTag) || !ReadVarint(in_, size) ||
+        size > 2 * kPackedSize) {
+      break;
+    }
+    in_.ignore(static_cast<std::streamsize>(size));
+    if (static_cast<std::uint64_t>(in_.gcount()) != size) {
+      break;
+    }
+    if (tag == kKeyframeTag) {
+      keyframes_.emplace_back(frame, offset);
+    }
+    frame++;
+  }
+  num_frames_ = frame;
+}
+
+bool FrameRecordReader::Read(std::uint64_t frame_number,
+                             GbLcdPixelMatrix& frame) {
+  if (frame_number >= num_frames_) {
+    return false;
+  }
+  // frame_number以前で最後のキーフレーム
+  auto keyframe = std::upper_bound(
+      keyframes_.begin(), keyframes_.end(), frame_number,
+      [](std::uint64_t n, const auto& entry) { return n < entry.first; });
+  --keyframe;
+  // キーフレームより後まで復元済みで、まだ通り過ぎていなければ続きから読む
+  if (!has_current_ || next_frame_ > frame_number ||
+      next_frame_ <= keyframe->first) {
+    in_.clear();
+    in_.seekg(static_cast<std::streamoff>(keyframe->second));
+    next_frame_ = keyframe->first;
+    has_current_ = false;
+  }
+  while (next_frame_ <= frame_number) {
+    if (!DecodeRecord()) {
+      has_current_ = false;
+      return false;
+    }
+    has_current_ = true;
+    next_frame_++;
+  }
+  Unflatten(current_, frame);
+  return true;
+}
+
+bool FrameRecordReader::DecodeRecord() {
+  char tag;
+  std::uint64_t size;
+  if (!in_.get(tag) || (tag != kKeyframeTag && tag != kDeltaTag) ||
+      !ReadVarint(in_, size) || size > 2 * kPackedSize) {
+    return false;
+  }
+  payload_.resize(size);
+  in_.read(reinterpret_cast<char*>(payload_.data()), size);
+  if (static_cast<std::uint64_t>(in_.gcount()) != size) {
+    return false;
+  }
+  if (tag == kDeltaTag && !has_current_) {
+    return false;
+  }
+  const std::vector<std::uint8_t>& reference =
+      tag == kKeyframeTag ? blank_ : current_;
+  if (!DecodePixelLz(payload_.data(), payload_.size(), reference.data(),
+                     next_.data(), next_.size())) {
+    return false;
+  }
+  current_.swap(next_);
+  return true;
+}
+
+}  // namespace gbemu
@@ -0,0 +1,151 @@
+#ifndef GBEMU_FRAME_RECORD_H_
+#define GBEMU_FRAME_RECORD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "frame_sink.h"
+#include "lcd.h"
+#include "pixel_lz.h"
+
+namespace gbemu {
+
+// 画面の列を小さく記録する形式（学習用のデータセットやプレイの記録向け）。
+// 数値はリトルエンディアンで、varintは7ビットずつ下位から詰めた可変長整数。
+//   "GBFR"  u32 バージョン
+//   レコードの列
+//   "GBFI"  u64 'E'レコードの位置（ファイルの先頭からのバイト数）
+// 各フレームは行優先に並べた1ピクセル1バイトの23040ピクセルとして扱い、
+// PixelLzEncoderで符号化する（リテラルは1ピクセル2ビットに詰める）。
+// 各レコードはタグ（1バイト）とタグごとのデータからなる。
+//   'K'  varint サイズ  真っ白な画面（すべて0）を辞書にした符号。キーフレーム。
+//   'D'  varint サイズ  直前のフレームを辞書にした符号。
+//   'E'  u64 フレーム数  u32 キーフレームの数
+//        （u64 フレームの番号  u64 'K'レコードの位置）× キーフレームの数
+// 'E'はキーフレームの索引を兼ねた終端で、任意のフレームを直前のキーフレームから
+// 復元できる。末尾の12バイトで'E'の位置が分かる。終端がない（記録中に
+// 中断された）ファイルは、先頭からレコードをたどって読める所まで読む。
+
+// 画面の列を記録するFrameSink。
+// Example:
+//   std::ofstream ofs("play.gbfr", std::ios::binary);
+//   FrameRecordWriter writer(ofs);
+//   for (;;) {
+//     gb.Step();
+//     writer.PushFrame(gb.GetPpuBuffer(), GetMonotonicNs());
+//   }
+//   writer.Finish();
+class FrameRecordWriter : public FrameSink {
+ public:
+  // ヘッダを書き出す。少なくともkeyframe_intervalフレームごとに
+  // キーフレームを置く。差分が大きく、キーフレームのほうが小さければ
+  // （場面が切り替わったときなど）その場でキーフレームにする。
+  explicit FrameRecordWriter(std::ostream& out,
+                             unsigned keyframe_interval = 600);
+  // Finishを呼んでいなければ呼ぶ。
+  ~FrameRecordWriter() override;
+
+  FrameRecordWriter(const FrameRecordWriter&) = delete;
+  FrameRecordWriter& operator=(const FrameRecordWriter&) = delete;
+
+  void PushFrame(const GbLcdPixelMatrix& frame,
+                 std::uint64_t vblank_ns) override;
+
+  // 終端と索引を書き出す。以降は何も記録しない。
+  void Finish();
+
+  std::uint64_t num_frames() const { return num_frames_; }
+  // これまでに書き出したバイト数。
+  std::uint64_t num_bytes() const { return num_bytes_; }
+
+ private:
+  // record_を書き出す。失敗したらプログラムを終了する。
+  void WriteRecord();
+
+  std::ostream& out_;
+  unsigned keyframe_interval_;
+  std::uint64_t num_frames_{0};
+  std::uint64_t num_bytes_{0};
+  unsigned frames_since_keyframe_{0};
+  // 索引。（フレームの番号、'K'レコードの位置）の列。
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> keyframes_;
+  PixelLzEncoder encoder_;
+  // 直前のフレームを1ピクセル1バイトに並べたもの
+  std::vector<std::uint8_t> previous_;
+  // 真っ白な画面
+  std::vector<std::uint8_t> blank_;
+  // 作業領域
+  std::vector<std::uint8_t> pixels_;
+  std::vector<std::uint8_t> delta_;
+  std::vector<std::uint8_t> intra_;
+  // 書き出すレコードを組み立てるバッファ
+  std::vector<std::uint8_t> record_;
+  bool is_finished_{false};
+};
+
+// 記録した画面の列を読み出すクラス。
+// Example:
+//   FrameRecordReader reader(ifs);
+//   if (!reader.Open()) {
+//     Error("Invalid frame record.");
+//   }
+//   GbLcdPixelMatrix frame;
+//   for (std::uint64_t i = 0; i < reader.num_frames(); i++) {
+//     reader.Read(i, frame);
+//   }
+class FrameRecordReader {
+ public:
+  explicit FrameRecordReader(std::istream& in) : in_(in) {}
+
+  FrameRecordReader(const FrameRecordReader&) = delete;
+  FrameRecordReader& operator=(const FrameRecordReader&) = delete;
+
+  // ヘッダと索引を読み込む。形式が違えばfalseを返す。
+  // 索引がなければ先頭からレコードをたどって作る。
+  bool Open();
+
+  // 読み出せるフレームの数。
+  std::uint64_t num_frames() const { return num_frames_; }
+  // キーフレームの数。
+  std::size_t num_keyframes() const { return keyframes_.size(); }
+  // 終端まで記録されていればtrue。
+  bool is_complete() const { return is_complete_; }
+
+  // 番号frame_number（0から数える）のフレームを読み出す。
+  // 直前に読んだフレームの次なら続きから、そうでなければ直前の
+  // キーフレームから復元する。範囲外か壊れていればfalseを返す。
+  bool Read(std::uint64_t frame_number, GbLcdPixelMatrix& frame);
+
+ private:
+  // 現在位置のレコードを読んでcurrent_に適用する。
+  bool DecodeRecord();
+  // 末尾から索引を読み込む。
+  bool ReadIndex();
+  // 先頭からレコードをたどって索引を作る。
+  void ScanRecords();
+
+  std::istream& in_;
+  // 最初のレコードの位置
+  std::uint64_t records_begin_{0};
+  std::uint64_t num_frames_{0};
+  bool is_complete_{false};
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> keyframes_;
+
+  // current_に復元済みのフレームの次の番号。
+  // ストリームはそのフレームのレコードの位置にある。
+  std::uint64_t next_frame_{0};
+  bool has_current_{false};
+  std::vector<std::uint8_t> current_;
+  // 作業領域
+  std::vector<std::uint8_t> next_;
+  std::vector<std::uint8_t> blank_;
+  std::vector<std::uint8_t> payload_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_FRAME_RECORD_H_
@@ -0,0 +1,25 @@
+#ifndef GBEMU_FRAME_SINK_H_
+#define GBEMU_FRAME_SINK_H_
+
+#include <cstdint>
+
+#include "lcd.h"
+
+namespace gbemu {
+
+// 完成した画面の出力先のインターフェース。
+// フロントエンドが表示する画面を1フレームごとに渡す。
+class FrameSink {
+ public:
+  // このクラスは継承されるためデストラクタは仮想関数にする。
+  virtual ~FrameSink() = default;
+  // 完成した1フレーム分の画面を受け取る。
+  // vblank_nsはエミュレータがそのフレームを完成させた時刻（GetMonotonicNs）。
+  // 先読みしていても本来のフレームを進め終えた時刻になる。
+  virtual void PushFrame(const GbLcdPixelMatrix& frame,
+                         std::uint64_t vblank_ns) = 0;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_FRAME_SINK_H_
@@ -1,17 +1,172 @@
 #include "gameboy.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "save_state.h"
+#include "utils.h"
+
 namespace gbemu {
 
-void GameBoy::Step() {
-  while (!ppu_.IsBufferReady()) {
+namespace {
+
+// セーブステートの先頭に置く識別子。
+constexpr char kStateMagic[4] = {'G', 'B', 'S', 'T'};
+
+// セーブステートのヘッダ。
+// 識別子、バージョン、ペイロードのサイズ、カートリッジのRAMサイズからなる。
+constexpr std::size_t kStateHeaderSize = sizeof(kStateMagic) + 4 * 3;
+
+// 何も計測しないProbe。呼び出しはすべてインライン展開されて消える。
+struct NullProbe {
+  void Begin() {}
+  void End(StepProfile::Component) {}
+};
+
+// 直前の計測点からの経過時間をコンポーネントに加算するProbe。
+// tick単位で集計し、破棄するときにナノ秒に換算してプロファイルに加算する。
+class TimingProbe {
+ public:
+  explicit TimingProbe(StepProfile& profile) : profile_(profile) {}
+
+  ~TimingProbe() {
+    double ns_per_tick = ProfileClock::GetNanosecondsPerTick();
+    for (int i = 0; i < StepProfile::kNumComponents; i++) {
+      profile_.nanoseconds[i] +=
+          static_cast<std::uint64_t>(ticks_[i] * ns_per_tick);
+    }
+  }
+
+  void Begin() { last_ = ProfileClock::Now(); }
+
+  void End(StepProfile::Component component) {
+    std::uint64_t now = ProfileClock::Now();
+    ticks_[component] += now - last_;
+    last_ = now;
+    if (component == StepProfile::kCpu) {
+      profile_.instructions++;
+    }
+  }
+
+ private:
+  StepProfile& profile_;
+  std::uint64_t ticks_[StepProfile::kNumComponents]{};
+  std::uint64_t last_{0};
+};
+
+}  // namespace
+
+template <class Probe>
+void GameBoy::RunFrame(Probe& probe) {
+  // このフレームを描画するかどうか決める。LCDをオンにして始まったフレームは
+  // PPUが設定によらず描画するので、前のStep()から続くフレームも欠けない
+  bool is_render_frame = frames_until_render_ == 0;
+  frames_until_render_ =
+      is_render_frame ? render_interval_ - 1 : frames_until_render_ - 1;
+  is_frame_rendered_ = is_video_enabled_ && is_render_frame;
+  ppu_.set_rendering_enabled(is_frame_rendered_);
+
+  unsigned elapsed_tcycles = 0;
+  probe.Begin();
+  while (!ppu_.IsBufferReady() && elapsed_tcycles < kCyclesPerFrame) {
     unsigned mcycles = cpu_.Step();
+    probe.End(StepProfile::kCpu);
     unsigned tcycles = mcycles * 4;
     memory_.RunDma(mcycles);
+    probe.End(StepProfile::kDma);
     timer_.Run(tcycles);
+    probe.End(StepProfile::kTimer);
     apu_.Run(tcycles);
+    probe.End(StepProfile::kApu);
     ppu_.Run(tcycles);
+    probe.End(StepProfile::kPpu);
+    elapsed_tcycles += tcycles;
   }
   ppu_.ResetBufferReadyFlag();
+  // 別のスレッドで描画しているなら、このフレームの描画が終わるまで待つ
+  ppu_.FinishRendering();
+  elapsed_cycles_ += elapsed_tcycles;
+}
+
+void GameBoy::Step() {
+#ifdef GBEMU_ENABLE_STATS
+  if (profile_ != nullptr) {
+    StepWithProfile(*profile_);
+    return;
+  }
+#endif
+  NullProbe probe;
+  RunFrame(probe);
+}
+
+void GameBoy::StepWithProfile(StepProfile& profile) {
+  TimingProbe probe(profile);
+  RunFrame(probe);
+  profile.frames++;
+}
+
+void GameBoy::SaveState(std::vector<std::uint8_t>& buffer) const {
+  StateWriter writer(buffer);
+  writer.WriteBytes(kStateMagic, sizeof(kStateMagic));
+  writer.Write(kStateVersion);
+  std::size_t payload_size_offset = writer.size();
+  writer.Write(std::uint32_t{0});  // 後で書き換える
+  writer.Write(static_cast<std::uint32_t>(cartridge_->ram_size()));
+
+  cartridge_->SaveState(writer);
+  interrupt_.SaveState(writer);
+  ppu_.SaveState(writer);
+  apu_.SaveState(writer);
+  timer_.SaveState(writer);
+  joypad_.SaveState(writer);
+  serial_.SaveState(writer);
+  memory_.SaveState(writer);
+  cpu_.SaveState(writer);
+
+  writer.Overwrite(payload_size_offset,
+                   static_cast<std::uint32_t>(writer.size() - kStateHeaderSize));
+}
+
+std::vector<std::uint8_t> GameBoy::SaveState() const {
+  std::vector<std::uint8_t> buffer;
+  SaveState(buffer);
+  return buffer;
+}
+
+bool GameBoy::LoadState(const std::uint8_t* data, std::size_t size) {
+  // ヘッダを検証し、不正ならどのコンポーネントにも触れずに失敗する
+  if (size < kStateHeaderSize) {
+    return false;
+  }
+  StateReader reader(data, size);
+  char magic[sizeof(kStateMagic)];
+  reader.ReadBytes(magic, sizeof(magic));
+  if (std::memcmp(magic, kStateMagic, sizeof(magic)) != 0) {
+    return false;
+  }
+  if (reader.Read<std::uint32_t>() != kStateVersion) {
+    return false;
+  }
+  if (reader.Read<std::uint32_t>() != size - kStateHeaderSize) {
+    return false;
+  }
+  if (reader.Read<std::uint32_t>() != cartridge_->ram_size()) {
+    return false;
+  }
+
+  cartridge_->LoadState(reader);
+  interrupt_.LoadState(reader);
+  ppu_.LoadState(reader);
+  apu_.LoadState(reader);
+  timer_.LoadState(reader);
+  joypad_.LoadState(reader);
+  serial_.LoadState(reader);
+  memory_.LoadState(reader);
+  cpu_.LoadState(reader);
+  ASSERT(reader.remaining() == 0, "Save state has trailing bytes.");
+  return true;
 }
 
 }  // namespace gbemu
@@ -1,12 +1,14 @@
 #ifndef GBEMU_GAMEBOY_H_
 #define GBEMU_GAMEBOY_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "apu.h"
-#include "audio.h"
+#include "audio_sink.h"
 #include "cartridge.h"
 #include "cpu.h"
 #include "interrupt.h"
@@ -14,13 +16,15 @@
 #include "memory.h"
 #include "ppu.h"
 #include "serial.h"
+#include "step_profile.h"
 #include "timer.h"
+#include "utils.h"
 
 namespace gbemu {
 
 class GameBoy {
  public:
-  GameBoy(Cartridge* cartridge, Audio& audio,
+  GameBoy(Cartridge* cartridge, AudioSink& audio,
           std::vector<std::uint8_t>* boot_rom = nullptr)
       : cartridge_(cartridge),
         interrupt_(),
@@ -33,19 +37,118 @@ class GameBoy {
                 boot_rom),
         cpu_(memory_, interrupt_) {}
 
-  // 1フレーム進める
+  // 1フレーム進める。
+  // LCDが無効の間はフレームが完成しないので、1フレーム分のサイクル数だけ進める。
   void Step();
 
+  // Step()と同じく1フレーム進め、コンポーネントごとの処理時間をprofileに加算する。
+  // 計測のためのオーバーヘッドがあるので、速度そのものの計測にはStep()を使うこと。
+  void StepWithProfile(StepProfile& profile);
+
+  // 設定するとStep()でもprofileに処理時間を加算する（先読みなどで進めたフレームも含む）。
+  // nullptrで計測をやめる。GBEMU_ENABLE_STATSを定義せずにビルドした場合は無視する。
+  void set_profile(StepProfile* profile) { profile_ = profile; }
+
+  // CPUの実行の流れを受け取るオブザーバを設定する。nullptrで解除する。
+  void set_cpu_observer(CpuObserver* observer) { cpu_.set_observer(observer); }
+
+  // 電源投入から経過したT-cycle数。セーブステートには含めない。
+  std::uint64_t elapsed_cycles() const { return elapsed_cycles_; }
+
   // PPUのバッファを取得する
   const GbLcdPixelMatrix& GetPpuBuffer() const { return ppu_.GetBuffer(); }
 
+  // PPUのタイルのキャッシュの統計を取得する
+  const Ppu::TileCacheStats& GetTileCacheStats() const {
+    return ppu_.tile_cache_stats();
+  }
+
+  // PPUのバッファへ描画するかどうか設定する。次のStep()から反映する。
+  // 無効にしてもバッファが更新されないだけで、エミュレーションの結果は変わらない。
+  // ただしLCDをオンにして始まったフレームは、描画の設定によらず描画する。
+  // そのフレームはLCDをオンにしたStep()では完成せず、次のStep()で完成する
+  // ことがあり、途中から描画したのでは画面の上の方が古いまま残るため。
+  void set_video_enabled(bool enabled) { is_video_enabled_ = enabled; }
+
+  // nフレームごとに1フレームだけPPUのバッファへ描画するように設定する。
+  // 早送りや強化学習のフレームスキップで、表示しないフレームの描画を省くためのもの。
+  // 描画を省いたフレームでもタイミング、STAT、LY、割り込み、Windowの行カウンタは
+  // 描画したときと同じに進む。描画するのは呼び出し後のnフレーム目、2nフレーム目、...
+  // で、nが1（既定値）なら毎フレーム描画する。set_video_enabled(false)が優先する。
+  // 描画するフレームのStep()の後のバッファは、毎フレーム描画したときと同じになる
+  // （LCDをオンにしたフレームについてはset_video_enabledを参照）。
+  void set_render_interval(unsigned n) {
+    ASSERT(n > 0, "The render interval must be positive.");
+    render_interval_ = n;
+    frames_until_render_ = n - 1;
+  }
+
+  // 直前のStep()でPPUのバッファへ描画したかどうか。
+  bool is_frame_rendered() const { return is_frame_rendered_; }
+
+  // PPUのピクセルの生成を別のスレッドで行うかどうか設定する。
+  // 有効にすると、CPUのエミュレーションと前の行の描画が並行して進む。
+  // Step()はフレームの描画が終わるまで待ってから戻るので、
+  // 画面の内容もStep()の後に見える状態も無効のときと変わらない。
+  void set_render_thread_enabled(bool enabled) {
+    ppu_.set_render_thread_enabled(enabled);
+  }
+
+  // AudioSinkへサンプルを出力するかどうか設定する。
+  // 無効にしてもサンプルが出力されないだけで、エミュレーションの結果は変わらない。
+  void set_audio_enabled(bool enabled) { apu_.set_output_enabled(enabled); }
+
   // キーを押す。すでに押していたら何も起こらない。
   void PressKey(Joypad::Key key) { joypad_.PressKey(key); }
 
   // キーを離す。すでに離していたら何も起こらない。
   void ReleaseKey(Joypad::Key key) { joypad_.ReleaseKey(key); }
 
+  // キーが押されているかどうか調べる。
+  bool IsKeyPressed(Joypad::Key key) const {
+    return joypad_.IsKeyPressed(key);
+  }
+
+  // CPUから見たメモリの値を読み出す。
+  std::uint8_t Read8(std::uint16_t address) const {
+    return memory_.Read8(address);
+  }
+
+  // シリアル通信の送信データを標準出力せずに蓄積するようにする。
+  void CaptureSerialOutput() { serial_.StartCapture(); }
+
+  // 蓄積したシリアル通信の送信データを取得する。
+  const std::string& GetSerialOutput() const {
+    return serial_.captured_output();
+  }
+
+  // 現在の状態をセーブステートとしてbufferに書き出す。
+  // bufferの内容は置き換えられる。同じbufferを使い回せばメモリの確保は起きない。
+  // フレームの途中の状態は扱わないので、Step()の合間に呼ぶこと。
+  void SaveState(std::vector<std::uint8_t>& buffer) const;
+  std::vector<std::uint8_t> SaveState() const;
+
+  // セーブステートから状態を復元する。
+  // 形式やバージョン、カートリッジのRAMサイズが一致しない場合は
+  // 何も変更せずにfalseを返す。
+  bool LoadState(const std::uint8_t* data, std::size_t size);
+  bool LoadState(const std::vector<std::uint8_t>& state) {
+    return LoadState(state.data(), state.size());
+  }
+
+  // 1フレームの長さ（T-cycle数）。
+  static constexpr unsigned kCyclesPerFrame = 70224;
+
+  // セーブステートの形式のバージョン。
+  // 書き出す内容を変更したらインクリメントすること。
+  static constexpr std::uint32_t kStateVersion = 2;
+
  private:
+  // Step()とStepWithProfile()の本体。
+  // probeは各コンポーネントを進めるたびに呼び出す計測用のオブジェクト。
+  template <class Probe>
+  void RunFrame(Probe& probe);
+
   Cartridge* cartridge_;
   Interrupt interrupt_;
   Ppu ppu_;
@@ -55,6 +158,16 @@ class GameBoy {
   Serial serial_;
   Memory memory_;
   Cpu cpu_;
+
+  StepProfile* profile_{nullptr};
+  std::uint64_t elapsed_cycles_{0};
+
+  // 描画の設定。エミュレーションの状態ではないのでセーブステートには含めない。
+  bool is_video_enabled_{true};
+  unsigned render_interval_{1};
+  // 次に描画するフレームまでに描画を省くフレーム数
+  unsigned frames_until_render_{0};
+  bool is_frame_rendered_{false};
 };
 
 }  // namespace gbemu
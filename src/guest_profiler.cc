@@ -0,0 +1,139 @@
+#include "guest_profiler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cartridge.h"
+#include "utils.h"
+
+namespace gbemu {
+
+GuestProfiler::GuestProfiler(const Cartridge& cartridge, const Config& config)
+    : cartridge_(cartridge),
+      config_(config),
+      cycles_until_sample_(config.sample_interval) {
+  ASSERT(config_.sample_interval > 0, "sample_interval must be positive.");
+  ASSERT(config_.max_depth > 0, "max_depth must be positive.");
+}
+
+void GuestProfiler::OnCall(std::uint16_t target, std::uint16_t sp) {
+  // その命令のサンプルは呼び出し元で記録するので、スタックの変更はOnStepまで遅らせる
+  pending_ = Pending{Pending::kCall, target, sp};
+}
+
+void GuestProfiler::OnReturn(std::uint16_t sp) {
+  pending_ = Pending{Pending::kReturn, 0, sp};
+}
+
+void GuestProfiler::OnStep(std::uint16_t pc, unsigned mcycles) {
+  Sample(pc, mcycles);
+  switch (pending_.type) {
+    case Pending::kNone:
+      break;
+    case Pending::kCall:
+      PushFrame(pending_.target, pending_.sp);
+      break;
+    case Pending::kReturn:
+      PopFrames(pending_.sp);
+      break;
+  }
+  pending_.type = Pending::kNone;
+}
+
+void GuestProfiler::PushFrame(std::uint16_t target, std::uint16_t sp) {
+  // ld spなどでスタックを捨てた場合は、戻りアドレスが上書きされたフレームを捨てる
+  while (!stack_.empty() && stack_.back().sp <= sp) {
+    stack_.pop_back();
+  }
+  if (stack_.size() == config_.max_depth) {
+    stack_.erase(stack_.begin());
+  }
+  stack_.push_back(Frame{GetLocation(target), sp});
+}
+
+void GuestProfiler::PopFrames(std::uint16_t sp) {
+  // 戻りアドレスを降ろしたフレームと、それより内側のフレームを捨てる。
+  // 戻りアドレスを書き換えて複数のフレームを一度に抜けた場合もこれで対応できる。
+  while (!stack_.empty() && stack_.back().sp < sp) {
+    stack_.pop_back();
+  }
+}
+
+void GuestProfiler::Sample(std::uint16_t pc, unsigned mcycles) {
+  if (mcycles < cycles_until_sample_) {
+    cycles_until_sample_ -= mcycles;
+    return;
+  }
+  // この命令の間に何回サンプルの時点が来たか
+  mcycles -= cycles_until_sample_;
+  std::uint64_t num_samples = 1 + mcycles / config_.sample_interval;
+  cycles_until_sample_ =
+      config_.sample_interval - mcycles % config_.sample_interval;
+
+  key_.clear();
+  for (const Frame& frame : stack_) {
+    key_.push_back(frame.location);
+  }
+  key_.push_back(GetLocation(pc));
+  std::uint64_t cycles = num_samples * config_.sample_interval;
+  samples_[key_] += cycles;
+  total_cycles_ += cycles;
+}
+
+void GuestProfiler::WriteFoldedStacks(std::ostream& os) const {
+  for (const auto& [stack, cycles] : samples_) {
+    for (std::size_t i = 0; i < stack.size(); i++) {
+      if (i != 0) {
+        os << ';';
+      }
+      os << LocationToString(stack[i]);
+    }
+    os << ' ' << cycles << '\n';
+  }
+}
+
+std::vector<std::pair<std::string, std::uint64_t>>
+GuestProfiler::GetHotLocations(std::size_t n) const {
+  std::map<std::uint32_t, std::uint64_t> cycles_by_pc;
+  for (const auto& [stack, cycles] : samples_) {
+    cycles_by_pc[stack.back()] += cycles;
+  }
+  std::vector<std::pair<std::uint32_t, std::uint64_t>> sorted(
+      cycles_by_pc.begin(), cycles_by_pc.end());
+  std::stable_sort(
+      sorted.begin(), sorted.end(),
+      [](const auto& a, const auto& b) { return a.second > b.second; });
+  std::vector<std::pair<std::string, std::uint64_t>> result;
+  for (std::size_t i = 0; i < sorted.size() && i < n; i++) {
+    result.emplace_back(LocationToString(sorted[i].first), sorted[i].second);
+  }
+  return result;
+}
+
+void GuestProfiler::Clear() {
+  samples_.clear();
+  total_cycles_ = 0;
+  cycles_until_sample_ = config_.sample_interval;
+}
+
+std::uint32_t GuestProfiler::GetLocation(std::uint16_t address) const {
+  // ROM以外（WRAMやHRAMに置いたコード）はバンク0として扱う
+  unsigned bank = address < 0x8000 ? cartridge_.GetRomBank(address) : 0;
+  return (bank << 16) | address;
+}
+
+std::string GuestProfiler::LocationToString(std::uint32_t location) {
+  char buf[16];
+  std::snprintf(buf, sizeof(buf), "%02X:%04X", location >> 16,
+                location & 0xFFFF);
+  return std::string(buf);
+}
+
+}  // namespace gbemu
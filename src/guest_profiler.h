@@ -0,0 +1,100 @@
+#ifndef GBEMU_GUEST_PROFILER_H_
+#define GBEMU_GUEST_PROFILER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cartridge.h"
+#include "cpu.h"
+
+namespace gbemu {
+
+// ゲームのコードがどこでサイクルを消費しているかを調べるプロファイラ。
+// call、rst、割り込みとret、retiからゲストの呼び出しスタックを追跡し、
+// 一定のM-cycle数ごとに、その時点のスタックとPCをサンプルとして記録する。
+// スタックの各フレームは呼び出し先の（ROMバンク, アドレス）で表す。
+// 結果はflamegraph.plなどが読める折りたたみ形式（folded stacks）で書き出せる。
+// Example:
+//   GuestProfiler profiler(cartridge, GuestProfiler::Config{});
+//   gb.set_cpu_observer(&profiler);
+//   for (int i = 0; i < 600; i++) {
+//     gb.Step();
+//   }
+//   profiler.WriteFoldedStacks(std::cout);
+class GuestProfiler : public CpuObserver {
+ public:
+  struct Config {
+    // サンプルを記録する間隔（M-cycle数）
+    unsigned sample_interval{64};
+    // 追跡する呼び出しの深さの上限。超えたら最も外側のフレームを捨てる。
+    std::size_t max_depth{64};
+  };
+
+  GuestProfiler(const Cartridge& cartridge, const Config& config);
+
+  void OnCall(std::uint16_t target, std::uint16_t sp) override;
+  void OnReturn(std::uint16_t sp) override;
+  void OnStep(std::uint16_t pc, unsigned mcycles) override;
+
+  // 記録したスタックごとのM-cycle数を折りたたみ形式で書き出す。
+  // 1行が1つのスタックで、外側から順に「バンク:アドレス」を;で区切り、
+  // 最後のフレームはサンプルを記録した時点のPCになる。
+  void WriteFoldedStacks(std::ostream& os) const;
+
+  // サンプルを記録した時点のPCごとのM-cycle数を、多い順にn個まで返す。
+  std::vector<std::pair<std::string, std::uint64_t>> GetHotLocations(
+      std::size_t n) const;
+
+  // 記録したM-cycle数の合計。
+  std::uint64_t total_cycles() const { return total_cycles_; }
+
+  // 記録を捨てる。追跡中のスタックはそのまま残す。
+  void Clear();
+
+ private:
+  struct Frame {
+    // 呼び出し先の（ROMバンク << 16 | アドレス）
+    std::uint32_t location;
+    // 戻りアドレスを積んだ後のSP
+    std::uint16_t sp;
+  };
+
+  // 命令の実行中に通知された呼び出しまたは復帰
+  struct Pending {
+    enum Type { kNone, kCall, kReturn } type;
+    std::uint16_t target;
+    std::uint16_t sp;
+  };
+
+  // サンプルの時点が来ていれば現在のスタックとPCを記録する。
+  void Sample(std::uint16_t pc, unsigned mcycles);
+  // 呼び出し先のフレームを積む。
+  void PushFrame(std::uint16_t target, std::uint16_t sp);
+  // 戻りアドレスを降ろしたフレームとその内側のフレームを捨てる。
+  void PopFrames(std::uint16_t sp);
+
+  std::uint32_t GetLocation(std::uint16_t address) const;
+  static std::string LocationToString(std::uint32_t location);
+
+  const Cartridge& cartridge_;
+  Config config_;
+
+  std::vector<Frame> stack_;
+  Pending pending_{Pending::kNone, 0, 0};
+  // スタック（外側から順のlocation、最後はPC）ごとのM-cycle数
+  std::map<std::vector<std::uint32_t>, std::uint64_t> samples_;
+  std::uint64_t total_cycles_{0};
+  // 次のサンプルまでの残りM-cycle数
+  unsigned cycles_until_sample_;
+  // サンプルのキーの作業領域
+  std::vector<std::uint32_t> key_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_GUEST_PROFILER_H_
@@ -703,6 +703,7 @@ unsigned CallU16::Execute(Cpu& cpu) {
   std::uint16_t pc = cpu.registers().pc.get();
   Push(cpu, pc + length);
   cpu.registers().pc.set(imm_);
+  cpu.NotifyCall(imm_);
   return 6;
 }
 
@@ -737,6 +738,7 @@ std::string Ret::GetMnemonicString() { return "ret"; }
 unsigned Ret::Execute(Cpu& cpu) {
   std::uint16_t address = Pop(cpu);
   cpu.registers().pc.set(address);
+  cpu.NotifyReturn();
   return 4;
 }
 
@@ -931,6 +933,7 @@ unsigned CallCondU16::Execute(Cpu& cpu) {
   if (cond_) {
     Push(cpu, pc + length);
     cpu.registers().pc.set(imm_);
+    cpu.NotifyCall(imm_);
     return 6;
   } else {
     cpu.registers().pc.set(pc + length);
@@ -1342,6 +1345,7 @@ unsigned RetCond::Execute(Cpu& cpu) {
   if (cond_) {
     std::uint16_t address = Pop(cpu);
     cpu.registers().pc.set(address);
+    cpu.NotifyReturn();
     return 5;
   } else {
     cpu.registers().pc.set(pc + length);
@@ -2954,6 +2958,7 @@ unsigned Reti::Execute(Cpu& cpu) {
   std::uint16_t address = Pop(cpu);
   cpu.registers().pc.set(address);
   cpu.registers().ime = true;
+  cpu.NotifyReturn();
   return 4;
 }
 
@@ -2968,6 +2973,7 @@ unsigned Rst::Execute(Cpu& cpu) {
   std::uint16_t address = imm_ << 3;
   Push(cpu, pc + length);
   cpu.registers().pc.set(address);
+  cpu.NotifyCall(address);
   return 4;
 }
 
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include "save_state.h"
 #include "utils.h"
 
 namespace gbemu {
@@ -36,6 +37,16 @@ InterruptSource Interrupt::GetRequestedInterrupt() const {
   return source;
 }
 
+void Interrupt::SaveState(StateWriter& writer) const {
+  writer.Write(if_);
+  writer.Write(ie_);
+}
+
+void Interrupt::LoadState(StateReader& reader) {
+  if_ = reader.Read<std::uint8_t>();
+  ie_ = reader.Read<std::uint8_t>();
+}
+
 void Interrupt::SetIfBit(InterruptSource source) {
   int bit_pos = static_cast<int>(source);
   if_ |= 1 << bit_pos;
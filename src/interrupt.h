@@ -3,6 +3,8 @@
 
 #include <cstdint>
 
+#include "save_state.h"
+
 namespace gbemu {
 
 // 割り込み要因の一覧。
@@ -38,6 +40,11 @@ class Interrupt {
   void SetIeBit(InterruptSource source);
   void ResetIeBit(InterruptSource source);
 
+  // 状態をセーブステートに書き出す。
+  void SaveState(StateWriter& writer) const;
+  // セーブステートから状態を復元する。
+  void LoadState(StateReader& reader);
+
  private:
   std::uint8_t if_;  // Interrupt flag (IF)
   std::uint8_t ie_;  // Interrupt enable (IE)
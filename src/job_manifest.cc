@@ -0,0 +1,95 @@
+#include "job_manifest.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_roms.h"
+#include "key_input.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+constexpr char kBuiltinPrefix[] = "builtin:";
+
+// 行から#以降を取り除く
+std::string StripComment(const std::string& line) {
+  return line.substr(0, line.find('#'));
+}
+
+}  // namespace
+
+Manifest::Manifest(const std::string& path)
+    : base_dir_(std::filesystem::path(path).parent_path()) {
+  std::ifstream ifs(path);
+  if (ifs.fail()) {
+    Error("File cannot open: %s", path.c_str());
+  }
+
+  std::string line;
+  unsigned line_number = 0;
+  while (std::getline(ifs, line)) {
+    line_number++;
+    std::istringstream iss(StripComment(line));
+    std::string rom_path, script_path;
+    unsigned frames;
+    if (!(iss >> rom_path)) {
+      continue;  // 空行
+    }
+    if (!(iss >> frames)) {
+      Error("Invalid manifest: %s:%u", path.c_str(), line_number);
+    }
+    iss >> script_path;
+
+    ManifestJob job{static_cast<unsigned>(jobs_.size()), rom_path, frames,
+                    &GetRom(rom_path), nullptr};
+    if (!script_path.empty()) {
+      job.inputs = &GetScript(script_path);
+    }
+    jobs_.push_back(job);
+  }
+}
+
+const std::vector<std::uint8_t>& Manifest::GetRom(const std::string& path) {
+  if (path.rfind(kBuiltinPrefix, 0) == 0) {
+    auto rom = roms_.find(path);
+    if (rom != roms_.end()) {
+      return rom->second;
+    }
+    std::string name = path.substr(sizeof(kBuiltinPrefix) - 1);
+    for (BenchRom& bench_rom : BuildBenchRoms()) {
+      if (bench_rom.name == name) {
+        return roms_.emplace(path, std::move(bench_rom.rom)).first->second;
+      }
+    }
+    Error("Unknown builtin ROM: %s", name.c_str());
+  }
+
+  std::filesystem::path fs_path(path);
+  std::string file =
+      (fs_path.is_absolute() ? fs_path : base_dir_ / fs_path).string();
+  auto rom = roms_.find(file);
+  if (rom == roms_.end()) {
+    rom = roms_.emplace(file, LoadBinary(file)).first;
+  }
+  return rom->second;
+}
+
+const InputScript& Manifest::GetScript(const std::string& path) {
+  std::filesystem::path fs_path(path);
+  std::string file =
+      (fs_path.is_absolute() ? fs_path : base_dir_ / fs_path).string();
+  auto script = scripts_.find(file);
+  if (script == scripts_.end()) {
+    script = scripts_.emplace(file, LoadInputScript(file)).first;
+  }
+  return script->second;
+}
+
+}  // namespace gbemu
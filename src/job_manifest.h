@@ -0,0 +1,54 @@
+#ifndef GBEMU_JOB_MANIFEST_H_
+#define GBEMU_JOB_MANIFEST_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "key_input.h"
+
+namespace gbemu {
+
+// マニフェストの1行が表すジョブ。
+struct ManifestJob {
+  // マニフェストの中での通し番号
+  unsigned id;
+  // マニフェストに書かれたROMのパス
+  std::string rom_path;
+  unsigned frames;
+  // ROMとスクリプトはジョブ間で共有し、読み出し専用で使う
+  const std::vector<std::uint8_t>* rom;
+  const InputScript* inputs;  // スクリプトがなければnullptr
+};
+
+// ROMとキー入力スクリプトの組（ジョブ）を並べたマニフェスト。
+// 1行に1つのジョブを次の形式で書く（#以降はコメント）。
+//   <rom_file> <frames> [<input_script>]
+// 相対パスはマニフェストのあるディレクトリを基準とする。
+// ROMのパスを builtin:<name> とすると、BuildBenchRomsが生成するROMを使う。
+// 同じファイルを指すROMとスクリプトは一度だけ読み込んで共有する。
+class Manifest {
+ public:
+  // マニフェストを読み込む。読み込みに失敗したらプログラムを終了する。
+  explicit Manifest(const std::string& path);
+  Manifest(const Manifest&) = delete;
+  Manifest& operator=(const Manifest&) = delete;
+
+  const std::vector<ManifestJob>& jobs() const { return jobs_; }
+
+ private:
+  const std::vector<std::uint8_t>& GetRom(const std::string& path);
+  const InputScript& GetScript(const std::string& path);
+
+  std::filesystem::path base_dir_;
+  // キーは解決したパス（組み込みのROMは builtin:<name> のまま）
+  std::map<std::string, std::vector<std::uint8_t>> roms_;
+  std::map<std::string, InputScript> scripts_;
+  std::vector<ManifestJob> jobs_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_JOB_MANIFEST_H_
@@ -1,6 +1,10 @@
 #include "joypad.h"
 
+#include <utility>
+
 #include "interrupt.h"
+#include "save_state.h"
+#include "utils.h"
 
 using namespace gbemu;
 
@@ -115,6 +119,10 @@ void Joypad::ResetKeyBit(Key key) {
 }
 
 bool& gbemu::Joypad::GetKeyPressedFlag(Key key) {
+  return const_cast<bool&>(std::as_const(*this).GetKeyPressedFlag(key));
+}
+
+const bool& gbemu::Joypad::GetKeyPressedFlag(Key key) const {
   switch (key) {
     case Key::kA:
       return is_a_key_pressed_;
@@ -133,4 +141,31 @@ bool& gbemu::Joypad::GetKeyPressedFlag(Key key) {
     case Key::kDown:
       return is_down_key_pressed_;
   }
+  UNREACHABLE("Invalid key: %d", static_cast<int>(key));
+}
+
+bool Joypad::IsKeyPressed(Key key) const { return GetKeyPressedFlag(key); }
+
+void Joypad::SaveState(StateWriter& writer) const {
+  writer.Write(is_a_key_pressed_);
+  writer.Write(is_b_key_pressed_);
+  writer.Write(is_select_key_pressed_);
+  writer.Write(is_start_key_pressed_);
+  writer.Write(is_right_key_pressed_);
+  writer.Write(is_left_key_pressed_);
+  writer.Write(is_up_key_pressed_);
+  writer.Write(is_down_key_pressed_);
+  writer.Write(p1_);
+}
+
+void Joypad::LoadState(StateReader& reader) {
+  is_a_key_pressed_ = reader.Read<bool>();
+  is_b_key_pressed_ = reader.Read<bool>();
+  is_select_key_pressed_ = reader.Read<bool>();
+  is_start_key_pressed_ = reader.Read<bool>();
+  is_right_key_pressed_ = reader.Read<bool>();
+  is_left_key_pressed_ = reader.Read<bool>();
+  is_up_key_pressed_ = reader.Read<bool>();
+  is_down_key_pressed_ = reader.Read<bool>();
+  p1_ = reader.Read<std::uint8_t>();
 }
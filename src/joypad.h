@@ -4,6 +4,7 @@
 #include <cstdint>
 
 #include "interrupt.h"
+#include "save_state.h"
 
 namespace gbemu {
 
@@ -27,6 +28,14 @@ class Joypad {
   // キーを離す。すでに離していたら何も起こらない。
   void ReleaseKey(Key key);
 
+  // キーが押されているか調べる。
+  bool IsKeyPressed(Key key) const;
+
+  // 状態をセーブステートに書き出す。
+  void SaveState(StateWriter& writer) const;
+  // セーブステートから状態を復元する。
+  void LoadState(StateReader& reader);
+
  private:
   static constexpr unsigned kInputARightBitMask = 1 << 0;
   static constexpr unsigned kInputBLeftBitMask = 1 << 1;
@@ -65,6 +74,7 @@ class Joypad {
 
   // キーが押されているかどうかを記憶するメンバ変数を取得する
   bool& GetKeyPressedFlag(Key key);
+  const bool& GetKeyPressedFlag(Key key) const;
 
   bool is_a_key_pressed_{false};
   bool is_b_key_pressed_{false};
@@ -0,0 +1,96 @@
+#include "key_input.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "gameboy.h"
+#include "joypad.h"
+#include "utils.h"
+
+namespace gbemu {
+
+std::uint8_t GetPressedKeyMask(const GameBoy& gb) {
+  std::uint8_t mask = 0;
+  for (Joypad::Key key : kAllKeys) {
+    if (gb.IsKeyPressed(key)) {
+      mask |= GetKeyMask(key);
+    }
+  }
+  return mask;
+}
+
+void SetPressedKeyMask(GameBoy& gb, std::uint8_t mask) {
+  for (Joypad::Key key : kAllKeys) {
+    if (mask & GetKeyMask(key)) {
+      gb.PressKey(key);
+    } else {
+      gb.ReleaseKey(key);
+    }
+  }
+}
+
+bool ParseKeyName(const std::string& str, Joypad::Key& key) {
+  static const std::map<std::string, Joypad::Key> keys{
+      {"a", Joypad::Key::kA},         {"b", Joypad::Key::kB},
+      {"select", Joypad::Key::kSelect}, {"start", Joypad::Key::kStart},
+      {"right", Joypad::Key::kRight}, {"left", Joypad::Key::kLeft},
+      {"up", Joypad::Key::kUp},       {"down", Joypad::Key::kDown}};
+  auto i = keys.find(str);
+  if (i == keys.end()) {
+    return false;
+  }
+  key = i->second;
+  return true;
+}
+
+InputScript LoadInputScript(const std::string& path) {
+  std::ifstream ifs(path);
+  if (ifs.fail()) {
+    Error("File cannot open: %s", path.c_str());
+  }
+  InputScript script;
+  std::string line;
+  unsigned line_number = 0;
+  while (std::getline(ifs, line)) {
+    line_number++;
+    // コメントを除いて何も残らない行だけを読み飛ばす
+    std::string content = line.substr(0, line.find('#'));
+    if (content.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    std::istringstream iss(content);
+    std::string action, key_name, rest;
+    InputEvent event;
+    if (!(iss >> event.frame >> action >> key_name) || (iss >> rest) ||
+        (action != "press" && action != "release") ||
+        !ParseKeyName(key_name, event.key)) {
+      Error("Invalid input script: %s:%u", path.c_str(), line_number);
+    }
+    event.is_press = action == "press";
+    script.push_back(event);
+  }
+  std::stable_sort(script.begin(), script.end(),
+                   [](const InputEvent& lhs, const InputEvent& rhs) {
+                     return lhs.frame < rhs.frame;
+                   });
+  return script;
+}
+
+void ApplyInputEvents(const InputScript& script, unsigned frame,
+                      std::size_t& next_event, GameBoy& gb) {
+  while (next_event < script.size() && script[next_event].frame <= frame) {
+    const InputEvent& event = script[next_event++];
+    if (event.is_press) {
+      gb.PressKey(event.key);
+    } else {
+      gb.ReleaseKey(event.key);
+    }
+  }
+}
+
+}  // namespace gbemu
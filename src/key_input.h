@@ -0,0 +1,58 @@
+#ifndef GBEMU_KEY_INPUT_H_
+#define GBEMU_KEY_INPUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "gameboy.h"
+#include "joypad.h"
+
+namespace gbemu {
+
+// すべてのキー。
+constexpr Joypad::Key kAllKeys[] = {
+    Joypad::Key::kA,     Joypad::Key::kB,     Joypad::Key::kSelect,
+    Joypad::Key::kStart, Joypad::Key::kRight, Joypad::Key::kLeft,
+    Joypad::Key::kUp,    Joypad::Key::kDown};
+
+// キーに対応するビットマスクを得る。ビット位置はJoypad::Keyの値とする。
+inline std::uint8_t GetKeyMask(Joypad::Key key) {
+  return 1 << static_cast<unsigned>(key);
+}
+
+// 押しているキーのビットマスクを得る。
+std::uint8_t GetPressedKeyMask(const GameBoy& gb);
+
+// 押しているキーをビットマスクの通りにする。
+void SetPressedKeyMask(GameBoy& gb, std::uint8_t mask);
+
+// キー入力スクリプトの1つのイベント。
+// イベントは指定したフレームを進める直前に適用する。
+struct InputEvent {
+  unsigned frame;
+  bool is_press;
+  Joypad::Key key;
+};
+
+// フレームの昇順に並べたイベントの列。
+using InputScript = std::vector<InputEvent>;
+
+// キーの名前（a, b, select, start, right, left, up, down）をパースする。
+// 成功したらtrueを、失敗したらfalseを返す。
+bool ParseKeyName(const std::string& str, Joypad::Key& key);
+
+// キー入力スクリプトを読み込む。各行の形式は次の通り（#以降はコメント）。
+//   <frame> press|release <key>
+// 読み込みに失敗したらプログラムを終了する。
+InputScript LoadInputScript(const std::string& path);
+
+// frameを進める直前に適用すべきイベントをnext_event番目から順に適用する。
+// next_eventは次に適用するイベントの位置に更新する。
+void ApplyInputEvents(const InputScript& script, unsigned frame,
+                      std::size_t& next_event, GameBoy& gb);
+
+}  // namespace gbemu
+
+#endif  // GBEMU_KEY_INPUT_H_
@@ -0,0 +1,31 @@
+#ifndef GBEMU_LCD_H_
+#define GBEMU_LCD_H_
+
+#include <array>
+#include <cstdint>
+
+namespace gbemu {
+
+namespace lcd {
+
+// LCDの色（4階調）。まとめて書き込めるように1ピクセルを1バイトで表す。
+enum GbLcdColor : std::uint8_t {
+  kWhite = 0,
+  kLightGray = 1,
+  kDarkGray = 2,
+  kBlack = 3,
+  kColorNum,
+};
+
+constexpr auto kWidth = 160;
+constexpr auto kHeight = 144;
+constexpr auto kTotalPixelNum = kWidth * kHeight;
+
+}  // namespace lcd
+
+using GbLcdPixelRow = std::array<lcd::GbLcdColor, lcd::kWidth>;
+using GbLcdPixelMatrix = std::array<GbLcdPixelRow, lcd::kHeight>;
+
+}  // namespace gbemu
+
+#endif  // GBEMU_LCD_H_
@@ -0,0 +1,117 @@
+#include "line_composite.h"
+
+#include <cstdint>
+
+#ifdef GBEMU_LINE_COMPOSITE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "lcd.h"
+
+namespace gbemu {
+
+namespace {
+
+// Objectの属性のビット
+constexpr std::uint8_t kBehindBackgroundBit = 1 << 7;
+constexpr std::uint8_t kObp1Bit = 1 << 4;
+
+#ifdef GBEMU_LINE_COMPOSITE_SSE2
+// 16個のカラーIDをパレットで色に変換する。colorsはパレットの各色を並べたもの。
+__m128i LookupPalette(__m128i ids, const __m128i (&color_ids)[4],
+                      const __m128i (&colors)[4]) {
+  __m128i result = _mm_setzero_si128();
+  for (int i = 0; i < 4; i++) {
+    __m128i match = _mm_cmpeq_epi8(ids, color_ids[i]);
+    result = _mm_or_si128(result, _mm_and_si128(match, colors[i]));
+  }
+  return result;
+}
+
+// パレットの各カラーIDの色を16レーンに複製したものを作る
+void SpreadPalette(const PaletteLut& palette, __m128i (&colors)[4]) {
+  for (int i = 0; i < 4; i++) {
+    colors[i] = _mm_set1_epi8(palette[i]);
+  }
+}
+#endif
+
+}  // namespace
+
+void CompositeLineScalar(const LinePlanes& planes, const LinePalettes& palettes,
+                         GbLcdPixelRow& out) {
+  for (int i = 0; i < lcd::kWidth; i++) {
+    std::uint8_t color = lcd::kWhite;
+    bool has_background = planes.background_mask[i] != 0;
+    std::uint8_t background_id = planes.background_ids[i];
+    if (has_background) {
+      color = palettes.bgp[background_id];
+    }
+
+    std::uint8_t object_id = planes.object_ids[i];
+    if (object_id != 0) {
+      std::uint8_t attributes = planes.object_attributes[i];
+      bool is_behind = attributes & kBehindBackgroundBit;
+      if (!is_behind || !has_background || background_id == 0) {
+        const PaletteLut& obp =
+            (attributes & kObp1Bit) ? palettes.obp1 : palettes.obp0;
+        color = obp[object_id];
+      }
+    }
+    out[i] = static_cast<lcd::GbLcdColor>(color);
+  }
+}
+
+#ifdef GBEMU_LINE_COMPOSITE_SSE2
+void CompositeLineSse2(const LinePlanes& planes, const LinePalettes& palettes,
+                       GbLcdPixelRow& out) {
+  static_assert(lcd::kWidth % 16 == 0, "The width must be a multiple of 16.");
+  static_assert(sizeof(lcd::GbLcdColor) == 1, "A pixel must be one byte.");
+
+  const __m128i color_ids[4] = {_mm_set1_epi8(0), _mm_set1_epi8(1),
+                                _mm_set1_epi8(2), _mm_set1_epi8(3)};
+  __m128i bgp[4], obp0[4], obp1[4];
+  SpreadPalette(palettes.bgp, bgp);
+  SpreadPalette(palettes.obp0, obp0);
+  SpreadPalette(palettes.obp1, obp1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i behind_bit = _mm_set1_epi8(kBehindBackgroundBit);
+  const __m128i obp1_bit = _mm_set1_epi8(kObp1Bit);
+
+  auto load = [](const std::uint8_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  };
+  for (int x = 0; x < lcd::kWidth; x += 16) {
+    __m128i background_ids = load(&planes.background_ids[x]);
+    __m128i background_mask = load(&planes.background_mask[x]);
+    __m128i object_ids = load(&planes.object_ids[x]);
+    __m128i attributes = load(&planes.object_attributes[x]);
+
+    // BackgroundとWindowの色（ピクセルがなければ白＝0）
+    __m128i background_color = _mm_and_si128(
+        LookupPalette(background_ids, color_ids, bgp), background_mask);
+
+    // Objectの色。属性でOBP0とOBP1を選ぶ
+    __m128i use_obp1 =
+        _mm_cmpeq_epi8(_mm_and_si128(attributes, obp1_bit), obp1_bit);
+    __m128i object_color = _mm_or_si128(
+        _mm_andnot_si128(use_obp1, LookupPalette(object_ids, color_ids, obp0)),
+        _mm_and_si128(use_obp1, LookupPalette(object_ids, color_ids, obp1)));
+
+    // Objectを描かないピクセル：Objectがないか、BackgroundとWindowに隠れる
+    __m128i background_opaque =
+        _mm_andnot_si128(_mm_cmpeq_epi8(background_ids, zero), background_mask);
+    __m128i is_behind =
+        _mm_cmpeq_epi8(_mm_and_si128(attributes, behind_bit), behind_bit);
+    __m128i is_hidden =
+        _mm_or_si128(_mm_cmpeq_epi8(object_ids, zero),
+                     _mm_and_si128(is_behind, background_opaque));
+
+    __m128i color = _mm_or_si128(_mm_and_si128(is_hidden, background_color),
+                                 _mm_andnot_si128(is_hidden, object_color));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&out[x]), color);
+  }
+}
+#endif
+
+}  // namespace gbemu
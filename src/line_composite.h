@@ -0,0 +1,76 @@
+#ifndef GBEMU_LINE_COMPOSITE_H_
+#define GBEMU_LINE_COMPOSITE_H_
+
+#include <array>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#define GBEMU_LINE_COMPOSITE_SSE2
+#endif
+
+#include "lcd.h"
+
+namespace gbemu {
+
+// 1ライン分の各レイヤを、ピクセルごとに1バイトの平面に分けたもの。
+// レイヤの合成（CompositeLine）の入力になる。
+struct LinePlanes {
+  // BackgroundまたはWindowのカラーID（Windowが上書きする）
+  std::array<std::uint8_t, lcd::kWidth> background_ids;
+  // BackgroundまたはWindowのピクセルがあれば0xFF、なければ0x00
+  std::array<std::uint8_t, lcd::kWidth> background_mask;
+  // ObjectのカラーID。0はObjectのピクセルがない（透過）ことを表す
+  std::array<std::uint8_t, lcd::kWidth> object_ids;
+  // そのピクセルを描いたObjectの属性（OAMエントリの4バイト目）
+  std::array<std::uint8_t, lcd::kWidth> object_attributes;
+};
+
+// パレットで変換した後の、カラーID 0〜3それぞれの色。
+using PaletteLut = std::array<std::uint8_t, 4>;
+
+// パレットのレジスタの値を、カラーIDから色を引く表にする。
+// パレットのレジスタへの書き込みはまれなので、書き込まれたときに1度だけ変換し、
+// ピクセルごとにはシフトとマスクをせずに表を引く。
+constexpr PaletteLut DecodePalette(std::uint8_t palette) {
+  return {static_cast<std::uint8_t>(palette & 0b11),
+          static_cast<std::uint8_t>((palette >> 2) & 0b11),
+          static_cast<std::uint8_t>((palette >> 4) & 0b11),
+          static_cast<std::uint8_t>((palette >> 6) & 0b11)};
+}
+
+// 合成に使うパレット（DecodePaletteで変換したもの）。
+struct LinePalettes {
+  PaletteLut bgp;
+  PaletteLut obp0;
+  PaletteLut obp1;
+};
+
+// 各レイヤを合成してLCDの1行にする。
+// BackgroundとWindowのピクセルがなければ白、あればBGPで色に変換し、
+// その上にObjectのピクセルをOBP0またはOBP1で変換して重ねる。
+// ただし属性のビット7が立ったObjectは、BackgroundとWindowのカラーIDが0の
+// ピクセルにだけ描く。
+// 1ピクセルずつ分岐して処理する素朴な実装で、他の実装の正しさの基準にする。
+void CompositeLineScalar(const LinePlanes& planes, const LinePalettes& palettes,
+                         GbLcdPixelRow& out);
+
+#ifdef GBEMU_LINE_COMPOSITE_SSE2
+// CompositeLineScalarと同じ処理を、SSE2で16ピクセルずつ分岐なしで行う。
+// パレットの変換は4つのカラーIDとの比較と選択で行う。
+void CompositeLineSse2(const LinePlanes& planes, const LinePalettes& palettes,
+                       GbLcdPixelRow& out);
+#endif
+
+// PPUが使う合成の実装。SSE2を使えればSSE2を、そうでなければスカラー実装を使う。
+inline void CompositeLine(const LinePlanes& planes,
+                          const LinePalettes& palettes, GbLcdPixelRow& out) {
+#ifdef GBEMU_LINE_COMPOSITE_SSE2
+  CompositeLineSse2(planes, palettes, out);
+#else
+  CompositeLineScalar(planes, palettes, out);
+#endif
+}
+
+}  // namespace gbemu
+
+#endif  // GBEMU_LINE_COMPOSITE_H_
@@ -0,0 +1,261 @@
+#include "line_renderer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "lcd.h"
+#include "line_composite.h"
+#include "tile_decode.h"
+#include "utils.h"
+
+namespace gbemu {
+
+void LineRenderer::WriteVRam8(std::uint16_t offset, std::uint8_t value) {
+  vram_[offset] = value;
+  // タイルデータ領域への書き込みなら、そのタイルのキャッシュを無効にする
+  if (offset < kNumTiles * kTileBytes) {
+    is_tile_dirty_[offset / kTileBytes] = true;
+  }
+}
+
+void LineRenderer::WriteOam8(std::uint16_t offset, std::uint8_t value) {
+  // 行の集合に関わるのはY座標だけなので、それ以外のバイトへの書き込みは無視する
+  if (offset % 4 == 0 && oam_[offset] != value) {
+    dirty_objects_ |= std::uint64_t{1} << (offset / 4);
+  }
+  oam_[offset] = value;
+}
+
+void LineRenderer::LoadMemory(const std::uint8_t* vram,
+                              const std::uint8_t* oam) {
+  std::memcpy(vram_.data(), vram, kVRamSize);
+  std::memcpy(oam_.data(), oam, kOamSize);
+  is_tile_dirty_.fill(true);
+  bucketed_object_height_ = 0;
+}
+
+void LineRenderer::RenderLine(const LineRegisters& registers,
+                              GbLcdPixelRow& row) {
+  Lcdc lcdc{registers.lcdc};
+  LinePlanes planes{};
+  if (lcdc.IsBackgroundEnabled()) {
+    WriteBackgroundOnScanline(registers, planes);
+  }
+  if (registers.is_window_on_line) {
+    WriteWindowOnScanline(registers, planes);
+  }
+  if (lcdc.IsObjectEnabled()) {
+    WriteObjectsOnScanline(registers, planes);
+  }
+  CompositeLine(planes, registers.palettes, row);
+}
+
+LineRenderer::OamEntry LineRenderer::GetOamEntry(unsigned index) const {
+  OamEntry entry;
+  entry.y_pos = oam_[index * 4];
+  entry.x_pos = oam_[index * 4 + 1];
+  entry.tile_index = oam_[index * 4 + 2];
+  entry.attributes = oam_[index * 4 + 3];
+  return entry;
+}
+
+void LineRenderer::GetObjectLines(unsigned y_pos, unsigned height,
+                                  unsigned& begin, unsigned& end) {
+  // Y座標は画面の上端が16なので、y_pos - 16から高さの分の行に掛かる
+  int top = static_cast<int>(y_pos) - 16;
+  begin = std::clamp<int>(top, 0, lcd::kHeight);
+  end = std::clamp<int>(top + height, 0, lcd::kHeight);
+}
+
+void LineRenderer::UpdateObjectBuckets(unsigned height) {
+  if (bucketed_object_height_ != height) {
+    // オブジェクトの高さが変わったら、すべてのエントリを付け直す
+    object_buckets_.fill(0);
+    bucketed_object_y_.fill(0);
+    bucketed_object_height_ = height;
+    dirty_objects_ = (std::uint64_t{1} << kNumOamEntries) - 1;
+  }
+  while (dirty_objects_ != 0) {
+    unsigned index = __builtin_ctzll(dirty_objects_);
+    std::uint64_t bit = std::uint64_t{1} << index;
+    dirty_objects_ &= ~bit;
+
+    // 書き換わる前のY座標で掛かっていた行から外し、新しい行に付ける
+    unsigned begin, end;
+    GetObjectLines(bucketed_object_y_[index], height, begin, end);
+    for (unsigned line = begin; line < end; line++) {
+      object_buckets_[line] &= ~bit;
+    }
+    bucketed_object_y_[index] = oam_[index * 4];
+    GetObjectLines(bucketed_object_y_[index], height, begin, end);
+    for (unsigned line = begin; line < end; line++) {
+      object_buckets_[line] |= bit;
+    }
+  }
+}
+
+unsigned LineRenderer::GetTileFromTileMap(int tile_pos_x, int tile_pos_y,
+                                          TileMapArea area,
+                                          TileDataAddressingMode mode) const {
+  // タイルマップからデータを取得する
+  int tile_map_index = 32 * tile_pos_y + tile_pos_x;
+  std::uint16_t tile_map_base_address = area == TileMapArea::kLowerArea
+                                            ? kLowerTileMapBaseAddress
+                                            : kUpperTileMapBaseAddress;
+  std::uint8_t tile_map_data =
+      vram_[tile_map_base_address - kVRamStartAddress + tile_map_index];
+
+  // 指定したアドレッシングモードでタイルの番号を計算する
+  if (mode == TileDataAddressingMode::kLowerBlocksUnsigned) {
+    return tile_map_data;
+  }
+  constexpr int kUpperBlocksBaseTile =
+      (kUpperTileBlocksBaseAddress - kLowerTileBlocksBaseAddress) / kTileBytes;
+  int offset = tile_map_data < 128 ? tile_map_data : tile_map_data - 256;
+  return kUpperBlocksBaseTile + offset;
+}
+
+void LineRenderer::DecodeTile(unsigned tile) {
+  const std::uint8_t* data = &vram_[tile * kTileBytes];
+  for (int row = 0; row < kTileSize; row++) {
+    decoded_tiles_[tile * kTileSize + row] =
+        DecodeTileRow(data[2 * row], data[2 * row + 1]);
+  }
+  is_tile_dirty_[tile] = false;
+  tile_cache_stats_.decodes++;
+}
+
+std::size_t LineRenderer::GetTileCacheSize() {
+  return sizeof(decoded_tiles_) + sizeof(is_tile_dirty_);
+}
+
+void LineRenderer::WriteBackgroundOnScanline(const LineRegisters& registers,
+                                             LinePlanes& planes) {
+  Lcdc lcdc{registers.lcdc};
+  std::uint8_t scy = registers.scy;
+  std::uint8_t scx = registers.scx;
+
+  // スキャンラインと交差するタイルのうち左端のものを取得する
+  int tile_pos_y = ((scy + registers.ly) / kTileSize) % 32;
+  int tile_pos_x = scx / kTileSize;
+  int tile_row_offset = (scy + registers.ly) % kTileSize;
+  int tile_col_offset = scx % kTileSize;
+  TileMapArea area = lcdc.GetBackgroundTileMapArea();
+  TileDataAddressingMode mode = lcdc.GetTileDataAddressingMode();
+  unsigned tile = GetTileFromTileMap(tile_pos_x, tile_pos_y, area, mode);
+
+  // 左から右にタイルマップを移動しながら、スキャンラインと交差する
+  // 21個のタイルの行を作業領域に並べ、画面に入る160ピクセルを切り出す
+  std::array<std::uint8_t, kTileSize * 21> tile_rows;
+  for (int i = 0; i < 21; i++) {
+    StoreTileRow(GetTileRow(tile, tile_row_offset),
+                 &tile_rows[i * kTileSize]);
+    tile_pos_x = (tile_pos_x + 1) % 32;
+    tile = GetTileFromTileMap(tile_pos_x, tile_pos_y, area, mode);
+  }
+  std::memcpy(planes.background_ids.data(), &tile_rows[tile_col_offset],
+              lcd::kWidth);
+  planes.background_mask.fill(0xFF);
+}
+
+void LineRenderer::WriteWindowOnScanline(const LineRegisters& registers,
+                                         LinePlanes& planes) {
+  Lcdc lcdc{registers.lcdc};
+
+  // スキャンラインと交わる左端のタイルを取得する
+  int tile_map_pos_x = 0;
+  int tile_map_pos_y = registers.window_line / kTileSize;
+  TileMapArea area = lcdc.GetWindowTileMapArea();
+  TileDataAddressingMode mode = lcdc.GetTileDataAddressingMode();
+  unsigned tile =
+      GetTileFromTileMap(tile_map_pos_x, tile_map_pos_y, area, mode);
+  int tile_row_offset = registers.window_line % kTileSize;
+
+  // 左から右にタイルマップを移動しながら、スキャンラインと交差する
+  // タイルの行を作業領域に並べ、画面に入る部分を切り出す。
+  // WXが7未満のときは左端のタイルの一部が画面の外に出る。
+  int pixel_pos_x = registers.wx - 7;
+  int num_tiles = (lcd::kWidth - pixel_pos_x + kTileSize - 1) / kTileSize;
+  std::array<std::uint8_t, kTileSize * 21> tile_rows;
+  for (int i = 0; i < num_tiles; i++) {
+    StoreTileRow(GetTileRow(tile, tile_row_offset),
+                 &tile_rows[i * kTileSize]);
+    tile_map_pos_x++;
+    tile = GetTileFromTileMap(tile_map_pos_x, tile_map_pos_y, area, mode);
+  }
+  int begin = std::max(pixel_pos_x, 0);
+  std::memcpy(&planes.background_ids[begin], &tile_rows[begin - pixel_pos_x],
+              lcd::kWidth - begin);
+  std::memset(&planes.background_mask[begin], 0xFF, lcd::kWidth - begin);
+}
+
+void LineRenderer::WriteObjectsOnScanline(const LineRegisters& registers,
+                                          LinePlanes& planes) {
+  // DMGでは下記のソートを行うのが正しいエミュレーションだが、
+  // 行わない（＝OAMの並び順だけで描画の優先順位を決める）方が
+  // 綺麗に見える気がするのでコメントアウトしておく
+  // ------------------------------------------------
+  // X座標の小さいものを前面に描画するために、X座標の大きいものを先に描画する
+  // std::stable_sort(entries.begin(), entries.begin() + num_entries);
+
+  // OAM Scanの結果として、この行に掛かるエントリを番号の小さい順に最大10個選ぶ
+  UpdateObjectBuckets(Lcdc{registers.lcdc}.GetObjectHeight());
+  std::array<OamEntry, kMaxNumOfObjectsOnScanline> entries;
+  int num_entries = 0;
+  for (std::uint64_t objects = object_buckets_[registers.ly];
+       objects != 0 && num_entries < kMaxNumOfObjectsOnScanline;
+       objects &= objects - 1) {
+    entries[num_entries++] = GetOamEntry(__builtin_ctzll(objects));
+  }
+
+  // 番号の小さいものを前面に描画するために、番号の大きいものを先に描画する
+  for (int i = num_entries - 1; i >= 0; i--) {
+    WriteSingleObjectOnScanline(registers, entries[i], planes);
+  }
+}
+
+void LineRenderer::WriteSingleObjectOnScanline(const LineRegisters& registers,
+                                               const OamEntry& entry,
+                                               LinePlanes& planes) {
+  Lcdc lcdc{registers.lcdc};
+
+  // 描画すべきタイルの行データを取得
+  int lcd_x = entry.x_pos - 8;
+  int lcd_y = entry.y_pos - 16;
+  int lcd_y_offset = registers.ly - lcd_y;
+  int tile_row_offset = entry.IsYFlip()
+                            ? (lcdc.GetObjectHeight() - 1 - lcd_y_offset)
+                            : lcd_y_offset;
+  int upper_tile_index = lcdc.GetObjectSize() == ObjectSize::kDouble
+                             ? entry.tile_index & 0xFE
+                             : entry.tile_index;
+  PackedTileRow packed_row = GetTileRow(upper_tile_index, tile_row_offset);
+  // x-flipしているなら右端から描画するように反転する
+  if (entry.IsXFlip()) {
+    packed_row = FlipTileRow(packed_row);
+  }
+  std::array<std::uint8_t, kTileSize> tile_row;
+  StoreTileRow(packed_row, tile_row.data());
+
+  // 描画
+  for (int i = 0; i < 8; i++) {
+    unsigned color_id = tile_row[i];
+
+    // カラーID0は透過
+    if (color_id == 0) {
+      continue;
+    }
+
+    // 座標がLCDの画面内に収まるピクセルだけを描画する
+    int pixel_x = lcd_x + i;
+    if (0 <= pixel_x && pixel_x < lcd::kWidth) {
+      planes.object_ids[pixel_x] = color_id;
+      planes.object_attributes[pixel_x] = entry.attributes;
+    }
+  }
+}
+
+}  // namespace gbemu
@@ -0,0 +1,237 @@
+#ifndef GBEMU_LINE_RENDERER_H_
+#define GBEMU_LINE_RENDERER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "lcd.h"
+#include "line_composite.h"
+#include "tile_decode.h"
+#include "utils.h"
+
+namespace gbemu {
+
+// 1行の描画に使うレジスタの値。Drawing Pixelsに入った時点の値を写し取る。
+struct LineRegisters {
+  std::uint8_t lcdc;
+  std::uint8_t scy;
+  std::uint8_t scx;
+  std::uint8_t wy;
+  std::uint8_t wx;
+  // BGP、OBP0、OBP1をカラーIDから色を引く表にしたもの
+  LinePalettes palettes;
+  std::uint8_t ly;
+  // Windowの行カウンタ
+  std::uint8_t window_line;
+  // この行にWindowを描画するかどうか（LCDCの有効ビットも含めた判定）
+  bool is_window_on_line;
+};
+
+// PPUのピクセルの生成を受け持つクラス。
+// VRAMとOAMの写しを持ち、LineRegistersに従って1行ずつ描画する。
+// タイミングやレジスタの状態はPpuが持ち、このクラスは描画に要るものだけを
+// 持つので、書き込みと描画の順番さえ保てば別のスレッドで遅れて動かしても
+// 同じ画面になる（RenderThreadを参照）。
+class LineRenderer {
+ public:
+  // デコード済みのタイルのキャッシュの統計。
+  struct TileCacheStats {
+    // タイルの行を引いた回数
+    std::uint64_t lookups;
+    // キャッシュが無効だったためにタイルをデコードし直した回数
+    std::uint64_t decodes;
+  };
+
+  LineRenderer() { is_tile_dirty_.fill(true); }
+
+  // VRAMの写しに書き込む。offsetは$8000からのオフセット。
+  void WriteVRam8(std::uint16_t offset, std::uint8_t value);
+  // OAMの写しに書き込む。offsetは$FE00からのオフセット。
+  void WriteOam8(std::uint16_t offset, std::uint8_t value);
+  // VRAMとOAMの写しを丸ごと置き換え、キャッシュをすべて作り直す。
+  // セーブステートからの復元に使う。
+  void LoadMemory(const std::uint8_t* vram, const std::uint8_t* oam);
+
+  // 1行を描画してrowに書き込む。
+  void RenderLine(const LineRegisters& registers, GbLcdPixelRow& row);
+
+  // タイルのキャッシュの統計を取得する。
+  const TileCacheStats& tile_cache_stats() const { return tile_cache_stats_; }
+  // タイルのキャッシュが使うメモリのバイト数を得る。
+  static std::size_t GetTileCacheSize();
+
+  static constexpr auto kVRamSize = 8 * 1024;
+  static constexpr auto kOamSize = 160;
+
+ private:
+  // タイルの1辺のピクセル数。
+  static constexpr auto kTileSize = 8;
+
+  // VRAMのタイルデータ領域（$8000〜$97FF）にあるタイルの数と、1タイルのバイト数。
+  static constexpr auto kNumTiles = 384;
+  static constexpr auto kTileBytes = 16;
+
+  // タイルマップのベースアドレス。
+  static constexpr auto kLowerTileMapBaseAddress = 0x9800;
+  static constexpr auto kUpperTileMapBaseAddress = 0x9C00;
+
+  // タイルデータ格納領域のベースアドレス。
+  static constexpr auto kLowerTileBlocksBaseAddress = 0x8000;
+  static constexpr auto kUpperTileBlocksBaseAddress = 0x9000;
+
+  // スキャンライン上に同時に描画可能なオブジェクトの最大数
+  static constexpr auto kMaxNumOfObjectsOnScanline = 10;
+
+  // OAMのエントリの数。
+  static constexpr auto kNumOamEntries = kOamSize / 4;
+
+  // タイルマップの区画の種別。
+  enum class TileMapArea {
+    kLowerArea,  // $9800-9BFF
+    kUpperArea   // $9C00-9FFF
+  };
+
+  // タイルデータ参照時のアドレッシングモードの種別。
+  enum class TileDataAddressingMode {
+    kUpperBlocksSigned,   // $9000 + signed 8-bit offset
+    kLowerBlocksUnsigned  // $8000 + unsigned 8-bit offset
+  };
+
+  // オブジェクトのサイズの種別。
+  enum class ObjectSize {
+    kSingle,  // 8x8
+    kDouble   // 8x16
+  };
+
+  // LCDCレジスタのうち描画に関わる部分
+  struct Lcdc {
+    std::uint8_t data{};
+
+    // Windowに使用されるタイルマップの区画の種別を取得する。
+    TileMapArea GetWindowTileMapArea() const {
+      return data & (1 << 6) ? TileMapArea::kUpperArea
+                             : TileMapArea::kLowerArea;
+    }
+
+    // Backgroundに使用されるタイルマップの区画の種別を取得する。
+    TileMapArea GetBackgroundTileMapArea() const {
+      return data & (1 << 3) ? TileMapArea::kUpperArea
+                             : TileMapArea::kLowerArea;
+    }
+
+    // Backgroundレイヤーが描画されるか調べる。
+    bool IsBackgroundEnabled() const { return data & 1; }
+
+    // タイルマップからタイルデータを参照する際のアドレッシングモードの種別を取得する。
+    TileDataAddressingMode GetTileDataAddressingMode() const {
+      return (data & (1 << 4)) ? TileDataAddressingMode::kLowerBlocksUnsigned
+                               : TileDataAddressingMode::kUpperBlocksSigned;
+    }
+
+    // オブジェクトのサイズ種別を取得する。
+    ObjectSize GetObjectSize() const {
+      return (data & (1 << 2)) ? ObjectSize::kDouble : ObjectSize::kSingle;
+    }
+
+    // オブジェクトの高さを取得する。
+    unsigned GetObjectHeight() const {
+      return GetObjectSize() == ObjectSize::kDouble ? 2 * kTileSize : kTileSize;
+    }
+
+    // Objectレイヤーが描画されるかどうか調べる。
+    bool IsObjectEnabled() const { return data & (1 << 1); }
+  };
+
+  // OAMのエントリ
+  struct OamEntry {
+    std::uint8_t y_pos;
+    std::uint8_t x_pos;
+    std::uint8_t tile_index;
+    std::uint8_t attributes;
+
+    // オブジェクト同士の大小比較。X座標の小さい方が小さいとする。
+    // オブジェクト同士の描画の優先順位を決定するために定義する。
+    bool operator<(const OamEntry& rhs) const { return x_pos < rhs.x_pos; }
+
+    bool IsYFlip() const { return attributes & (1 << 6); }
+    bool IsXFlip() const { return attributes & (1 << 5); }
+  };
+
+  // OAMの指定の番号のエントリを取得する。
+  OamEntry GetOamEntry(unsigned index) const;
+
+  // 行ごとのオブジェクトの集合を、更新対象のエントリの分だけ作り直す。
+  // オブジェクトの高さが変わっていたらすべて作り直す。
+  void UpdateObjectBuckets(unsigned height);
+
+  // エントリのY座標と高さから、そのオブジェクトが掛かる行の範囲[begin, end)を求める。
+  static void GetObjectLines(unsigned y_pos, unsigned height, unsigned& begin,
+                             unsigned& end);
+
+  // タイルマップの指定の位置のタイルの番号（タイルデータ領域の先頭から数えて0〜383）を返す
+  unsigned GetTileFromTileMap(int tile_pos_x, int tile_pos_y, TileMapArea area,
+                              TileDataAddressingMode mode) const;
+
+  // タイルの任意の行をデコードした8ピクセル分のカラーIDを、キャッシュから得る。
+  // 行は0〜15で指定できる。8以上を指定すると次の番号のタイルの行になる。
+  // これは高さ16のオブジェクトのタイルに対応するため。
+  // 戻り値のメモリ上の0バイト目がタイルの左端のカラーIDに対応する。
+  PackedTileRow GetTileRow(unsigned tile, unsigned row) {
+    ASSERT(row < 16, "Unexpected argument.");
+    tile += row / kTileSize;
+    tile_cache_stats_.lookups++;
+    if (is_tile_dirty_[tile]) {
+      DecodeTile(tile);
+    }
+    return decoded_tiles_[tile * kTileSize + row % kTileSize];
+  }
+
+  // タイルの全行をデコードしてキャッシュに入れる。
+  void DecodeTile(unsigned tile);
+
+  // スキャンラインに沿ってBackgroundレイヤの各ピクセルのカラーIDを平面に書き出す。
+  void WriteBackgroundOnScanline(const LineRegisters& registers,
+                                 LinePlanes& planes);
+
+  // スキャンラインに沿ってWindowレイヤの各ピクセルのカラーIDを平面に書き出す。
+  // Backgroundのピクセルは上書きする。
+  void WriteWindowOnScanline(const LineRegisters& registers,
+                             LinePlanes& planes);
+
+  // スキャンラインに沿ってObjectレイヤの各ピクセルのカラーIDとそのピクセルが属する
+  // オブジェクトの属性を平面に書き出す。
+  // オブジェクトのない部分に対応する要素は変化させない。
+  void WriteObjectsOnScanline(const LineRegisters& registers,
+                              LinePlanes& planes);
+
+  // WriteObjectsOnScanlineのヘルパ。
+  // 1つのOAMエントリに対応するピクセルの情報を平面に書き出す。
+  void WriteSingleObjectOnScanline(const LineRegisters& registers,
+                                   const OamEntry& entry, LinePlanes& planes);
+
+  std::array<std::uint8_t, kVRamSize> vram_{};
+  std::array<std::uint8_t, kOamSize> oam_{};
+
+  // デコード済みのタイルのキャッシュ。タイルごとに8行分のカラーIDを持つ。
+  // VRAMのタイルデータ領域への書き込みでそのタイルを無効にし、次に使うときにデコードし直す。
+  std::array<PackedTileRow, kNumTiles * kTileSize> decoded_tiles_{};
+  std::array<bool, kNumTiles> is_tile_dirty_;
+  TileCacheStats tile_cache_stats_{};
+
+  // 行ごとのオブジェクトの集合。その行に掛かるOAMエントリの番号をビットで持つ。
+  // OAM Scanで選ばれるのは番号の小さい方から最大10個なので、
+  // 描画時に下位のビットから取り出せば毎行40エントリを調べなくて済む。
+  // Y座標が書き換わったエントリだけを書き換わる前後の行で付け替える。
+  std::array<std::uint64_t, lcd::kHeight> object_buckets_{};
+  // Y座標が書き換わり、object_buckets_に反映していないエントリの集合
+  std::uint64_t dirty_objects_{};
+  // object_buckets_に反映した各エントリのY座標
+  std::array<std::uint8_t, kNumOamEntries> bucketed_object_y_{};
+  // object_buckets_を作ったときのオブジェクトの高さ。0なら全体を作り直す。
+  unsigned bucketed_object_height_{0};
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_LINE_RENDERER_H_
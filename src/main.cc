@@ -1,75 +1,45 @@
 #include <SDL.h>
 
-#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <iterator>
 #include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "audio.h"
+#include "audio_sink.h"
+#include "av_recorder.h"
 #include "command_line.h"
+#include "dmg_palette.h"
+#include "frame_pacer.h"
+#include "frame_record.h"
+#include "frame_sink.h"
 #include "gameboy.h"
+#include "guest_profiler.h"
+#include "movie.h"
 #include "renderer.h"
+#include "rewind_buffer.h"
+#include "run_ahead.h"
+#include "runtime_stats.h"
+#include "shm_frame_ring.h"
 #include "utils.h"
 
 using namespace gbemu;
 
 namespace {
 
-// 指定したパスのファイルをバイナリファイルとして読み出す。
-// 読み出しに失敗したらプログラムを終了する。
-std::vector<std::uint8_t> LoadBinary(const std::string& path) {
-  // ROMファイルをオープン
-  std::ifstream ifs(path, std::ios_base::in | std::ios_base::binary);
-  if (ifs.fail()) {
-    Error("File cannot open: %s", path.c_str());
-  }
-
-  // ROMファイルを読み出す
-  std::istreambuf_iterator<char> it_ifs_begin(ifs);
-  std::istreambuf_iterator<char> it_ifs_end{};
-  std::vector<std::uint8_t> rom(it_ifs_begin, it_ifs_end);
-  if (ifs.fail()) {
-    Error("File cannot read: %s", path.c_str());
-  }
-
-  // ROMファイルをクローズ
-  ifs.close();
-  if (ifs.fail()) {
-    Error("File cannot close: %s", path.c_str());
-  }
-
-  return rom;
-}
-
-void OutputBinary(const std::string& path,
-                  const std::vector<std::uint8_t>& data) {
-  std::ofstream ofs(path, std::ios_base::out | std::ios_base::binary);
-  if (ofs.fail()) {
-    Error("File cannot open: %s", path.c_str());
-  }
-  std::ostreambuf_iterator<char> it_ofs(ofs);
-  std::copy(std::cbegin(data), std::cend(data), it_ofs);
-  if (ofs.fail()) {
-    Error("File cannot read: %s", path.c_str());
-  }
-  ofs.close();
-  if (ofs.fail()) {
-    Error("File cannot close: %s", path.c_str());
-  }
-}
-
 // イベントを処理する。具体的には
 // - キー入力をエミュレータに渡す。
+// - 巻き戻しキー（R）が押されているかどうかをis_rewindingに記録する。
 // - エミュレータのウインドウの閉じるボタンの押下を検出したら
 //   処理を中断してtrueを返す。
-bool PollEvent(GameBoy& gb) {
+bool PollEvent(GameBoy& gb, bool& is_rewinding) {
   static std::map<SDL_Keycode, Joypad::Key> keymap{
       {SDLK_w, Joypad::Key::kUp},
       {SDLK_a, Joypad::Key::kLeft},
@@ -86,6 +56,10 @@ bool PollEvent(GameBoy& gb) {
     }
     if (e.type == SDL_KEYDOWN) {
       auto sym = e.key.keysym.sym;
+      if (sym == SDLK_r) {
+        is_rewinding = true;
+        continue;
+      }
       auto i = keymap.find(sym);
       if (i != keymap.end()) {
         gb.PressKey(i->second);
@@ -94,6 +68,10 @@ bool PollEvent(GameBoy& gb) {
     }
     if (e.type == SDL_KEYUP) {
       auto sym = e.key.keysym.sym;
+      if (sym == SDLK_r) {
+        is_rewinding = false;
+        continue;
+      }
       auto i = keymap.find(sym);
       if (i != keymap.end()) {
         gb.ReleaseKey(i->second);
@@ -104,22 +82,39 @@ bool PollEvent(GameBoy& gb) {
   return false;
 }
 
-void WaitForNextFrame() {
-  static int frame_count = 0;
-  constexpr int kFramesInSec = 60;
-  static Uint64 current_sec_start = SDL_GetTicks64();
-  if (frame_count == kFramesInSec) {
-    frame_count = 0;
-    current_sec_start = SDL_GetTicks64();
+// 1フレーム進めて巻き戻し用とムービーに記録し、表示する画面を返す。
+// 先読みが有効なら先読みした画面を返す。
+// 巻き戻し中なら代わりに1つ前のスナップショットの状態に戻す。
+// vblank_nsには本来のフレームを完成させた時刻（先読みの前）を格納する。
+const GbLcdPixelMatrix& RunFrame(GameBoy& gb, RunAhead* run_ahead,
+                                 RewindBuffer* rewind, bool is_rewinding,
+                                 MovieRecorder* recorder,
+                                 std::uint64_t& vblank_ns) {
+  if (rewind != nullptr && is_rewinding) {
+    rewind->Rewind(gb);
+    vblank_ns = GetMonotonicNs();
+    return gb.GetPpuBuffer();
   }
-
-  frame_count++;
-  Uint64 next_frame_start =
-      current_sec_start + 1000 * frame_count / kFramesInSec;
-  Uint64 now = SDL_GetTicks64();
-  if (now < next_frame_start) {
-    SDL_Delay(next_frame_start - now);
+  if (recorder != nullptr) {
+    recorder->BeginFrame(gb);
   }
+  const GbLcdPixelMatrix* frame;
+  if (run_ahead != nullptr) {
+    frame = &run_ahead->Step();
+    vblank_ns = run_ahead->frame_end_ns();
+  } else {
+    gb.Step();
+    vblank_ns = GetMonotonicNs();
+    frame = &gb.GetPpuBuffer();
+  }
+  if (recorder != nullptr) {
+    // 先読みしても状態は戻っているので、記録するのは本来のフレームの画面になる
+    recorder->EndFrame(gb);
+  }
+  if (rewind != nullptr) {
+    rewind->Push(gb);
+  }
+  return *frame;
 }
 
 }  // namespace
@@ -128,7 +123,39 @@ void WaitForNextFrame() {
 
 int main(int argc, char* argv[]) {
   if (!options.Parse(argc, argv)) {
-    Error("Usage: gbemu [--debug] [--bootrom <bootrom_file>] --rom <rom_file>");
+    Error(
+        "Usage: gbemu [--debug] [--bootrom <bootrom_file>] "
+        "[--rewind <budget_mib>] [--run-ahead <frames>] "
+        "[--run-ahead-instance] [--record-movie <movie_file>] "
+        "[--stats] [--stats-trace <trace_file>] "
+        "[--guest-profile <folded_file>] [--render-thread] "
+        "[--palette <name|rrggbb,rrggbb,rrggbb,rrggbb>] "
+        "[--shm-export <name>] [--record <file|->] "
+        "[--record-format y4m|rgb] [--record-audio <wav_file>] "
+        "[--record-frames <file>] [--pacing auto|audio|vsync|free] "
+        "--rom <rom_file>");
+  }
+
+  // 画面の4階調の色
+  DmgPalette palette = kDefaultDmgPalette;
+  if (!options.palette().empty() &&
+      !ParseDmgPalette(options.palette(), palette)) {
+    Error("Invalid palette: %s", options.palette().c_str());
+  }
+
+  // 画面と音の記録。標準出力に書き出すときに他の出力と混ざらないよう、
+  // 何かを表示するより前に開く
+  std::unique_ptr<AvRecorder> av_recorder;
+  if (!options.record_file_name().empty() ||
+      !options.record_audio_file_name().empty()) {
+    AvRecorder::Config record_config;
+    record_config.video_path = options.record_file_name();
+    record_config.video_format = options.record_format() == "rgb"
+                                     ? AvRecorder::VideoFormat::kRawRgb
+                                     : AvRecorder::VideoFormat::kY4m;
+    record_config.audio_path = options.record_audio_file_name();
+    record_config.palette = palette;
+    av_recorder = std::make_unique<AvRecorder>(record_config);
   }
 
 #ifdef ENABLE_LCD
@@ -158,29 +185,164 @@ int main(int argc, char* argv[]) {
   }
 
   Cartridge cartridge(rom, &save);
+  cartridge.header().Print();
   Audio audio;
-  GameBoy gb(&cartridge, audio, boot_rom.size() != 0 ? &boot_rom : nullptr);
+
+  // 音を記録するときは、鳴らす音と同じサンプルを記録にも渡す
+  std::unique_ptr<TeeAudioSink> recorded_audio;
+  AudioSink* output_audio = &audio;
+  if (av_recorder != nullptr) {
+    recorded_audio = std::make_unique<TeeAudioSink>(audio, *av_recorder);
+    output_audio = recorded_audio.get();
+  }
+
+  // 処理時間の統計。音声の出力はTimedAudioSinkを挟んで計測する
+  std::ofstream trace_stream;
+  std::unique_ptr<RuntimeStats> stats;
+  std::unique_ptr<TimedAudioSink> timed_audio;
+  if (options.stats()) {
+#ifndef GBEMU_ENABLE_STATS
+    Error("--stats is not available: built without GBEMU_ENABLE_STATS.");
+#endif
+    if (!options.stats_trace_file_name().empty()) {
+      trace_stream.open(options.stats_trace_file_name());
+      if (trace_stream.fail()) {
+        Error("File cannot open: %s", options.stats_trace_file_name().c_str());
+      }
+    }
+    stats = std::make_unique<RuntimeStats>(
+        std::cerr, trace_stream.is_open() ? &trace_stream : nullptr);
+    timed_audio = std::make_unique<TimedAudioSink>(*output_audio, *stats);
+  }
+  AudioSink& audio_sink = timed_audio != nullptr
+                              ? static_cast<AudioSink&>(*timed_audio)
+                              : *output_audio;
+
+  GameBoy gb(&cartridge, audio_sink,
+             boot_rom.size() != 0 ? &boot_rom : nullptr);
+  if (stats != nullptr) {
+    gb.set_profile(stats->profile());
+  }
+  gb.set_render_thread_enabled(options.render_thread());
+
+  // ゲストのコードのプロファイル。終了時に折りたたみ形式で書き出す
+  std::unique_ptr<GuestProfiler> guest_profiler;
+  if (!options.guest_profile_file_name().empty()) {
+    guest_profiler = std::make_unique<GuestProfiler>(cartridge,
+                                                     GuestProfiler::Config{});
+    gb.set_cpu_observer(guest_profiler.get());
+  }
+
+  // ムービーの記録。ムービーはブートROMなしで再生するので、ブートROMとは併用できない
+  std::ofstream movie_stream;
+  std::unique_ptr<MovieRecorder> recorder;
+  if (!options.movie_file_name().empty()) {
+    if (options.has_boot_rom()) {
+      Error("--record-movie cannot be used with --bootrom.");
+    }
+    movie_stream.open(options.movie_file_name(), std::ios::binary);
+    if (movie_stream.fail()) {
+      Error("File cannot open: %s", options.movie_file_name().c_str());
+    }
+    // ムービーにはカートリッジのRAMを記録しないので、セーブファイルを
+    // 読み込んでいれば電源投入時の状態（RAMを含む）から記録する
+    std::vector<std::uint8_t> start_state;
+    if (!save.empty()) {
+      start_state = gb.SaveState();
+    }
+    recorder = std::make_unique<MovieRecorder>(movie_stream, rom, start_state);
+  }
+
+  // 巻き戻し用の記録。巻き戻すと入力の記録が途切れるので、ムービーの記録中は無効にする
+  std::unique_ptr<RewindBuffer> rewind;
+  if (options.rewind_budget_mib() != 0 && recorder == nullptr) {
+    RewindBuffer::Config rewind_config;
+    rewind_config.memory_budget =
+        static_cast<std::size_t>(options.rewind_budget_mib()) * 1024 * 1024;
+    rewind = std::make_unique<RewindBuffer>(rewind_config);
+  }
+  bool is_rewinding = false;
+
+  // 表示する画面を渡す先。共有メモリに書き込むと別のプロセスから読める
+  std::vector<FrameSink*> frame_sinks;
+  std::unique_ptr<ShmFrameWriter> shm_writer;
+  if (!options.shm_export_name().empty()) {
+    shm_writer = std::make_unique<ShmFrameWriter>(options.shm_export_name());
+    frame_sinks.push_back(shm_writer.get());
+  }
+  if (av_recorder != nullptr) {
+    frame_sinks.push_back(av_recorder.get());
+  }
+  std::ofstream frame_record_stream;
+  std::unique_ptr<FrameRecordWriter> frame_record;
+  if (!options.record_frames_file_name().empty()) {
+    frame_record_stream.open(options.record_frames_file_name(),
+                             std::ios::binary);
+    if (frame_record_stream.fail()) {
+      Error("File cannot open: %s", options.record_frames_file_name().c_str());
+    }
+    frame_record = std::make_unique<FrameRecordWriter>(frame_record_stream);
+    frame_sinks.push_back(frame_record.get());
+  }
+
+  // 先読み。別のインスタンスで先読みする場合は、RAMの内容を写したカートリッジを使う
+  std::vector<std::uint8_t> shadow_save;
+  std::unique_ptr<Cartridge> shadow_cartridge;
+  NullAudioSink shadow_audio;
+  std::unique_ptr<GameBoy> shadow_gb;
+  std::unique_ptr<RunAhead> run_ahead;
+  if (options.run_ahead_frames() != 0) {
+    if (options.run_ahead_instance()) {
+      shadow_save = save;
+      shadow_cartridge = std::make_unique<Cartridge>(rom, &shadow_save);
+      shadow_gb = std::make_unique<GameBoy>(
+          shadow_cartridge.get(), shadow_audio,
+          boot_rom.size() != 0 ? &boot_rom : nullptr);
+      if (stats != nullptr) {
+        shadow_gb->set_profile(stats->profile());
+      }
+    }
+    run_ahead = std::make_unique<RunAhead>(gb, options.run_ahead_frames(),
+                                           shadow_gb.get());
+  }
 #ifdef ENABLE_LCD
   {
-    Renderer renderer(2);
-    if (renderer.vsync()) {
-      // 垂直同期オン
-      std::cout << "vsync on" << std::endl;
-      while (!PollEvent(gb)) {
-        gb.Step();
-        auto& buffer = gb.GetPpuBuffer();
+    // フレームの間隔の決め方。垂直同期で待つのはkVsyncのときだけにする
+    PacingMode pacing_mode;
+    ParsePacingMode(options.pacing(), pacing_mode);
+    Renderer renderer(2, palette,
+                      pacing_mode == PacingMode::kAuto ||
+                          pacing_mode == PacingMode::kVsync);
+    if (pacing_mode == PacingMode::kAuto) {
+      pacing_mode = renderer.vsync() ? PacingMode::kVsync : PacingMode::kAudio;
+    } else if (pacing_mode == PacingMode::kVsync && !renderer.vsync()) {
+      WarnUser("VSync is not available on this display. Pacing by audio.");
+      pacing_mode = PacingMode::kAudio;
+    }
+    FramePacer pacer(pacing_mode, audio, renderer.refresh_rate());
+    std::cout << "pacing: " << GetPacingModeName(pacing_mode) << std::endl;
+
+    while (!PollEvent(gb, is_rewinding)) {
+      if (stats != nullptr) {
+        stats->BeginFrame();
+      }
+      std::uint64_t vblank_ns;
+      auto& buffer = RunFrame(gb, run_ahead.get(), rewind.get(), is_rewinding,
+                              recorder.get(), vblank_ns);
+      for (FrameSink* frame_sink : frame_sinks) {
+        frame_sink->PushFrame(buffer, vblank_ns);
+      }
+      {
+        // 垂直同期の待ち時間も含まれる
+        RuntimeStats::Scope scope(stats.get(), RuntimeStats::kRender);
         renderer.Render(buffer);
       }
-    } else {
-      // 垂直同期オフ
-      std::cout << "vsync off" << std::endl;
-      while (!PollEvent(gb)) {
-        gb.Step();
-        renderer.Render(gb.GetPpuBuffer());
-
-        // 次のフレーム開始時間まで待つ
-        WaitForNextFrame();
+      if (stats != nullptr) {
+        stats->EndFrame();
       }
+
+      // 次のフレームを進めてよくなるまで待つ
+      pacer.EndFrame();
     }
   }
 #else
@@ -190,6 +352,40 @@ int main(int argc, char* argv[]) {
   }
 #endif
 
+  std::printf("audio: %llu underruns, %llu overruns, rate adjust %+.3f%%\n",
+              static_cast<unsigned long long>(audio.num_underruns()),
+              static_cast<unsigned long long>(audio.num_overruns()),
+              audio.rate_adjust() * 100);
+
+  if (run_ahead != nullptr) {
+    std::printf(
+        "run-ahead: %u frames (%.1f ms latency saved), "
+        "overhead %.0f%% of %.2f ms/frame\n",
+        run_ahead->num_frames(), run_ahead->GetLatencySavedMs(),
+        run_ahead->GetOverhead() * 100, run_ahead->GetAverageFrameMs());
+  }
+
+  if (av_recorder != nullptr) {
+    av_recorder->Finish();
+    std::printf("record: %llu frames, %llu stalls\n",
+                static_cast<unsigned long long>(av_recorder->num_frames()),
+                static_cast<unsigned long long>(av_recorder->num_stalls()));
+  }
+  if (frame_record != nullptr) {
+    frame_record->Finish();
+    std::printf("record-frames: %llu frames, %llu bytes\n",
+                static_cast<unsigned long long>(frame_record->num_frames()),
+                static_cast<unsigned long long>(frame_record->num_bytes()));
+  }
+
+  if (guest_profiler != nullptr) {
+    std::ofstream ofs(options.guest_profile_file_name());
+    if (ofs.fail()) {
+      Error("File cannot open: %s", options.guest_profile_file_name().c_str());
+    }
+    guest_profiler->WriteFoldedStacks(ofs);
+  }
+
   OutputBinary(save_file_path, save);
 
   return 0;
@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "cartridge_header.h"
+#include "save_state.h"
 #include "utils.h"
 
 namespace gbemu {
@@ -31,31 +32,8 @@ class Mbc1 : public Mbc {
   ~Mbc1() override = default;
 
   std::uint8_t Read8(std::uint16_t address) const override {
-    if (InRange(address, 0, 0x4000)) {
-      std::uint32_t rom_address;
-      if (registers_.ram_banking_mode) {
-        rom_address = address;
-        rom_address |= registers_.ram_bank_number << 19;
-        rom_address %= rom_.size();
-      } else {
-        rom_address = address;
-      }
-      return rom_.at(rom_address);
-    }
-
-    if (InRange(address, 0x4000, 0x8000)) {
-      // ROM Bank Numberレジスタが0の場合は1として扱う
-      std::uint8_t rom_bank_number = registers_.rom_bank_number;
-      if (rom_bank_number == 0) {
-        rom_bank_number = 1;
-      }
-
-      std::uint32_t rom_address = 0;
-      rom_address |= registers_.ram_bank_number << 19;
-      rom_address |= rom_bank_number << 14;
-      rom_address |= address & 0x3FFF;
-      rom_address %= rom_.size();
-      return rom_.at(rom_address);
+    if (InRange(address, 0, 0x8000)) {
+      return rom_.at(GetRomAddress(address));
     }
 
     if (InRange(address, 0xA000, 0xC000)) {
@@ -118,14 +96,60 @@ class Mbc1 : public Mbc {
     UNREACHABLE("Unknown address: %d", static_cast<int>(address));
   }
 
+  void SaveState(StateWriter& writer) const override {
+    writer.Write(registers_.ram_enable);
+    writer.Write(registers_.rom_bank_number);
+    writer.Write(registers_.ram_bank_number);
+    writer.Write(registers_.ram_banking_mode);
+  }
+
+  void LoadState(StateReader& reader) override {
+    registers_.ram_enable = reader.Read<bool>();
+    registers_.rom_bank_number = reader.Read<std::uint8_t>();
+    registers_.ram_bank_number = reader.Read<std::uint8_t>();
+    registers_.ram_banking_mode = reader.Read<bool>();
+  }
+
+  unsigned GetRomBank(std::uint16_t address) const override {
+    return GetRomAddress(address) >> 14;
+  }
+
  private:
+  // $0000-$7FFFのアドレスに対応するROM上の位置を求める。
+  std::uint32_t GetRomAddress(std::uint16_t address) const {
+    if (InRange(address, 0, 0x4000)) {
+      std::uint32_t rom_address;
+      if (registers_.ram_banking_mode) {
+        rom_address = address;
+        rom_address |= registers_.ram_bank_number << 19;
+        rom_address %= rom_.size();
+      } else {
+        rom_address = address;
+      }
+      return rom_address;
+    }
+
+    // ROM Bank Numberレジスタが0の場合は1として扱う
+    std::uint8_t rom_bank_number = registers_.rom_bank_number;
+    if (rom_bank_number == 0) {
+      rom_bank_number = 1;
+    }
+
+    std::uint32_t rom_address = 0;
+    rom_address |= registers_.ram_bank_number << 19;
+    rom_address |= rom_bank_number << 14;
+    rom_address |= address & 0x3FFF;
+    rom_address %= rom_.size();
+    return rom_address;
+  }
+
   struct Registers {
     bool ram_enable;
     std::uint8_t rom_bank_number;
     std::uint8_t ram_bank_number;
     bool ram_banking_mode;
   };
-  Registers registers_;
+  Registers registers_{};
 };
 
 std::unique_ptr<Mbc> Mbc::Create(CartridgeType type,
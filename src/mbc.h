@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "cartridge_header.h"
+#include "save_state.h"
 #include "utils.h"
 
 namespace gbemu {
@@ -21,6 +22,16 @@ class Mbc {
   virtual std::uint8_t Read8(std::uint16_t address) const = 0;
   // CPUによる`address`への書き込み要求に対処する。
   virtual void Write8(std::uint16_t address, std::uint8_t value) = 0;
+  // MBCのレジスタの状態をセーブステートに書き出す。
+  // レジスタを持たないMBCは何もしない。RAMの内容はCartridgeが書き出す。
+  virtual void SaveState(StateWriter& /* writer */) const {}
+  // セーブステートからMBCのレジスタの状態を復元する。
+  virtual void LoadState(StateReader& /* reader */) {}
+  // $0000-$7FFFのアドレスに現在割り当てられているROMバンクの番号を返す。
+  // バンクを切り替えないMBCはアドレスをそのまま16KiBで割った値になる。
+  virtual unsigned GetRomBank(std::uint16_t address) const {
+    return address >> 14;
+  }
   // `type`が表すMBCの種類に対応するMbcの派生クラスのインスタンスを生成する。
   static std::unique_ptr<Mbc> Create(CartridgeType type,
                                      const std::vector<std::uint8_t>& rom,
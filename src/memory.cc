@@ -9,6 +9,7 @@
 #include "interrupt.h"
 #include "joypad.h"
 #include "ppu.h"
+#include "save_state.h"
 #include "serial.h"
 #include "timer.h"
 #include "utils.h"
@@ -391,4 +392,33 @@ void Memory::Dma::Run(unsigned mcycles) {
   }
 }
 
+void Memory::Dma::SaveState(StateWriter& writer) const {
+  writer.Write(state_);
+  writer.Write(dma_);
+  writer.Write(src_address_);
+  writer.Write(dst_address_);
+}
+
+void Memory::Dma::LoadState(StateReader& reader) {
+  state_ = reader.Read<State>();
+  dma_ = reader.Read<std::uint8_t>();
+  src_address_ = reader.Read<std::uint16_t>();
+  dst_address_ = reader.Read<std::uint16_t>();
+}
+
+void Memory::SaveState(StateWriter& writer) const {
+  writer.WriteBytes(internal_ram_.data(), internal_ram_.size());
+  writer.WriteBytes(h_ram_.data(), h_ram_.size());
+  writer.Write(is_boot_rom_mapped_);
+  dma_.SaveState(writer);
+}
+
+void Memory::LoadState(StateReader& reader) {
+  reader.ReadBytes(internal_ram_.data(), internal_ram_.size());
+  reader.ReadBytes(h_ram_.data(), h_ram_.size());
+  // ブートROMを与えられていない場合はマップできない
+  is_boot_rom_mapped_ = reader.Read<bool>() && boot_rom_ != nullptr;
+  dma_.LoadState(reader);
+}
+
 }  // namespace gbemu
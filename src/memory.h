@@ -10,6 +10,7 @@
 #include "interrupt.h"
 #include "joypad.h"
 #include "ppu.h"
+#include "save_state.h"
 #include "serial.h"
 #include "timer.h"
 #include "utils.h"
@@ -43,6 +44,11 @@ class Memory {
     // ただしRequestDmaを呼び出してから最初のRunでは何もしない。
     void Run(unsigned mcycles);
 
+    // 状態をセーブステートに書き出す。
+    void SaveState(StateWriter& writer) const;
+    // セーブステートから状態を復元する。
+    void LoadState(StateReader& reader);
+
    private:
     // DMA転送の状態。
     enum class State {
@@ -89,6 +95,12 @@ class Memory {
   // DMAを指定のマシンサイクルだけ進める
   void RunDma(unsigned mcycles) { dma_.Run(mcycles); }
 
+  // 状態をセーブステートに書き出す。
+  // 各コンポーネントの状態は含まず、メモリ自身が持つRAMとDMAの状態だけを書き出す。
+  void SaveState(StateWriter& writer) const;
+  // セーブステートから状態を復元する。
+  void LoadState(StateReader& reader);
+
  private:
   std::uint8_t ReadIORegister(std::uint16_t address) const;
   void WriteIORegister(std::uint16_t address, std::uint8_t value);
@@ -0,0 +1,216 @@
+#include "movie.h"
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "byte_io.h"
+#include "frame_hash.h"
+#include "gameboy.h"
+#include "key_input.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+constexpr char kMovieMagic[4] = {'G', 'B', 'M', 'V'};
+
+// ムービーの形式のバージョン。
+constexpr std::uint32_t kMovieVersion = 1;
+
+constexpr char kInputTag = 'I';
+constexpr char kHashTag = 'H';
+constexpr char kEndTag = 'E';
+
+// 開始時のセーブステートの大きさの上限。セーブステートはカートリッジのRAM
+// （最大128KiB）とWRAM、VRAMなどなので、これを超えるものは壊れている
+constexpr std::uint32_t kMaxStartStateSize = 1 << 20;
+
+// 現在位置から終端までのバイト数を返す。シークできなければUINT64_MAXを返す。
+std::uint64_t GetRemainingSize(std::istream& in) {
+  std::streampos position = in.tellg();
+  if (position < 0 || !in.seekg(0, std::ios::end)) {
+    in.clear();
+    return UINT64_MAX;
+  }
+  std::streampos end = in.tellg();
+  // 元の位置に戻せなければ、続きの読み込みが失敗する
+  if (!in.seekg(position) || end < position) {
+    return UINT64_MAX;
+  }
+  return static_cast<std::uint64_t>(end - position);
+}
+
+}  // namespace
+
+std::uint64_t HashRom(const std::vector<std::uint8_t>& rom) {
+  // FNV-1a
+  std::uint64_t hash = 0xCBF29CE484222325ULL;
+  for (std::uint8_t byte : rom) {
+    hash ^= byte;
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+MovieRecorder::MovieRecorder(std::ostream& out,
+                             const std::vector<std::uint8_t>& rom,
+                             const std::vector<std::uint8_t>& start_state,
+                             unsigned hash_interval)
+    : out_(out), hash_interval_(hash_interval) {
+  out_.write(kMovieMagic, sizeof(kMovieMagic));
+  WriteLittleEndian(out_, kMovieVersion);
+  WriteLittleEndian(out_, HashRom(rom));
+  WriteLittleEndian(out_, static_cast<std::uint32_t>(start_state.size()));
+  out_.write(reinterpret_cast<const char*>(start_state.data()),
+             start_state.size());
+  CheckWrite();
+}
+
+MovieRecorder::~MovieRecorder() { Finish(); }
+
+void MovieRecorder::BeginFrame(const GameBoy& gb) {
+  if (is_finished_) {
+    return;
+  }
+  std::uint8_t mask = GetPressedKeyMask(gb);
+  if (mask != last_key_mask_) {
+    WriteRecordHeader(kInputTag);
+    out_.put(static_cast<char>(mask));
+    last_key_mask_ = mask;
+  }
+}
+
+void MovieRecorder::EndFrame(const GameBoy& gb) {
+  if (is_finished_) {
+    return;
+  }
+  frame_++;
+  if (hash_interval_ != 0 && frame_ % hash_interval_ == 0) {
+    WriteRecordHeader(kHashTag);
+    WriteLittleEndian(out_, HashFrame(gb.GetPpuBuffer()));
+  }
+}
+
+void MovieRecorder::Finish() {
+  if (is_finished_) {
+    return;
+  }
+  WriteRecordHeader(kEndTag);
+  out_.flush();
+  CheckWrite();
+  is_finished_ = true;
+}
+
+void MovieRecorder::WriteRecordHeader(char tag) {
+  out_.put(tag);
+  WriteVarint(out_, frame_ - last_record_frame_);
+  // 直前のレコードのデータもここで確かめる
+  CheckWrite();
+  last_record_frame_ = frame_;
+}
+
+void MovieRecorder::CheckWrite() {
+  if (out_.fail()) {
+    Error("Failed to write the movie.");
+  }
+}
+
+bool MoviePlayer::Open() {
+  char magic[sizeof(kMovieMagic)];
+  std::uint32_t version;
+  std::uint32_t start_state_size;
+  if (!in_.read(magic, sizeof(magic)) ||
+      std::memcmp(magic, kMovieMagic, sizeof(magic)) != 0 ||
+      !ReadLittleEndian(in_, version) || version != kMovieVersion ||
+      !ReadLittleEndian(in_, rom_hash_) ||
+      !ReadLittleEndian(in_, start_state_size)) {
+    return false;
+  }
+  // 壊れたファイルの大きさを信じて巨大な領域を確保しないようにする
+  if (start_state_size > kMaxStartStateSize ||
+      start_state_size > GetRemainingSize(in_)) {
+    return false;
+  }
+  start_state_.resize(start_state_size);
+  if (!in_.read(reinterpret_cast<char*>(start_state_.data()),
+                start_state_size)) {
+    return false;
+  }
+  ReadNextRecord();
+  return !is_corrupted_;
+}
+
+bool MoviePlayer::Start(GameBoy& gb, const std::vector<std::uint8_t>& rom) {
+  if (HashRom(rom) != rom_hash_) {
+    return false;
+  }
+  if (!start_state_.empty() && !gb.LoadState(start_state_)) {
+    return false;
+  }
+  frame_ = 0;
+  return true;
+}
+
+bool MoviePlayer::Step(GameBoy& gb) {
+  // このフレームを進める前に適用する入力
+  while (next_.tag == kInputTag && next_.frame == frame_) {
+    SetPressedKeyMask(gb, static_cast<std::uint8_t>(next_.value));
+    ReadNextRecord();
+  }
+  if (next_.tag == kEndTag && next_.frame <= frame_) {
+    return false;
+  }
+
+  gb.Step();
+  frame_++;
+
+  // このフレームを進めた直後の画面のハッシュ値
+  while (next_.tag == kHashTag && next_.frame == frame_) {
+    if (verify_) {
+      num_verified_++;
+      if (HashFrame(gb.GetPpuBuffer()) != next_.value) {
+        if (num_mismatches_ == 0) {
+          first_mismatch_frame_ = frame_;
+        }
+        num_mismatches_++;
+      }
+    }
+    ReadNextRecord();
+  }
+  return true;
+}
+
+void MoviePlayer::ReadNextRecord() {
+  int tag = in_.get();
+  std::uint64_t delta;
+  bool ok = tag != std::istream::traits_type::eof() && ReadVarint(in_, delta);
+  if (ok) {
+    next_.tag = static_cast<char>(tag);
+    next_.frame += delta;
+    if (next_.tag == kInputTag) {
+      std::uint8_t mask;
+      ok = ReadLittleEndian(in_, mask);
+      next_.value = mask;
+    } else if (next_.tag == kHashTag) {
+      ok = ReadLittleEndian(in_, next_.value);
+    } else {
+      ok = next_.tag == kEndTag;
+    }
+  }
+  // レコードの順序が崩れていたら不正とする
+  if (ok && next_.frame < frame_) {
+    ok = false;
+  }
+  if (!ok) {
+    // 記録の途中で切れたファイルは、読めたところまでで終わりとする
+    is_corrupted_ = true;
+    next_.tag = kEndTag;
+    next_.frame = frame_;
+  }
+}
+
+}  // namespace gbemu
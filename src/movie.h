@@ -0,0 +1,135 @@
+#ifndef GBEMU_MOVIE_H_
+#define GBEMU_MOVIE_H_
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "gameboy.h"
+
+namespace gbemu {
+
+// キー入力を記録したムービーの形式。
+// 数値はリトルエンディアンで、varintは7ビットずつ下位から詰めた可変長整数。
+//   "GBMV"  u32 バージョン  u64 ROMのハッシュ値
+//   u32 開始時のセーブステートのサイズ（0なら電源投入から開始）  セーブステート
+//   レコードの列
+// 各レコードはタグ（1バイト）、直前のレコードからのフレーム数（varint）、
+// タグごとのデータからなる。フレームはそれまでに進めたフレーム数で数える。
+//   'I'  u8 押しているキーのビットマスク（GetKeyMaskを参照）。
+//        そのフレームを進める直前から適用する。
+//   'H'  u64 そのフレームを進めた直後の画面のハッシュ値（HashFrameを参照）。
+//   'E'  終端。フレームはムービーの長さとなる。
+// レコードは起きた順に書き出すので、記録しながらファイルに流し込める。
+
+// ムービーを記録するクラス。
+// Example:
+//   MovieRecorder recorder(ofs, rom);
+//   for (;;) {
+//     recorder.BeginFrame(gb);
+//     gb.Step();
+//     recorder.EndFrame(gb);
+//   }
+//   recorder.Finish();
+class MovieRecorder {
+ public:
+  // ヘッダを書き出す。start_stateが空でなければそのセーブステートから開始する。
+  // hash_intervalフレームごとに画面のハッシュ値を記録する。0なら記録しない。
+  MovieRecorder(std::ostream& out, const std::vector<std::uint8_t>& rom,
+                const std::vector<std::uint8_t>& start_state = {},
+                unsigned hash_interval = 1);
+  ~MovieRecorder();
+
+  MovieRecorder(const MovieRecorder&) = delete;
+  MovieRecorder& operator=(const MovieRecorder&) = delete;
+
+  // フレームを進める直前に呼ぶ。押しているキーが変化していたら記録する。
+  void BeginFrame(const GameBoy& gb);
+
+  // フレームを進めた直後に呼ぶ。必要なら画面のハッシュ値を記録する。
+  void EndFrame(const GameBoy& gb);
+
+  // 終端を書き出す。以降は何も記録しない。
+  void Finish();
+
+  std::uint64_t num_frames() const { return frame_; }
+
+ private:
+  void WriteRecordHeader(char tag);
+  // 書き込みに失敗していたらプログラムを終了する。
+  void CheckWrite();
+
+  std::ostream& out_;
+  unsigned hash_interval_;
+  std::uint64_t frame_{0};
+  std::uint64_t last_record_frame_{0};
+  int last_key_mask_{-1};  // まだ記録していなければ-1
+  bool is_finished_{false};
+};
+
+// ムービーを再生するクラス。
+// Example:
+//   MoviePlayer player(ifs);
+//   if (!player.Open() || !player.Start(gb, rom)) {
+//     Error("Invalid movie.");
+//   }
+//   while (player.Step(gb)) {
+//   }
+class MoviePlayer {
+ public:
+  explicit MoviePlayer(std::istream& in) : in_(in) {}
+
+  // ヘッダを読み込む。形式が不正ならfalseを返す。
+  bool Open();
+
+  // gbをムービーの開始時の状態にする。
+  // gbは電源投入直後のものを渡すこと。
+  // ROMが記録時と異なるか、セーブステートを読み込めなければfalseを返す。
+  bool Start(GameBoy& gb, const std::vector<std::uint8_t>& rom);
+
+  // キー入力を適用して1フレーム進める。
+  // ムービーの終端に達したか、レコードが不正なら進めずにfalseを返す。
+  bool Step(GameBoy& gb);
+
+  // 記録されたハッシュ値と画面を照合するかどうか設定する。
+  void set_verify(bool verify) { verify_ = verify; }
+
+  std::uint64_t frame() const { return frame_; }
+  bool has_start_state() const { return !start_state_.empty(); }
+  // レコードが不正だったかどうか。
+  bool is_corrupted() const { return is_corrupted_; }
+  // 照合したハッシュ値の数と一致しなかった数。
+  std::uint64_t num_verified() const { return num_verified_; }
+  std::uint64_t num_mismatches() const { return num_mismatches_; }
+  // 最初に一致しなかったフレーム。なければ0。
+  std::uint64_t first_mismatch_frame() const { return first_mismatch_frame_; }
+
+ private:
+  struct Record {
+    char tag;
+    std::uint64_t frame;
+    std::uint64_t value;
+  };
+
+  // 次のレコードを読み込む。不正ならis_corrupted_を立てて終端とみなす。
+  void ReadNextRecord();
+
+  std::istream& in_;
+  std::uint64_t rom_hash_{0};
+  std::vector<std::uint8_t> start_state_;
+  Record next_{};
+  std::uint64_t frame_{0};
+  bool verify_{false};
+  bool is_corrupted_{false};
+  std::uint64_t num_verified_{0};
+  std::uint64_t num_mismatches_{0};
+  std::uint64_t first_mismatch_frame_{0};
+};
+
+// ムービーに記録するROMのハッシュ値を計算する。
+std::uint64_t HashRom(const std::vector<std::uint8_t>& rom);
+
+}  // namespace gbemu
+
+#endif  // GBEMU_MOVIE_H_
@@ -0,0 +1,169 @@
+#include "observation.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#ifdef GBEMU_OBSERVATION_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "lcd.h"
+#include "utils.h"
+
+namespace gbemu {
+
+ObservationEncoder::ObservationEncoder(const Config& config)
+    : config_(config) {
+  ASSERT(config_.width > 0 && config_.width <= lcd::kWidth &&
+             config_.height > 0 && config_.height <= lcd::kHeight,
+         "Invalid observation size: %ux%u", config_.width, config_.height);
+
+  switch (config_.filter) {
+    case Filter::kArea:
+      // 出力の各ピクセルが平均をとるLCD上の範囲を求めておく
+      for (unsigned x = 0; x < config_.width; x++) {
+        column_begin_.push_back(x * lcd::kWidth / config_.width);
+        column_end_.push_back((x + 1) * lcd::kWidth / config_.width);
+      }
+      for (unsigned y = 0; y < config_.height; y++) {
+        row_begin_.push_back(y * lcd::kHeight / config_.height);
+        row_end_.push_back((y + 1) * lcd::kHeight / config_.height);
+      }
+      break;
+    case Filter::kNearest:
+      // 出力の各ピクセルの中心に対応するLCDのピクセルを1つだけ参照する
+      for (unsigned x = 0; x < config_.width; x++) {
+        column_begin_.push_back((2 * x + 1) * lcd::kWidth /
+                                (2 * config_.width));
+        column_end_.push_back(column_begin_.back() + 1);
+      }
+      for (unsigned y = 0; y < config_.height; y++) {
+        row_begin_.push_back((2 * y + 1) * lcd::kHeight /
+                             (2 * config_.height));
+        row_end_.push_back(row_begin_.back() + 1);
+      }
+      break;
+    default:
+      UNREACHABLE("Invalid filter.");
+  }
+
+  min_rows_ = lcd::kHeight;
+  for (unsigned y = 0; y < config_.height; y++) {
+    min_rows_ = std::min(min_rows_, row_end_[y] - row_begin_[y]);
+  }
+  for (unsigned rows = min_rows_; rows <= min_rows_ + 1; rows++) {
+    for (unsigned x = 0; x < config_.width; x++) {
+      std::uint64_t area = rows * (column_end_[x] - column_begin_[x]);
+      reciprocals_.push_back((std::uint64_t{1} << kReciprocalShift) / area +
+                             1);
+    }
+  }
+}
+
+void ObservationEncoder::EncodeScalar(const GbLcdPixelMatrix& frame,
+                                      const GbLcdPixelMatrix* previous,
+                                      std::uint8_t* out) const {
+  for (unsigned y = 0; y < config_.height; y++) {
+    for (unsigned x = 0; x < config_.width; x++) {
+      unsigned sum = 0;
+      for (unsigned i = row_begin_[y]; i < row_end_[y]; i++) {
+        for (unsigned j = column_begin_[x]; j < column_end_[x]; j++) {
+          lcd::GbLcdColor color = frame[i][j];
+          if (previous != nullptr) {
+            color = std::max(color, (*previous)[i][j]);
+          }
+          sum += config_.gray_levels[color];
+        }
+      }
+      unsigned area =
+          (row_end_[y] - row_begin_[y]) * (column_end_[x] - column_begin_[x]);
+      *out++ = sum / area;
+    }
+  }
+}
+
+void ObservationEncoder::EncodeNearest(const GbLcdPixelMatrix& frame,
+                                       const GbLcdPixelMatrix* previous,
+                                       std::uint8_t* out) const {
+  for (unsigned y = 0; y < config_.height; y++) {
+    const GbLcdPixelRow& row = frame[row_begin_[y]];
+    if (previous == nullptr) {
+      for (unsigned x = 0; x < config_.width; x++) {
+        *out++ = config_.gray_levels[row[column_begin_[x]]];
+      }
+    } else {
+      const GbLcdPixelRow& previous_row = (*previous)[row_begin_[y]];
+      for (unsigned x = 0; x < config_.width; x++) {
+        unsigned column = column_begin_[x];
+        *out++ = config_.gray_levels[std::max(row[column],
+                                              previous_row[column])];
+      }
+    }
+  }
+}
+
+#ifdef GBEMU_OBSERVATION_SSE2
+void ObservationEncoder::EncodeSse2(const GbLcdPixelMatrix& frame,
+                                    const GbLcdPixelMatrix* previous,
+                                    std::uint8_t* out) const {
+  if (config_.filter == Filter::kNearest) {
+    EncodeNearest(frame, previous, out);
+    return;
+  }
+
+  static_assert(lcd::kWidth % 16 == 0);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i colors[lcd::kColorNum];
+  __m128i grays[lcd::kColorNum];
+  for (int i = 0; i < lcd::kColorNum; i++) {
+    colors[i] = _mm_set1_epi8(i);
+    grays[i] = _mm_set1_epi8(config_.gray_levels[i]);
+  }
+  auto load = [](const GbLcdPixelRow& row, unsigned x) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(&row[x]));
+  };
+
+  // 出力の1行が覆うLCDの行を、列ごとに16ビットで足し合わせる。
+  // 1列の和は最大でも255 * 144なので溢れない。
+  std::array<std::uint16_t, lcd::kWidth> column_sums;
+  for (unsigned y = 0; y < config_.height; y++) {
+    __m128i sums[lcd::kWidth / 8];
+    std::fill(std::begin(sums), std::end(sums), zero);
+    for (unsigned i = row_begin_[y]; i < row_end_[y]; i++) {
+      for (unsigned x = 0; x < lcd::kWidth; x += 16) {
+        __m128i color = load(frame[i], x);
+        if (previous != nullptr) {
+          color = _mm_max_epu8(color, load((*previous)[i], x));
+        }
+        // 4つの色との比較と選択でグレースケールの値に変換する
+        __m128i gray = zero;
+        for (int c = 0; c < lcd::kColorNum; c++) {
+          __m128i match = _mm_cmpeq_epi8(color, colors[c]);
+          gray = _mm_or_si128(gray, _mm_and_si128(match, grays[c]));
+        }
+        sums[x / 8] =
+            _mm_add_epi16(sums[x / 8], _mm_unpacklo_epi8(gray, zero));
+        sums[x / 8 + 1] =
+            _mm_add_epi16(sums[x / 8 + 1], _mm_unpackhi_epi8(gray, zero));
+      }
+    }
+    for (unsigned x = 0; x < lcd::kWidth; x += 8) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(&column_sums[x]),
+                       sums[x / 8]);
+    }
+
+    const std::uint64_t* reciprocals = GetReciprocals(y);
+    for (unsigned x = 0; x < config_.width; x++) {
+      std::uint32_t sum = 0;
+      for (unsigned j = column_begin_[x]; j < column_end_[x]; j++) {
+        sum += column_sums[j];
+      }
+      *out++ = (sum * reciprocals[x]) >> kReciprocalShift;
+    }
+  }
+}
+#endif
+
+}  // namespace gbemu
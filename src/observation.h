@@ -0,0 +1,117 @@
+#ifndef GBEMU_OBSERVATION_H_
+#define GBEMU_OBSERVATION_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#define GBEMU_OBSERVATION_SSE2
+#endif
+
+#include "lcd.h"
+
+namespace gbemu {
+
+// LCDの画面を、強化学習の観測に使う縮小したグレースケールの画像にするクラス。
+// 縮小の方法と出力のサイズに応じた表を構築時に作っておき、
+// Encodeでは呼び出し側が用意したバッファに1ピクセル1バイトで書き出す。
+// 直前のフレームを渡すと、2フレームのピクセルごとに暗い方の色をとってから
+// 縮小する（1フレームおきに点滅させて表示するObjectを取りこぼさないため）。
+// Example:
+//   ObservationEncoder::Config config;
+//   config.width = 84;
+//   config.height = 84;
+//   ObservationEncoder encoder(config);
+//   std::vector<std::uint8_t> observation(encoder.size());
+//   encoder.Encode(gb.GetPpuBuffer(), nullptr, observation.data());
+class ObservationEncoder {
+ public:
+  // 縮小の方法。
+  enum class Filter {
+    // 出力の各ピクセルに対応するLCD上の範囲の平均をとる
+    kArea,
+    // 出力の各ピクセルの中心に最も近いLCDのピクセルをとる
+    kNearest,
+  };
+
+  struct Config {
+    // 出力の画像のサイズ。LCDのサイズ以下であること。
+    unsigned width{84};
+    unsigned height{84};
+    Filter filter{Filter::kArea};
+    // LCDの色（GbLcdColorの値）に対応するグレースケールの値
+    std::array<std::uint8_t, lcd::kColorNum> gray_levels{{255, 170, 85, 0}};
+  };
+
+  explicit ObservationEncoder(const Config& config);
+
+  // 出力の画像のバイト数。
+  std::size_t size() const {
+    return static_cast<std::size_t>(config_.width) * config_.height;
+  }
+
+  const Config& config() const { return config_; }
+
+  // frameを縮小してoutにsize()バイト書き出す。
+  // previousがnullptrでなければ、frameとのピクセルごとの最大（暗い方）を
+  // 縮小する。
+  // SSE2を使えればSSE2の実装を、そうでなければスカラー実装を使う。
+  void Encode(const GbLcdPixelMatrix& frame, const GbLcdPixelMatrix* previous,
+              std::uint8_t* out) const {
+#ifdef GBEMU_OBSERVATION_SSE2
+    EncodeSse2(frame, previous, out);
+#else
+    EncodeScalar(frame, previous, out);
+#endif
+  }
+
+  // 出力の1ピクセルずつ範囲内のLCDのピクセルを足し合わせる素朴な実装。
+  // 他の実装の正しさの基準にする。
+  void EncodeScalar(const GbLcdPixelMatrix& frame,
+                    const GbLcdPixelMatrix* previous, std::uint8_t* out) const;
+
+#ifdef GBEMU_OBSERVATION_SSE2
+  // EncodeScalarと同じ結果を、SSE2で求める。
+  // 面積平均では、LCDの各行を16ピクセルずつグレースケールに変換して列ごとの和に
+  // 足し込み、出力の1ピクセルごとには列の和を数個足して逆数を掛けるだけにする。
+  // 最近傍は参照するピクセルが少ないのでスカラー実装と同じ処理をする。
+  void EncodeSse2(const GbLcdPixelMatrix& frame,
+                  const GbLcdPixelMatrix* previous, std::uint8_t* out) const;
+#endif
+
+ private:
+  // 最近傍で縮小する。どの実装でも共通。
+  void EncodeNearest(const GbLcdPixelMatrix& frame,
+                     const GbLcdPixelMatrix* previous, std::uint8_t* out) const;
+
+  // 出力のピクセルの面積（LCDのピクセル数）で割る代わりに掛ける値を、
+  // 出力のrow行目の各列について並べたものを得る。
+  const std::uint64_t* GetReciprocals(unsigned row) const {
+    unsigned rows = row_end_[row] - row_begin_[row];
+    return &reciprocals_[(rows - min_rows_) * config_.width];
+  }
+
+  // 逆数を掛けた後に右シフトするビット数。
+  // 和は255 * 面積以下なので、面積がLCD全体でも商は割り算と一致する。
+  static constexpr unsigned kReciprocalShift = 40;
+
+  Config config_;
+
+  // 出力の各列・各行に対応するLCD上の範囲[begin, end)。
+  // 最近傍ではbeginだけを使い、それが参照するLCDの列・行になる。
+  std::vector<unsigned> column_begin_;
+  std::vector<unsigned> column_end_;
+  std::vector<unsigned> row_begin_;
+  std::vector<unsigned> row_end_;
+
+  // 面積平均の割り算に使う逆数。出力の行が覆うLCDの行数は
+  // min_rows_かmin_rows_ + 1のどちらかなので、行数ごとに出力の列の数だけ持つ。
+  unsigned min_rows_{};
+  std::vector<std::uint64_t> reciprocals_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_OBSERVATION_H_
@@ -0,0 +1,325 @@
+#include "pixel_lz.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "byte_io.h"
+
+namespace gbemu {
+
+namespace {
+
+// ハッシュ表の大きさ（ビット数）
+constexpr unsigned kHashBits = 12;
+// ハッシュ値を求めるピクセル数。1ピクセル1バイトなので8バイトをまとめて読む
+constexpr std::size_t kHashPixels = 8;
+constexpr std::uint32_t kNoPosition = UINT32_MAX;
+// 参照する画面はこの間隔の位置だけを登録する。一致の途中の位置が見つかれば、
+// 後ろに伸ばして先頭を求められる
+constexpr std::size_t kIndexStride = 4;
+// 一致しない位置が続いたら、2^kSkipShift回ごとに探す間隔を1つ広げる
+constexpr unsigned kSkipShift = 5;
+
+// トークンのリテラルの長さとコピーの長さがこの値なら、続きがvarintで続く
+constexpr std::size_t kLiteralExtended = 3;
+constexpr std::size_t kLengthExtended = 15;
+
+// コピー元の距離の種類（pixel_lz.hを参照）
+enum DistanceKind : std::uint8_t {
+  kExplicitDistance = 0,
+  kLastDistance = 1,
+  kSecondLastDistance = 2,
+  kSamePosition = 3,
+};
+
+std::uint32_t Hash(const std::uint8_t* pixels) {
+  std::uint64_t key;
+  std::memcpy(&key, pixels, kHashPixels);
+  return static_cast<std::uint32_t>((key * 0x9E3779B97F4A7C15u) >>
+                                    (64 - kHashBits));
+}
+
+// aとbが先頭から一致している長さを求める（最大limit）。8バイトずつ比較する。
+std::size_t CountEqual(const std::uint8_t* a, const std::uint8_t* b,
+                       std::size_t limit) {
+  std::size_t i = 0;
+  while (i + 8 <= limit) {
+    std::uint64_t x, y;
+    std::memcpy(&x, a + i, 8);
+    std::memcpy(&y, b + i, 8);
+    if (x != y) {
+      break;
+    }
+    i += 8;
+  }
+  while (i < limit && a[i] == b[i]) {
+    i++;
+  }
+  return i;
+}
+
+// countピクセルを4ピクセルずつ1バイトに詰めてoutに追加する。
+void AppendLiterals(const std::uint8_t* pixels, std::size_t count,
+                    std::vector<std::uint8_t>& out) {
+  for (std::size_t i = 0; i < count; i += 4) {
+    std::uint8_t byte = 0;
+    for (std::size_t j = i; j < std::min(i + 4, count); j++) {
+      byte |= (pixels[j] & 3) << ((j - i) * 2);
+    }
+    out.push_back(byte);
+  }
+}
+
+// トークンと、リテラルの長さが収まらなければその続きを書き出し、
+// リテラルを追加する。
+void AppendToken(const std::uint8_t* literals, std::size_t literal_count,
+                 std::size_t length_code, DistanceKind kind,
+                 std::vector<std::uint8_t>& out) {
+  out.push_back(static_cast<std::uint8_t>(
+      (std::min<std::size_t>(literal_count, kLiteralExtended) << 6) |
+      (std::min<std::size_t>(length_code, kLengthExtended) << 2) | kind));
+  if (literal_count >= kLiteralExtended) {
+    AppendVarint(out, literal_count - kLiteralExtended);
+  }
+  AppendLiterals(literals, literal_count, out);
+}
+
+std::uint64_t ZigZag(std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t UnZigZag(std::uint64_t value) {
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+
+}  // namespace
+
+void PixelLzEncoder::Encode(const std::uint8_t* pixels,
+                            const std::uint8_t* reference, std::size_t n,
+                            std::vector<std::uint8_t>& out) {
+  out.clear();
+  if (CountEqual(reference, pixels, n) == n) {
+    return;
+  }
+  // ハッシュ表は、同じ位置と直前の距離の候補で一致しなかったときに初めて作る。
+  // ほとんど変わらない画面では作らずに済む
+  bool is_indexed = false;
+  // 直前とその前のコピーの距離。スクロールした画面では同じ距離のコピーが続く
+  std::size_t last_distances[2] = {n, n};
+  std::size_t literal_begin = 0;
+  std::size_t misses = 0;
+  std::size_t i = 0;
+  while (i < n) {
+    std::size_t best_length = 0;
+    std::size_t best_distance = 0;
+    auto try_distance = [&](std::size_t distance) {
+      // コピー元の、参照する画面と符号化する画面を並べた上での位置
+      std::size_t source = n + i - distance;
+      std::size_t limit = n - i;
+      const std::uint8_t* from;
+      if (source < n) {
+        // 参照する画面から符号化する画面にまたがるコピーはしない
+        limit = std::min(limit, n - source);
+        from = reference + source;
+      } else {
+        from = pixels + (source - n);
+      }
+      std::size_t length = CountEqual(from, pixels + i, limit);
+      if (length > best_length) {
+        best_length = length;
+        best_distance = distance;
+      }
+    };
+
+    // 書き出すのが短くて済む順に試す
+    try_distance(n);
+    for (std::size_t distance : last_distances) {
+      if (distance != n && distance <= n + i) {
+        try_distance(distance);
+      }
+    }
+    if (best_length < kPixelLzMinMatch && i + kHashPixels <= n) {
+      if (!is_indexed) {
+        IndexReference(reference, n);
+        is_indexed = true;
+      }
+      std::uint32_t& entry = table_[Hash(pixels + i)];
+      if (entry != kNoPosition) {
+        try_distance(n + i - entry);
+      }
+      entry = static_cast<std::uint32_t>(n + i);
+    }
+
+    if (best_length < kPixelLzMinMatch) {
+      i += 1 + (misses++ >> kSkipShift);
+      continue;
+    }
+    misses = 0;
+    // 飛ばした位置や登録しなかった位置から始まる一致を後ろに伸ばす
+    std::size_t source = n + i - best_distance;
+    std::size_t source_begin = source < n ? 0 : n;
+    while (i > literal_begin && source > source_begin &&
+           pixels[i - 1] ==
+               (source <= n ? reference[source - 1] : pixels[source - 1 - n])) {
+      i--;
+      source--;
+      best_length++;
+    }
+
+    DistanceKind kind = kExplicitDistance;
+    if (best_distance == n) {
+      kind = kSamePosition;
+    } else if (best_distance == last_distances[0]) {
+      kind = kLastDistance;
+    } else if (best_distance == last_distances[1]) {
+      kind = kSecondLastDistance;
+      std::swap(last_distances[0], last_distances[1]);
+    } else {
+      last_distances[1] = last_distances[0];
+      last_distances[0] = best_distance;
+    }
+    std::size_t length_code = best_length - kPixelLzMinMatch;
+    AppendToken(pixels + literal_begin, i - literal_begin, length_code, kind,
+                out);
+    if (length_code >= kLengthExtended) {
+      AppendVarint(out, length_code - kLengthExtended);
+    }
+    if (kind == kExplicitDistance) {
+      AppendVarint(out, ZigZag(static_cast<std::int64_t>(best_distance) -
+                               static_cast<std::int64_t>(n)));
+    }
+    i += best_length;
+    literal_begin = i;
+  }
+  if (literal_begin < n) {
+    AppendToken(pixels + literal_begin, n - literal_begin, 0, kSamePosition,
+                out);
+  }
+
+  // コピーがほとんど見つからずにすべてリテラルにするより大きくなったら、
+  // すべてリテラルにする
+  std::size_t literal_size = 1 + (n + 3) / 4 + 1;
+  for (std::size_t value = n - kLiteralExtended; value >= 0x80; value >>= 7) {
+    literal_size++;
+  }
+  if (out.size() > literal_size) {
+    out.clear();
+    AppendToken(pixels, n, 0, kSamePosition, out);
+  }
+}
+
+void PixelLzEncoder::IndexReference(const std::uint8_t* reference,
+                                    std::size_t n) {
+  table_.assign(std::size_t{1} << kHashBits, kNoPosition);
+  for (std::size_t i = 0; i + kHashPixels <= n; i += kIndexStride) {
+    table_[Hash(reference + i)] = static_cast<std::uint32_t>(i);
+  }
+}
+
+bool DecodePixelLz(const std::uint8_t* data, std::size_t size,
+                   const std::uint8_t* reference, std::uint8_t* pixels,
+                   std::size_t n) {
+  if (size == 0) {
+    std::memcpy(pixels, reference, n);
+    return true;
+  }
+  const std::uint8_t* p = data;
+  const std::uint8_t* end = data + size;
+  std::size_t last_distances[2] = {n, n};
+  std::size_t i = 0;
+  while (i < n) {
+    if (p == end) {
+      return false;
+    }
+    std::uint8_t token = *p++;
+    std::uint64_t literal_count = token >> 6;
+    std::uint64_t length = (token >> 2) & 0xF;
+    auto kind = static_cast<DistanceKind>(token & 3);
+    if (literal_count == kLiteralExtended) {
+      std::uint64_t extra;
+      if (!ReadVarint(p, end, extra) || extra > n) {
+        return false;
+      }
+      literal_count += extra;
+    }
+    if (literal_count > n - i ||
+        (literal_count + 3) / 4 > static_cast<std::size_t>(end - p)) {
+      return false;
+    }
+    for (std::size_t j = 0; j < literal_count; j++) {
+      pixels[i + j] = (p[j / 4] >> ((j % 4) * 2)) & 3;
+    }
+    p += (literal_count + 3) / 4;
+    i += literal_count;
+    if (i == n) {
+      break;
+    }
+
+    if (length == kLengthExtended) {
+      std::uint64_t extra;
+      if (!ReadVarint(p, end, extra) || extra > n) {
+        return false;
+      }
+      length += extra;
+    }
+    length += kPixelLzMinMatch;
+    if (length > n - i) {
+      return false;
+    }
+    std::size_t distance = n;
+    switch (kind) {
+      case kExplicitDistance: {
+        std::uint64_t code;
+        if (!ReadVarint(p, end, code)) {
+          return false;
+        }
+        std::int64_t offset = UnZigZag(code);
+        if (offset <= -static_cast<std::int64_t>(n) ||
+            offset > static_cast<std::int64_t>(i)) {
+          return false;
+        }
+        distance = static_cast<std::size_t>(static_cast<std::int64_t>(n) +
+                                            offset);
+        last_distances[1] = last_distances[0];
+        last_distances[0] = distance;
+        break;
+      }
+      case kLastDistance:
+        distance = last_distances[0];
+        break;
+      case kSecondLastDistance:
+        std::swap(last_distances[0], last_distances[1]);
+        distance = last_distances[0];
+        break;
+      case kSamePosition:
+        break;
+    }
+    if (distance > n + i) {
+      return false;
+    }
+    // 参照する画面と符号化する画面を並べた上でのコピー元の位置
+    std::size_t source = n + i - distance;
+    if (source < n) {
+      if (length > n - source) {
+        return false;
+      }
+      std::memcpy(pixels + i, reference + source, length);
+    } else {
+      // コピー元とコピー先が重なることがあるので1ピクセルずつ進める
+      const std::uint8_t* from = pixels + (source - n);
+      for (std::size_t j = 0; j < length; j++) {
+        pixels[i + j] = from[j];
+      }
+    }
+    i += length;
+  }
+  return p == end;
+}
+
+}  // namespace gbemu
@@ -0,0 +1,65 @@
+#ifndef GBEMU_PIXEL_LZ_H_
+#define GBEMU_PIXEL_LZ_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gbemu {
+
+// 1ピクセル1バイト（値は0〜3）の画面を、参照する画面（直前のフレームなど）を
+// 辞書にしてLZ77で符号化する形式。
+// 参照する画面のnピクセルと符号化する画面のnピクセルを続けて並べたものの上で、
+// 符号化する画面の各位置を「それより前の任意の位置からのコピー」か
+// 「そのままのピクセル」で表す。ピクセル単位で一致を探すので、止まっている
+// 部分だけでなく、1ピクセルずつの横スクロールや縦スクロール、動く
+// オブジェクトも参照する画面からのコピーになる。
+// 次の組を画面の終わりまで繰り返す。varintはbyte_io.hのもの。
+//   トークン（1バイト）
+//     ビット7-6  リテラルの長さ（3ならvarintで長さ - 3が続く）
+//     ビット5-2  コピーの長さ - kPixelLzMinMatch（15ならvarintで残りが続く）
+//     ビット1-0  コピー元の距離の種類
+//       0  varintで距離からnを引いた値（zigzagで符号なしにしたもの）が続く
+//       1  直前のコピーと同じ距離
+//       2  その前のコピーと同じ距離（以降はこちらが直前のコピーになる）
+//       3  参照する画面の同じ位置（距離n）。直前のコピーには数えない
+//   [varint リテラルの長さ - 3]
+//   リテラル（4ピクセルずつ1バイトに下位ビットから詰める）
+//   [varint コピーの長さ - kPixelLzMinMatch - 15]
+//   [varint 距離 - n]
+// 距離は並べた上でのコピー先とコピー元の差。リテラルで画面の終わりに
+// 達したら、トークンのコピーの部分は使わない。参照する画面と同じなら
+// 何も書き出さない。
+
+// コピーとして書き出す最短の長さ（ピクセル）。
+constexpr std::size_t kPixelLzMinMatch = 16;
+
+// 符号化の作業領域（一致を探すハッシュ表）を持つクラス。
+// 作業領域を使い回すため、同じインスタンスで何度も符号化すること。
+class PixelLzEncoder {
+ public:
+  // nピクセルのpixelsを、nピクセルのreferenceを辞書にして符号化し、
+  // outに書き出す。outの元の内容は捨てる。
+  // 書き出すのはnピクセルをすべてリテラルにした大きさ以下になる。
+  void Encode(const std::uint8_t* pixels, const std::uint8_t* reference,
+              std::size_t n, std::vector<std::uint8_t>& out);
+
+ private:
+  // 参照する画面の位置をハッシュ表に登録する。
+  void IndexReference(const std::uint8_t* reference, std::size_t n);
+
+  // 8ピクセルのハッシュ値をキーにして、最後に現れた位置（並べた上での位置）
+  // を持つ。kNoPositionなら未登録。
+  std::vector<std::uint32_t> table_;
+};
+
+// nピクセルのreferenceを辞書にして復元し、nピクセルのpixelsに書き出す。
+// pixelsとreferenceは重なってはならない。
+// 壊れていたらfalseを返す（pixelsは途中まで書き換わる）。
+bool DecodePixelLz(const std::uint8_t* data, std::size_t size,
+                   const std::uint8_t* reference, std::uint8_t* pixels,
+                   std::size_t n);
+
+}  // namespace gbemu
+
+#endif  // GBEMU_PIXEL_LZ_H_
@@ -0,0 +1,134 @@
+#include "png_writer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ppu.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+// CRC-32（PNGのチャンクの検査値）のテーブル
+std::array<std::uint32_t, 256> MakeCrcTable() {
+  std::array<std::uint32_t, 256> table;
+  for (std::uint32_t n = 0; n < 256; n++) {
+    std::uint32_t c = n;
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    }
+    table[n] = c;
+  }
+  return table;
+}
+
+std::uint32_t Crc32(const std::uint8_t* data, std::size_t size) {
+  static const std::array<std::uint32_t, 256> table = MakeCrcTable();
+  std::uint32_t c = 0xFFFFFFFF;
+  for (std::size_t i = 0; i < size; i++) {
+    c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+  }
+  return c ^ 0xFFFFFFFF;
+}
+
+// Adler-32（zlibストリームの検査値）
+std::uint32_t Adler32(const std::vector<std::uint8_t>& data) {
+  constexpr std::uint32_t kMod = 65521;
+  std::uint32_t a = 1, b = 0;
+  for (std::uint8_t byte : data) {
+    a = (a + byte) % kMod;
+    b = (b + a) % kMod;
+  }
+  return (b << 16) | a;
+}
+
+void PushBigEndian32(std::vector<std::uint8_t>& out, std::uint32_t value) {
+  out.push_back(value >> 24);
+  out.push_back(value >> 16);
+  out.push_back(value >> 8);
+  out.push_back(value);
+}
+
+// 長さ、タイプ、データ、CRCからなるチャンクを追加する。
+void PushChunk(std::vector<std::uint8_t>& out, const char* type,
+               const std::vector<std::uint8_t>& data) {
+  PushBigEndian32(out, data.size());
+  std::size_t type_begin = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  PushBigEndian32(out, Crc32(&out[type_begin], out.size() - type_begin));
+}
+
+// データをstoredブロックだけからなるzlibストリームにする。
+std::vector<std::uint8_t> ZlibStore(const std::vector<std::uint8_t>& data) {
+  constexpr std::size_t kMaxBlockSize = 65535;
+  std::vector<std::uint8_t> out{0x78, 0x01};  // deflate、32KBの窓、圧縮なし
+  std::size_t pos = 0;
+  do {
+    std::size_t size = std::min(kMaxBlockSize, data.size() - pos);
+    bool is_final = pos + size == data.size();
+    out.push_back(is_final ? 1 : 0);  // BFINALとBTYPE=00（stored）
+    out.push_back(size & 0xFF);
+    out.push_back(size >> 8);
+    out.push_back(~size & 0xFF);
+    out.push_back((~size >> 8) & 0xFF);
+    out.insert(out.end(), data.begin() + pos, data.begin() + pos + size);
+    pos += size;
+  } while (pos < data.size());
+  PushBigEndian32(out, Adler32(data));
+  return out;
+}
+
+}  // namespace
+
+std::vector<std::uint8_t> EncodePng(unsigned width, unsigned height,
+                                    const std::vector<std::uint8_t>& gray) {
+  ASSERT(gray.size() == static_cast<std::size_t>(width) * height,
+         "Invalid image size.");
+  std::vector<std::uint8_t> png{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+  std::vector<std::uint8_t> ihdr;
+  PushBigEndian32(ihdr, width);
+  PushBigEndian32(ihdr, height);
+  ihdr.push_back(8);  // ビット深度
+  ihdr.push_back(0);  // カラータイプ（グレースケール）
+  ihdr.push_back(0);  // 圧縮方式
+  ihdr.push_back(0);  // フィルタ方式
+  ihdr.push_back(0);  // インターレースなし
+  PushChunk(png, "IHDR", ihdr);
+
+  // 各行の先頭にフィルタの種類（0: なし）を置く
+  std::vector<std::uint8_t> raw;
+  raw.reserve((width + 1) * height);
+  for (unsigned y = 0; y < height; y++) {
+    raw.push_back(0);
+    raw.insert(raw.end(), gray.begin() + y * width,
+               gray.begin() + (y + 1) * width);
+  }
+  PushChunk(png, "IDAT", ZlibStore(raw));
+  PushChunk(png, "IEND", {});
+  return png;
+}
+
+std::vector<std::uint8_t> EncodeFramePng(const GbLcdPixelMatrix& frame) {
+  static constexpr std::uint8_t kShades[] = {232, 160, 88, 16};
+  std::vector<std::uint8_t> gray;
+  gray.reserve(lcd::kTotalPixelNum);
+  for (const GbLcdPixelRow& row : frame) {
+    for (lcd::GbLcdColor color : row) {
+      gray.push_back(kShades[color & 3]);
+    }
+  }
+  return EncodePng(lcd::kWidth, lcd::kHeight, gray);
+}
+
+void WriteFramePng(const std::string& path, const GbLcdPixelMatrix& frame) {
+  OutputBinary(path, EncodeFramePng(frame));
+}
+
+}  // namespace gbemu
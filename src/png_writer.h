@@ -0,0 +1,26 @@
+#ifndef GBEMU_PNG_WRITER_H_
+#define GBEMU_PNG_WRITER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ppu.h"
+
+namespace gbemu {
+
+// 8bitグレースケールの画像をPNGにエンコードする。
+// grayは行優先に並べたwidth*height個の輝度値。
+// 外部ライブラリに依存しないように、圧縮せずにdeflateのstoredブロックで格納する。
+std::vector<std::uint8_t> EncodePng(unsigned width, unsigned height,
+                                    const std::vector<std::uint8_t>& gray);
+
+// 画面をPNGにエンコードする。色はフロントエンドと同じ4階調の灰色にする。
+std::vector<std::uint8_t> EncodeFramePng(const GbLcdPixelMatrix& frame);
+
+// 画面をPNGファイルに書き出す。書き出しに失敗したらプログラムを終了する。
+void WriteFramePng(const std::string& path, const GbLcdPixelMatrix& frame);
+
+}  // namespace gbemu
+
+#endif  // GBEMU_PNG_WRITER_H_
@@ -2,8 +2,11 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <memory>
 #include <vector>
 
+#include "line_renderer.h"
+#include "render_thread.h"
 #include "utils.h"
 
 using namespace gbemu;
@@ -32,7 +35,12 @@ std::uint8_t Ppu::ReadVRam8(std::uint16_t address) const {
 
 void Ppu::WriteVRam8(std::uint16_t address, std::uint8_t value) {
   if (IsVRamAccessible()) {
-    vram_.at(GetVRamAddressOffset(address)) = value;
+    std::uint16_t offset = GetVRamAddressOffset(address);
+    // 値が変わらない書き込みは、キャッシュを無効にしないよう描画側へ渡さない
+    if (vram_.at(offset) != value) {
+      vram_[offset] = value;
+      WriteRendererVRam8(offset, value);
+    }
   }
 }
 
@@ -45,65 +53,79 @@ std::uint8_t Ppu::ReadOam8(std::uint16_t address) const {
 
 void Ppu::WriteOam8(std::uint16_t address, std::uint8_t value) {
   if (IsOamAccessible()) {
-    oam_.at(GetOamAddressOffset(address)) = value;
+    std::uint16_t offset = GetOamAddressOffset(address);
+    if (oam_.at(offset) != value) {
+      oam_[offset] = value;
+      WriteRendererOam8(offset, value);
+    }
   }
 }
 
 void Ppu::WriteOam8WithoutCheck(std::uint16_t address, std::uint8_t value) {
-  oam_.at(GetOamAddressOffset(address)) = value;
+  std::uint16_t offset = GetOamAddressOffset(address);
+  if (oam_.at(offset) != value) {
+    oam_[offset] = value;
+    WriteRendererOam8(offset, value);
+  }
 }
 
-void Ppu::ScanNextOamEntry() {
-  // 描画可能なオブジェクトの最大数に達しているなら何もしない
-  if (scanned_oam_entries_.size() == kMaxNumOfObjectsOnScanline) {
-    return;
+void Ppu::WriteRendererVRam8(std::uint16_t offset, std::uint8_t value) {
+  if (render_thread_ != nullptr) {
+    render_thread_->WriteVRam8(offset, value);
+  } else {
+    renderer_.WriteVRam8(offset, value);
   }
+}
 
-  // OAMからエントリを取得
-  unsigned elapsed_cycles_in_oam_scan =
-      elapsed_cycles_in_frame_ % kScanlineDuration;
-  ASSERT(elapsed_cycles_in_oam_scan < kOamScanDuration,
-         "This function must be called within OAM Scan.");
-  int entry_index = elapsed_cycles_in_oam_scan / 2;
-  OamEntry entry;
-  entry.y_pos = oam_.at(entry_index * 4);
-  entry.x_pos = oam_.at(entry_index * 4 + 1);
-  entry.tile_index = oam_.at(entry_index * 4 + 2);
-  entry.attributes = oam_.at(entry_index * 4 + 3);
-
-  // エントリが表すオブジェクトがスキャンライン上にあるならバッファに追加
-  if (entry.IsOnScanline(ly_, lcdc_.GetObjectSize())) {
-    scanned_oam_entries_.push_back(entry);
+void Ppu::WriteRendererOam8(std::uint16_t offset, std::uint8_t value) {
+  if (render_thread_ != nullptr) {
+    render_thread_->WriteOam8(offset, value);
+  } else {
+    renderer_.WriteOam8(offset, value);
   }
 }
 
-void Ppu::WriteCurrentLineToBuffer() {
-  ColorIdArray<lcd::kWidth> background_color_ids;
-  background_color_ids.fill(-1);
-  if (lcdc_.IsBackgroundEnabled()) {
-    WriteBackgroundOnScanline(background_color_ids);
+void Ppu::set_render_thread_enabled(bool enabled) {
+  if (enabled && render_thread_ == nullptr) {
+    render_thread_ = std::make_unique<RenderThread>(renderer_);
+  } else if (!enabled) {
+    // 破棄するときにキューに残っている描画を終える
+    render_thread_.reset();
   }
+}
 
-  ColorIdArray<lcd::kWidth> window_color_ids;
-  window_color_ids.fill(-1);
-  if (lcdc_.IsWindowEnabled()) {
-    WriteWindowOnScanline(window_color_ids);
+void Ppu::RenderCurrentLine() {
+  if (wy_ == ly_ && wx_ <= 166) {
+    window_rendering_started_ = true;
   }
-
-  ColorIdArray<lcd::kWidth> objects_color_ids;
-  objects_color_ids.fill(-1);
-  std::array<const OamEntry*, lcd::kWidth> oam_entries{};
-  if (lcdc_.IsObjectEnabled()) {
-    WriteObjectsOnScanline(objects_color_ids, oam_entries);
+  bool is_window_on_line = IsWindowOnScanline();
+  if (is_rendering_enabled_ || is_rendering_forced_) {
+    LineRegisters registers{};
+    registers.lcdc = lcdc_.data;
+    registers.scy = scy_;
+    registers.scx = scx_;
+    registers.wy = wy_;
+    registers.wx = wx_;
+    registers.palettes = palettes_;
+    registers.ly = ly_;
+    registers.window_line =
+        static_cast<std::uint8_t>(window_internal_line_counter_);
+    registers.is_window_on_line = is_window_on_line;
+    if (render_thread_ != nullptr) {
+      render_thread_->RenderLine(registers, buffer_[ly_]);
+    } else {
+      renderer_.RenderLine(registers, buffer_[ly_]);
+    }
+  }
+  // Windowの行カウンタは描画した行数で決まるので、描画を省いても同じく進める
+  if (is_window_on_line) {
+    window_internal_line_counter_++;
   }
-
-  MergeLinesOfEachLayer(background_color_ids, window_color_ids,
-                        objects_color_ids, oam_entries, buffer_.at(ly_));
 }
 
 // サイクル数はM-cycle単位（＝4の倍数のT-cycle）でしか渡されず、
-// Step()が返す消費サイクル数は1か2なので、貪欲に消費しても
-// サイクル数が余ることはない。
+// モードやLYが変わる時点はすべて4の倍数のサイクルにあるので、
+// 変わる時点ごとに区切って消費してもサイクル数が余ることはない。
 void Ppu::Run(unsigned tcycle) {
   if (!lcdc_.IsPPUEnabled()) {
     return;
@@ -111,46 +133,48 @@ void Ppu::Run(unsigned tcycle) {
   ASSERT(tcycle % 4 == 0, "T-cycle must be a multiple of 4");
   unsigned left_cycles = tcycle;
   while (left_cycles > 0) {
-    unsigned cycles = Step();
+    unsigned cycles = Step(left_cycles);
     ASSERT(cycles <= left_cycles, "Too many cycles used");
     left_cycles -= cycles;
   }
   ASSERT(left_cycles == 0, "Cycles will never remain");
 }
 
-unsigned Ppu::Step() {
-  unsigned elapsed;
+unsigned Ppu::Step(unsigned max_cycles) {
+  unsigned elapsed_cycles_in_line =
+      elapsed_cycles_in_frame_ % kScanlineDuration;
 
-  // モード固有の処理を行い、消費したサイクル数を求める
+  // 次にモードかLYが変わる時点までのサイクル数を求める
+  unsigned mode_end;
   switch (ppu_mode_) {
     case PpuMode::kOamScan:
-      ScanNextOamEntry();
-      elapsed = 2;
+      mode_end = kOamScanDuration;
+      break;
+    case PpuMode::kDrawingPixels:
+      mode_end = kOamScanDuration + kDrawingPixelsDuration;
       break;
-    case PpuMode::kDrawingPixels: {
-      unsigned elapsed_cycles_in_line =
-          elapsed_cycles_in_frame_ % kScanlineDuration;
+    default:
+      mode_end = kScanlineDuration;
+      break;
+  }
+  unsigned elapsed = std::min(max_cycles, mode_end - elapsed_cycles_in_line);
+
+  // モード固有の処理を行う
+  switch (ppu_mode_) {
+    case PpuMode::kDrawingPixels:
       if (elapsed_cycles_in_line == kOamScanDuration) {
-        if (wy_ == ly_ && wx_ <= 166) {
-          window_rendering_started_ = true;
-        }
-        WriteCurrentLineToBuffer();
-        scanned_oam_entries_.clear();
+        RenderCurrentLine();
       }
-      elapsed = 1;
       break;
-    }
     default:
-      elapsed = 1;
       break;
   }
 
   // サイクルを消費する
   elapsed_cycles_in_frame_ += elapsed;
   elapsed_cycles_in_frame_ %= kFrameDuration;
-
-  unsigned elapsed_cycles_in_line =
-      elapsed_cycles_in_frame_ % kScanlineDuration;
+  elapsed_cycles_in_line =
+      (elapsed_cycles_in_line + elapsed) % kScanlineDuration;
 
   // LYを更新する
   if (elapsed_cycles_in_line == 0) {
@@ -174,6 +198,7 @@ unsigned Ppu::Step() {
   } else if (ly_ == lcd::kHeight && elapsed_cycles_in_line == 0) {
     ppu_mode_ = PpuMode::kVBlank;
     is_buffer_ready_ = true;
+    is_rendering_forced_ = false;
     window_rendering_started_ = false;
     window_internal_line_counter_ = 0;
     mode_changed = true;
@@ -216,218 +241,79 @@ void Ppu::ResetPpuState() {
   elapsed_cycles_in_frame_ = 0;
   is_buffer_ready_ = false;
   stat_interrupt_wire_ = false;
-  scanned_oam_entries_.clear();
   window_internal_line_counter_ = 0;
   window_rendering_started_ = false;
 }
 
-namespace {
-
-// カラーIDとパレットのレジスタの値から表示すべき色を得る（ゲームボーイ用）
-lcd::GbLcdColor GetGbLcdColor(unsigned color_id, std::uint8_t palette_reg) {
-  return static_cast<lcd::GbLcdColor>((palette_reg >> (color_id * 2)) & 0b11);
-}
-
-}  // namespace
-
-const std::uint8_t* Ppu::GetTileFromTileMap(int tile_pos_x, int tile_pos_y,
-                                            TileMapArea area,
-                                            TileDataAddressingMode mode) const {
-  // タイルマップからデータを取得する
-  int tile_map_index = 32 * tile_pos_y + tile_pos_x;
-  std::uint16_t tile_map_base_address = area == TileMapArea::kLowerArea
-                                            ? kLowerTileMapBaseAddress
-                                            : kUpperTileMapBaseAddress;
-  std::uint8_t tile_map_data =
-      vram_.at(GetVRamAddressOffset(tile_map_base_address + tile_map_index));
-
-  // 指定したアドレッシングモードでタイルのアドレスを計算する
-  std::uint16_t tile_data_address;
-  if (mode == TileDataAddressingMode::kLowerBlocksUnsigned) {
-    tile_data_address = kLowerTileBlocksBaseAddress + tile_map_data * 16;
-  } else {
-    int offset = tile_map_data < 128 ? tile_map_data : tile_map_data - 256;
-    tile_data_address = kUpperTileBlocksBaseAddress + offset * 16;
-  }
-
-  // 計算したアドレスにあるタイルへのポインタを返す
-  return &vram_.at(GetVRamAddressOffset(tile_data_address));
-}
-
-Ppu::ColorIdArray<Ppu::kTileSize> Ppu::DecodeTileRow(const std::uint8_t* tile,
-                                                     unsigned row) const {
-  ASSERT(row < 16, "Unexpected argument.");
-  ColorIdArray<kTileSize> result;
-  const std::uint8_t* tile_row = tile + 2 * row;
-  std::uint8_t lower_bits = *tile_row;
-  std::uint8_t upper_bits = *(tile_row + 1);
-  for (int i = 0; i < kTileSize; i++) {
-    unsigned shift_amount = 7 - i;
-    unsigned lower_bit = (lower_bits >> shift_amount) & 1;
-    unsigned upper_bit = (upper_bits >> shift_amount) & 1;
-    unsigned color_id = (upper_bit << 1) | lower_bit;
-    result[i] = color_id;
-  }
-  return result;
-}
-
-void Ppu::MergeLinesOfEachLayer(
-    const ColorIdArray<lcd::kWidth>& background_color_ids,
-    const ColorIdArray<lcd::kWidth>& window_color_ids,
-    const ColorIdArray<lcd::kWidth>& object_color_ids,
-    const std::array<const OamEntry*, lcd::kWidth>& oam_entries,
-    GbLcdPixelRow& merged) {
-  for (int i = 0; i < lcd::kWidth; i++) {
-    lcd::GbLcdColor& dst = merged.at(i);
-    dst = lcd::GbLcdColor::kWhite;
-
-    // Backgroundの描画
-    if (background_color_ids[i] != -1) {
-      dst = GetGbLcdColor(background_color_ids[i], bgp_);
-    }
-
-    // Windowの描画
-    if (window_color_ids[i] != -1) {
-      dst = GetGbLcdColor(window_color_ids[i], bgp_);
-    }
-
-    // Objectの描画
-    if (object_color_ids[i] != -1 && oam_entries[i] != nullptr &&
-        object_color_ids[i] != 0) {
-      const OamEntry& entry = *oam_entries[i];
-      bool is_front = entry.GetPriority() == OamEntry::Priority::kFront;
-      bool background_overlay =
-          background_color_ids[i] != -1 && background_color_ids[i] != 0;
-      bool window_overlay =
-          window_color_ids[i] != -1 && window_color_ids[i] != 0;
-      if (is_front || (!background_overlay && !window_overlay)) {
-        OamEntry::GbPalette palette = entry.GetGbPalette();
-        std::uint8_t obp =
-            palette == OamEntry::GbPalette::kObp0 ? obp0_ : obp1_;
-        dst = GetGbLcdColor(object_color_ids[i], obp);
+void Ppu::SaveState(StateWriter& writer) const {
+  writer.Write(lcdc_.data);
+  writer.Write(stat_.Get());
+  writer.Write(scy_);
+  writer.Write(scx_);
+  writer.Write(ly_);
+  writer.Write(lyc_);
+  writer.Write(bgp_);
+  writer.Write(obp0_);
+  writer.Write(obp1_);
+  writer.Write(wy_);
+  writer.Write(wx_);
+  writer.WriteBytes(vram_.data(), vram_.size());
+  writer.WriteBytes(oam_.data(), oam_.size());
+
+  // 1バイトに4ピクセルずつ詰める
+  for (const GbLcdPixelRow& row : buffer_) {
+    for (int x = 0; x < lcd::kWidth; x += 4) {
+      std::uint8_t packed = 0;
+      for (int i = 0; i < 4; i++) {
+        packed |= static_cast<std::uint8_t>(row[x + i]) << (i * 2);
       }
+      writer.Write(packed);
     }
   }
-}
 
-void Ppu::WriteBackgroundOnScanline(
-    ColorIdArray<lcd::kWidth>& color_ids) const {
-  // スキャンラインと交差するタイルのうち左端のものを取得する
-  int tile_pos_y = ((scy_ + ly_) / kTileSize) % 32;
-  int tile_pos_x = scx_ / kTileSize;
-  int tile_row_offset = (scy_ + ly_) % kTileSize;
-  int tile_col_offset = scx_ % kTileSize;
-  TileMapArea area = lcdc_.GetBackgroundTileMapArea();
-  TileDataAddressingMode mode = lcdc_.GetTileDataAddressingMode();
-  const std::uint8_t* tile =
-      GetTileFromTileMap(tile_pos_x, tile_pos_y, area, mode);
-
-  // 左から右にタイルマップを移動しながら、
-  // スキャンラインと交差するタイルの行を配列に書き込む
-  int pos_in_line = 0;
-  for (int i = 0; i < 21; i++) {
-    int col_start = i == 0 ? tile_col_offset : 0;
-    int col_end = i == 20 ? tile_col_offset : kTileSize;
-    ColorIdArray<kTileSize> tile_row = DecodeTileRow(tile, tile_row_offset);
-    for (int j = col_start; j < col_end; j++) {
-      color_ids.at(pos_in_line++) = tile_row[j];
-    }
-    tile_pos_x = (tile_pos_x + 1) % 32;
-    tile = GetTileFromTileMap(tile_pos_x, tile_pos_y, area, mode);
-  }
-}
+  writer.Write(static_cast<std::uint8_t>(ppu_mode_));
+  writer.Write(static_cast<std::uint32_t>(elapsed_cycles_in_frame_));
+  writer.Write(is_buffer_ready_);
+  writer.Write(stat_interrupt_wire_);
 
-void Ppu::WriteWindowOnScanline(ColorIdArray<lcd::kWidth>& color_ids) {
-  if (!window_rendering_started_) {
-    return;
-  }
-
-  if (wy_ > ly_ || wx_ > 166) {
-    return;
-  }
+  writer.Write(window_rendering_started_);
+  writer.Write(static_cast<std::uint32_t>(window_internal_line_counter_));
+}
 
-  // スキャンラインと交わる左端のタイルを取得する
-  int tile_map_pos_x = 0;
-  int tile_map_pos_y = window_internal_line_counter_ / kTileSize;
-  TileMapArea area = lcdc_.GetWindowTileMapArea();
-  TileDataAddressingMode mode = lcdc_.GetTileDataAddressingMode();
-  const std::uint8_t* tile =
-      GetTileFromTileMap(tile_map_pos_x, tile_map_pos_y, area, mode);
-  int tile_row_offset = window_internal_line_counter_ % kTileSize;
-
-  // 左から右にタイルマップを移動しながら、
-  // スキャンラインと交差するタイルの行を配列に書き込む
-  int pixel_pos_x = wx_ - 7;
-  bool reached_right_boarder = false;
-  while (!reached_right_boarder) {
-    ColorIdArray<kTileSize> tile_row = DecodeTileRow(tile, tile_row_offset);
-    for (int i = 0; i < kTileSize; i++) {
-      if (pixel_pos_x == lcd::kWidth) {
-        reached_right_boarder = true;
-        break;
+void Ppu::LoadState(StateReader& reader) {
+  // バッファや描画側の写しを置き換える前に、古い内容での描画を終えておく
+  FinishRendering();
+  lcdc_.data = reader.Read<std::uint8_t>();
+  stat_.Restore(reader.Read<std::uint8_t>());
+  scy_ = reader.Read<std::uint8_t>();
+  scx_ = reader.Read<std::uint8_t>();
+  ly_ = reader.Read<std::uint8_t>();
+  lyc_ = reader.Read<std::uint8_t>();
+  set_bgp(reader.Read<std::uint8_t>());
+  set_obp0(reader.Read<std::uint8_t>());
+  set_obp1(reader.Read<std::uint8_t>());
+  wy_ = reader.Read<std::uint8_t>();
+  wx_ = reader.Read<std::uint8_t>();
+  reader.ReadBytes(vram_.data(), vram_.size());
+  reader.ReadBytes(oam_.data(), oam_.size());
+  renderer_.LoadMemory(vram_.data(), oam_.data());
+
+  for (GbLcdPixelRow& row : buffer_) {
+    for (int x = 0; x < lcd::kWidth; x += 4) {
+      std::uint8_t packed = reader.Read<std::uint8_t>();
+      for (int i = 0; i < 4; i++) {
+        row[x + i] = static_cast<lcd::GbLcdColor>((packed >> (i * 2)) & 0b11);
       }
-      color_ids.at(pixel_pos_x++) = tile_row[i];
     }
-    tile_map_pos_x++;
-    tile = GetTileFromTileMap(tile_map_pos_x, tile_map_pos_y, area, mode);
   }
 
-  window_internal_line_counter_++;
-}
-
-void Ppu::WriteObjectsOnScanline(
-    ColorIdArray<lcd::kWidth>& color_ids,
-    std::array<const OamEntry*, lcd::kWidth>& oam_entries) {
-  // DMGでは下記のソートを行うのが正しいエミュレーションだが、
-  // 行わない（＝OAMの並び順だけで描画の優先順位を決める）方が
-  // 綺麗に見える気がするのでコメントアウトしておく
-  // ------------------------------------------------
-  // X座標の小さいものを前面に描画するために、X座標の大きいものを先に描画する
-  // std::stable_sort(scanned_oam_entries_.begin(), scanned_oam_entries_.end());
-
-  for (auto i = scanned_oam_entries_.rbegin(), e = scanned_oam_entries_.rend();
-       i != e; i++) {
-    WriteSingleObjectOnScanline(*i, color_ids, oam_entries);
-  }
-}
-
-void Ppu::WriteSingleObjectOnScanline(
-    const OamEntry& entry, ColorIdArray<lcd::kWidth>& color_ids,
-    std::array<const OamEntry*, lcd::kWidth>& oam_entries) const {
-  // 描画すべきタイルの行データを取得
-  int lcd_x = entry.x_pos - 8;
-  int lcd_y = entry.y_pos - 16;
-  int lcd_y_offset = ly_ - lcd_y;
-  int tile_row_offset = entry.IsYFlip()
-                            ? (lcdc_.GetObjectHeight() - 1 - lcd_y_offset)
-                            : lcd_y_offset;
-  int upper_tile_index = lcdc_.GetObjectSize() == ObjectSize::kDouble
-                             ? entry.tile_index & 0xFE
-                             : entry.tile_index;
-  int tile_data_address = upper_tile_index * 16;
-  const std::uint8_t* tile = &vram_.at(tile_data_address);
-  ColorIdArray<kTileSize> tile_row = DecodeTileRow(tile, tile_row_offset);
-
-  // 描画
-  for (int i = 0; i < 8; i++) {
-    // x-flipしているなら右端から、していないなら左端から描画する
-    unsigned color_id = entry.IsXFlip() ? tile_row[7 - i] : tile_row[i];
-
-    // カラーID0は透過
-    if (color_id == 0) {
-      continue;
-    }
-
-    // 座標がLCDの画面内に収まるピクセルだけを描画する
-    int pixel_x = lcd_x + i;
-    if (0 <= pixel_x && pixel_x < lcd::kWidth) {
-      color_ids.at(lcd_x + i) = color_id;
-      oam_entries.at(lcd_x + i) = &entry;
-    }
-  }
-}
+  ppu_mode_ = static_cast<PpuMode>(reader.Read<std::uint8_t>() & 0b11);
+  elapsed_cycles_in_frame_ = reader.Read<std::uint32_t>() % kFrameDuration;
+  is_buffer_ready_ = reader.Read<bool>();
+  stat_interrupt_wire_ = reader.Read<bool>();
 
-bool Ppu::OamEntry::IsOnScanline(std::uint8_t ly, Ppu::ObjectSize size) const {
-  unsigned height = size == ObjectSize::kSingle ? 8 : 16;
-  return (ly + 16 >= y_pos) && (ly + 16 < y_pos + height);
+  window_rendering_started_ = reader.Read<bool>();
+  window_internal_line_counter_ = reader.Read<std::uint32_t>();
+  // 描画済みの行はバッファと一緒に戻るので、残りの行は設定どおりに描画する
+  is_rendering_forced_ = false;
 }
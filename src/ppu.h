@@ -1,36 +1,25 @@
 #ifndef GBEMU_PPU_H_
 #define GBEMU_PPU_H_
 
-#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include "interrupt.h"
+#include "lcd.h"
+#include "line_composite.h"
+#include "line_renderer.h"
+#include "render_thread.h"
+#include "save_state.h"
 #include "utils.h"
 
 namespace gbemu {
 
-namespace lcd {
-
-enum GbLcdColor {
-  kWhite = 0,
-  kLightGray = 1,
-  kDarkGray = 2,
-  kBlack = 3,
-  kColorNum,
-};
-
-constexpr auto kWidth = 160;
-constexpr auto kHeight = 144;
-constexpr auto kTotalPixelNum = kWidth * kHeight;
-
-}  // namespace lcd
-
-using GbLcdPixelRow = std::array<lcd::GbLcdColor, lcd::kWidth>;
-using GbLcdPixelMatrix = std::array<GbLcdPixelRow, lcd::kHeight>;
-
 class Ppu {
  public:
+  using TileCacheStats = LineRenderer::TileCacheStats;
+
   Ppu(Interrupt& interrupt)
       : vram_(kVRamSize), oam_(kOamSize), interrupt_(interrupt) {}
 
@@ -49,15 +38,27 @@ class Ppu {
     if (!was_enabled && lcdc_.IsPPUEnabled()) {
       ppu_mode_ = PpuMode::kOamScan;
       stat_.SetPpuModeBits(ppu_mode_);
+      // このフレームは次のフレーム単位の処理（GameBoy::Step）にまたがって
+      // 完成することがあるので、描画の設定によらず描画しておく
+      is_rendering_forced_ = true;
     }
   }
   void set_stat(std::uint8_t value) { stat_.Set(value); }
   void set_scy(std::uint8_t value) { scy_ = value; }
   void set_scx(std::uint8_t value) { scx_ = value; }
   void set_lyc(std::uint8_t value) { lyc_ = value; }
-  void set_bgp(std::uint8_t value) { bgp_ = value; }
-  void set_obp0(std::uint8_t value) { obp0_ = value; }
-  void set_obp1(std::uint8_t value) { obp1_ = value; }
+  void set_bgp(std::uint8_t value) {
+    bgp_ = value;
+    palettes_.bgp = DecodePalette(value);
+  }
+  void set_obp0(std::uint8_t value) {
+    obp0_ = value;
+    palettes_.obp0 = DecodePalette(value);
+  }
+  void set_obp1(std::uint8_t value) {
+    obp1_ = value;
+    palettes_.obp1 = DecodePalette(value);
+  }
   void set_wy(std::uint8_t value) { wy_ = value; }
   void set_wx(std::uint8_t value) { wx_ = value; }
   std::uint8_t lcdc() const { return lcdc_.data; }
@@ -99,10 +100,42 @@ class Ppu {
   void ResetBufferReadyFlag() { is_buffer_ready_ = false; }
   // バッファを取得する。
   const GbLcdPixelMatrix& GetBuffer() const { return buffer_; }
+  // バッファへ描画するかどうか設定する。
+  // 無効にするとバッファは更新されないが、描画以外の状態は同じように進む。
+  // ただしLCDをオンにして始まったフレームは、設定によらず最後まで描画する。
+  void set_rendering_enabled(bool enabled) { is_rendering_enabled_ = enabled; }
+
+  // ピクセルの生成を別のスレッドで行うかどうか設定する。
+  // 有効にすると、各行の描画はDrawing Pixelsに入った時点のレジスタの値と
+  // VRAM、OAMの内容で別のスレッドが後から行い、バッファはFinishRendering()を
+  // 呼ぶまで完成しない。画面の内容は無効のときと変わらない。
+  void set_render_thread_enabled(bool enabled);
+  // 別のスレッドでの描画が追いつくまで待つ。無効なら何もしない。
+  // バッファやタイルのキャッシュの統計を読む前に呼ぶこと。
+  void FinishRendering() {
+    if (render_thread_ != nullptr) {
+      render_thread_->Sync();
+    }
+  }
+
+  // タイルのキャッシュの統計を取得する。
+  const TileCacheStats& tile_cache_stats() const {
+    return renderer_.tile_cache_stats();
+  }
+  // タイルのキャッシュが使うメモリのバイト数を得る。
+  static std::size_t GetTileCacheSize() {
+    return LineRenderer::GetTileCacheSize();
+  }
+
+  // 状態をセーブステートに書き出す。
+  // バッファは1ピクセル2ビットに詰めて書き出す。
+  void SaveState(StateWriter& writer) const;
+  // セーブステートから状態を復元する。
+  void LoadState(StateReader& reader);
 
  private:
-  static constexpr auto kVRamSize = 8 * 1024;
-  static constexpr auto kOamSize = 160;
+  static constexpr auto kVRamSize = LineRenderer::kVRamSize;
+  static constexpr auto kOamSize = LineRenderer::kOamSize;
 
   // 各モードの長さ（サイクル数）。
   // DrawingPixelsとHBlankの長さは実際には一定ではないが、
@@ -118,38 +151,6 @@ class Ppu {
   // 1フレームの長さ（サイクル数）。
   static constexpr auto kFrameDuration = kScanlineDuration * kScanlineNum;
 
-  // タイルの1辺のピクセル数。
-  static constexpr auto kTileSize = 8;
-
-  // タイルマップのベースアドレス。
-  static constexpr auto kLowerTileMapBaseAddress = 0x9800;
-  static constexpr auto kUpperTileMapBaseAddress = 0x9C00;
-
-  // タイルデータ格納領域のベースアドレス。
-  static constexpr auto kLowerTileBlocksBaseAddress = 0x8000;
-  static constexpr auto kUpperTileBlocksBaseAddress = 0x9000;
-
-  // スキャンライン上に同時に描画可能なオブジェクトの最大数
-  static constexpr auto kMaxNumOfObjectsOnScanline = 10;
-
-  // タイルマップの区画の種別。
-  enum class TileMapArea {
-    kLowerArea,  // $9800-9BFF
-    kUpperArea   // $9C00-9FFF
-  };
-
-  // タイルデータ参照時のアドレッシングモードの種別。
-  enum class TileDataAddressingMode {
-    kUpperBlocksSigned,   // $9000 + signed 8-bit offset
-    kLowerBlocksUnsigned  // $8000 + unsigned 8-bit offset
-  };
-
-  // オブジェクトのサイズの種別。
-  enum class ObjectSize {
-    kSingle,  // 8x8
-    kDouble   // 8x16
-  };
-
   // PPUモードの種別。
   enum class PpuMode {
     kHBlank = 0,
@@ -158,49 +159,16 @@ class Ppu {
     kDrawingPixels = 3
   };
 
-  // LCDCレジスタ
+  // LCDCレジスタのうちタイミングに関わる部分。
+  // 描画に関わる部分はLineRendererが解釈する。
   struct Lcdc {
     std::uint8_t data{};
 
     // PPUが有効化されているか調べる。
     bool IsPPUEnabled() const { return data & (1 << 7); }
 
-    // Windowに使用されるタイルマップの区画の種別を取得する。
-    TileMapArea GetWindowTileMapArea() const {
-      return data & (1 << 6) ? TileMapArea::kUpperArea
-                             : TileMapArea::kLowerArea;
-    }
-
-    // Backgroundに使用されるタイルマップの区画の種別を取得する。
-    TileMapArea GetBackgroundTileMapArea() const {
-      return data & (1 << 3) ? TileMapArea::kUpperArea
-                             : TileMapArea::kLowerArea;
-    }
-
     // Windowレイヤーが描画されるか調べる。
     bool IsWindowEnabled() const { return (data & 1) && (data & (1 << 5)); }
-
-    // Backgroundレイヤーが描画されるか調べる。
-    bool IsBackgroundEnabled() const { return data & 1; }
-
-    // タイルマップからタイルデータを参照する際のアドレッシングモードの種別を取得する。
-    TileDataAddressingMode GetTileDataAddressingMode() const {
-      return (data & (1 << 4)) ? TileDataAddressingMode::kLowerBlocksUnsigned
-                               : TileDataAddressingMode::kUpperBlocksSigned;
-    }
-
-    // オブジェクトのサイズ種別を取得する。
-    ObjectSize GetObjectSize() const {
-      return (data & (1 << 2)) ? ObjectSize::kDouble : ObjectSize::kSingle;
-    }
-
-    // オブジェクトの高さを取得する。
-    unsigned GetObjectHeight() const {
-      return GetObjectSize() == ObjectSize::kDouble ? 2 * kTileSize : kTileSize;
-    }
-
-    // Objectレイヤーが描画されるかどうか調べる。
-    bool IsObjectEnabled() const { return data & (1 << 1); }
   };
 
   // STATレジスタ
@@ -213,6 +181,10 @@ class Ppu {
     // レジスタの値を取得する。
     std::uint8_t Get() const { return data_; }
 
+    // 読み出し専用のビットも含めてレジスタの値をそのまま書き戻す。
+    // セーブステートからの復元にのみ使う。
+    void Restore(std::uint8_t value) { data_ = value; }
+
     // LYC=LYの割り込みが有効かどうか調べる。
     bool IsLycInterruptEnabled() const { return data_ & (1 << 6); }
 
@@ -239,62 +211,35 @@ class Ppu {
     std::uint8_t data_;
   };
 
-  // OAMのエントリ
-  struct OamEntry {
-    std::uint8_t y_pos;
-    std::uint8_t x_pos;
-    std::uint8_t tile_index;
-    std::uint8_t attributes;
+  // 現在の行を描画する。Windowの行カウンタは描画するかどうかに関わらず進める。
+  void RenderCurrentLine();
 
-    // オブジェクト同士の大小比較。X座標の小さい方が小さいとする。
-    // オブジェクト同士の描画の優先順位を決定するために定義する。
-    bool operator<(const OamEntry& rhs) const { return x_pos < rhs.x_pos; }
+  // VRAMとOAMへの書き込みを描画側の写しに反映する。
+  // 別のスレッドで描画しているときは、描画と同じキューに積んで順番を保つ。
+  void WriteRendererVRam8(std::uint16_t offset, std::uint8_t value);
+  void WriteRendererOam8(std::uint16_t offset, std::uint8_t value);
 
-    // 指定のスキャンライン上で描画の対象となるか判定する。
-    bool IsOnScanline(std::uint8_t ly, ObjectSize size) const;
-
-    // Priorityの種別。
-    enum class Priority {
-      kFront,  // Background/Windowより前面に出る
-      kBack    // Background/WindowのColor ID1-3に隠れる
-    };
-
-    // オブジェクトに紐づくパレットの種別。
-    enum class GbPalette { kObp0, kObp1 };
-
-    // attributesの各種情報の取得。
-    Priority GetPriority() const {
-      return (attributes & (1 << 7)) ? Priority::kBack : Priority::kFront;
-    }
-    bool IsYFlip() const { return attributes & (1 << 6); }
-    bool IsXFlip() const { return attributes & (1 << 5); }
-    GbPalette GetGbPalette() const {
-      return (attributes & (1 << 4)) ? GbPalette::kObp1 : GbPalette::kObp0;
-    }
-  };
-
-  // 要素数NのカラーIDの配列。
-  // 要素はカラーIDを表す整数。
-  // ただし-1は透過を表す。
-  template <int N>
-  using ColorIdArray = std::array<int, N>;
-
-  // 次のOAMエントリをスキャンする。
-  void ScanNextOamEntry();
-
-  // 現在の行をバッファに書き込む。
-  void WriteCurrentLineToBuffer();
+  // 現在のスキャンライン上にWindowが描画されるかどうか調べる。
+  bool IsWindowOnScanline() const {
+    return lcdc_.IsWindowEnabled() && window_rendering_started_ &&
+           wy_ <= ly_ && wx_ <= 166;
+  }
 
-  // PPUを最小の処理単位で進め、消費したサイクル数を返す。
-  // 最小の処理単位はPPUのモードごとに以下のように定める。
-  // - OAM Scan: 1つのオブジェクトをスキャンする（2サイクル）
+  // PPUを次にモードかLYが変わる時点まで（ただしmax_cyclesを超えない範囲で）進め、
+  // 消費したサイクル数を返す。モードごとの処理は以下の通り。
+  // - OAM Scan: 何もしない。
+  //             スキャンの結果は描画時にLineRendererが行ごとのオブジェクトの
+  //             集合から引く
   // - Drawing Pixels: このモードに入ると同時に現在の行全体を描画し、
-  //                   後は何もしない（1サイクル）(*)
-  // - HBlank: 何もしない（1サイクル）
-  // - VBlank: 何もしない（1サイクル）
+  //                   後は何もしない (*)
+  // - HBlank: 何もしない
+  // - VBlank: 何もしない
+  // STATと割り込みの条件は進めた後に1回だけ評価する。途中ではモードもLYも
+  // 変わらず、レジスタへの書き込みはRunの呼び出しの間にしか起こらないので、
+  // 1サイクルずつ評価した場合と結果は同じになる。
   // (*) Drawing Pixelsの実際の動作はそうではないが、
   //     実装が大変なので単純化する。
-  unsigned Step();
+  unsigned Step(unsigned max_cycles);
 
   // PPUの状態をリセットする。
   // LCDCでPPUが無効にされたとき呼ばれる。
@@ -311,44 +256,6 @@ class Ppu {
            (ppu_mode_ == PpuMode::kVBlank);
   }
 
-  // タイルマップの指定の位置のタイルへのポインタを返す
-  const std::uint8_t* GetTileFromTileMap(int tile_pos_x, int tile_pos_y,
-                                         TileMapArea area,
-                                         TileDataAddressingMode mode) const;
-
-  // タイルの任意の行をデコードしてカラーIDの配列にする。
-  // 行は0〜15で指定できる。8以上を指定できるのは高さ16のオブジェクトのタイルに対応するため。
-  // 戻り値の配列の0番目がタイルの左端のカラーIDに対応する。
-  ColorIdArray<kTileSize> DecodeTileRow(const std::uint8_t* tile,
-                                        unsigned row) const;
-
-  // スキャンラインに沿ってBackgroundレイヤの各ピクセルのカラーIDを配列に書き出す。
-  void WriteBackgroundOnScanline(ColorIdArray<lcd::kWidth>& color_ids) const;
-
-  // スキャンラインに沿ってWindowレイヤの各ピクセルのカラーIDを配列に書き出す。
-  void WriteWindowOnScanline(ColorIdArray<lcd::kWidth>& color_ids);
-
-  // スキャンラインに沿ってObjectレイヤの各ピクセルのカラーIDとそのピクセルが属する
-  // オブジェクトのOAMエントリを配列に書き出す。
-  // オブジェクトのない部分に対応する配列要素は変化させない。
-  void WriteObjectsOnScanline(
-      ColorIdArray<lcd::kWidth>& color_ids,
-      std::array<const OamEntry*, lcd::kWidth>& oam_entries);
-
-  // WriteObjectsOnCurrentLineのヘルパ。
-  // 1つのOAMエントリに対応するピクセルの情報を配列に書き出す。
-  void WriteSingleObjectOnScanline(
-      const OamEntry& entry, ColorIdArray<lcd::kWidth>& color_ids,
-      std::array<const OamEntry*, lcd::kWidth>& oam_entries) const;
-
-  // スキャンラインに沿って抽出した各レイヤをマージしてLCDの1行として書き出す
-  void MergeLinesOfEachLayer(
-      const ColorIdArray<lcd::kWidth>& background_color_ids,
-      const ColorIdArray<lcd::kWidth>& window_color_ids,
-      const ColorIdArray<lcd::kWidth>& object_color_ids,
-      const std::array<const OamEntry*, lcd::kWidth>& oam_entries,
-      GbLcdPixelRow& merged);
-
   Lcdc lcdc_{};
   Stat stat_{};
   std::uint8_t scy_{};
@@ -358,6 +265,9 @@ class Ppu {
   std::uint8_t bgp_{};
   std::uint8_t obp0_{};
   std::uint8_t obp1_{};
+  // BGP、OBP0、OBP1を書き込まれたときに変換した表。
+  // レジスタの値から作り直せるのでセーブステートには含めない。
+  LinePalettes palettes_{};
   std::uint8_t wy_{};
   std::uint8_t wx_{};
   std::vector<std::uint8_t> vram_;
@@ -379,15 +289,25 @@ class Ppu {
   // high(true)になったときセットされる。
   bool stat_interrupt_wire_{false};
 
-  // OAM Scanで使用するバッファ。
-  // 現在のスキャンライン上で描画の対象となるオブジェクトをX座標の小さい順に格納する。
-  std::vector<OamEntry> scanned_oam_entries_{};
-
   // Windowの描画開始フラグ。
   bool window_rendering_started_{false};
   // Windowの行カウンタ。
   // Windowの描画開始後、1行描画するごとにインクリメントする。
   unsigned window_internal_line_counter_{};
+
+  // バッファへ描画するかどうか。エミュレーションの状態ではないので
+  // セーブステートには含めない。
+  bool is_rendering_enabled_{true};
+  // LCDをオンにして始まったフレームを描画中かどうか。
+  // 描画の設定によらず、VBlankに入るまで描画する。
+  bool is_rendering_forced_{false};
+
+  // ピクセルの生成を受け持つ。VRAMとOAMの写しとタイルのキャッシュを持つが、
+  // VRAMとOAMから作り直せるのでセーブステートには含めない。
+  LineRenderer renderer_;
+  // 別のスレッドで描画するときのスレッド。nullptrなら同じスレッドで描画する。
+  // renderer_とbuffer_を使うので、それらより後に宣言して先に破棄する。
+  std::unique_ptr<RenderThread> render_thread_;
 };
 
 }  // namespace gbemu
@@ -0,0 +1,118 @@
+#include "render_thread.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "lcd.h"
+#include "line_renderer.h"
+#include "utils.h"
+
+namespace gbemu {
+
+RenderThread::RenderThread(LineRenderer& renderer)
+    : renderer_(renderer), worker_([this] { WorkerLoop(); }) {}
+
+RenderThread::~RenderThread() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  work_available_.notify_one();
+  worker_.join();
+}
+
+void RenderThread::WriteVRam8(std::uint16_t offset, std::uint8_t value) {
+  Command command;
+  command.type = Command::kWriteVRam;
+  command.offset = offset;
+  command.value = value;
+  Push(command);
+}
+
+void RenderThread::WriteOam8(std::uint16_t offset, std::uint8_t value) {
+  Command command;
+  command.type = Command::kWriteOam;
+  command.offset = offset;
+  command.value = value;
+  Push(command);
+}
+
+void RenderThread::RenderLine(const LineRegisters& registers,
+                              GbLcdPixelRow& row) {
+  Command command;
+  command.type = Command::kRenderLine;
+  command.registers = registers;
+  command.row = &row;
+  Push(command);
+  Wake();
+}
+
+void RenderThread::Sync() {
+  Wake();
+  std::unique_lock<std::mutex> lock(mutex_);
+  all_done_.wait(lock, [this] {
+    return read_index_.load(std::memory_order_acquire) ==
+           write_index_.load(std::memory_order_relaxed);
+  });
+}
+
+void RenderThread::Push(const Command& command) {
+  std::size_t index = write_index_.load(std::memory_order_relaxed);
+  // 一杯なら描画のスレッドを起こして空くのを待つ
+  while (index - read_index_.load(std::memory_order_acquire) == kQueueSize) {
+    Wake();
+    std::this_thread::yield();
+  }
+  queue_[index % kQueueSize] = command;
+  write_index_.store(index + 1, std::memory_order_release);
+}
+
+void RenderThread::Wake() {
+  // 描画のスレッドは条件をmutex_の下で確かめてから眠るので、
+  // 一度mutex_を取ってから通知すれば通知を取りこぼさない
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  work_available_.notify_one();
+}
+
+void RenderThread::WorkerLoop() {
+  while (true) {
+    std::size_t begin = read_index_.load(std::memory_order_relaxed);
+    std::size_t end = write_index_.load(std::memory_order_acquire);
+    if (begin == end) {
+      // キューが空になったらSyncに知らせ、次の処理か終了要求まで眠る
+      std::unique_lock<std::mutex> lock(mutex_);
+      all_done_.notify_all();
+      work_available_.wait(lock, [this, begin] {
+        return is_stopping_ ||
+               write_index_.load(std::memory_order_acquire) != begin;
+      });
+      if (write_index_.load(std::memory_order_acquire) == begin) {
+        return;
+      }
+      continue;
+    }
+
+    for (std::size_t i = begin; i != end; i++) {
+      const Command& command = queue_[i % kQueueSize];
+      switch (command.type) {
+        case Command::kWriteVRam:
+          renderer_.WriteVRam8(command.offset, command.value);
+          break;
+        case Command::kWriteOam:
+          renderer_.WriteOam8(command.offset, command.value);
+          break;
+        case Command::kRenderLine:
+          renderer_.RenderLine(command.registers, *command.row);
+          break;
+        default:
+          UNREACHABLE("Invalid render command.");
+      }
+    }
+    read_index_.store(end, std::memory_order_release);
+  }
+}
+
+}  // namespace gbemu
@@ -0,0 +1,94 @@
+#ifndef GBEMU_RENDER_THREAD_H_
+#define GBEMU_RENDER_THREAD_H_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "lcd.h"
+#include "line_renderer.h"
+
+namespace gbemu {
+
+// LineRendererを専用のスレッドで動かし、CPUのエミュレーションと描画を
+// 並行させる。
+// エミュレーションのスレッドはVRAMとOAMへの書き込みと、Drawing Pixelsに入った
+// 時点のレジスタの値を順番にキューへ積むだけで、描画の完了を待たずに先へ進む。
+// 描画のスレッドはキューを積んだ順に処理するので、各行を描画する時点の
+// VRAMとOAMの写しはエミュレーションのスレッドでその行に入った時点と同じになり、
+// 同じスレッドで描画した場合と同じ画面になる。
+// キューは積む側と取り出す側が1つずつのリングバッファで、
+// 書き込みは行の描画か同期を積むまでまとめて処理させる。
+// Example:
+//   RenderThread thread(renderer);
+//   thread.WriteVRam8(offset, value);
+//   thread.RenderLine(registers, buffer[ly]);
+//   thread.Sync();  // ここでbufferの描画が終わっている
+class RenderThread {
+ public:
+  // rendererは破棄するまでこのスレッドだけが使う。
+  explicit RenderThread(LineRenderer& renderer);
+  // キューに残っている処理を終えてからスレッドを止める。
+  ~RenderThread();
+
+  RenderThread(const RenderThread&) = delete;
+  RenderThread& operator=(const RenderThread&) = delete;
+
+  // VRAMへの書き込みを積む。
+  void WriteVRam8(std::uint16_t offset, std::uint8_t value);
+  // OAMへの書き込みを積む。
+  void WriteOam8(std::uint16_t offset, std::uint8_t value);
+  // 1行の描画を積む。rowはSync()まで他から触ってはいけない。
+  void RenderLine(const LineRegisters& registers, GbLcdPixelRow& row);
+
+  // 積んだ処理がすべて終わるまで待つ。
+  // 戻った後はLineRendererや描画先の行を呼び出し側のスレッドから触ってよい。
+  void Sync();
+
+ private:
+  // キューの要素。
+  struct Command {
+    enum Type : std::uint8_t { kWriteVRam, kWriteOam, kRenderLine };
+    Type type;
+    std::uint8_t value;
+    std::uint16_t offset;
+    LineRegisters registers;
+    GbLcdPixelRow* row;
+  };
+
+  // キューの要素数。2のべき乗にする。
+  // 1フレームの間にVRAM全体を書き換えても溢れにくい大きさにしておく。
+  static constexpr std::size_t kQueueSize = 16384;
+
+  // キューに積む。キューが一杯なら空くまで待つ。
+  void Push(const Command& command);
+  // 描画のスレッドを起こす。
+  void Wake();
+  // 描画のスレッドの処理。
+  void WorkerLoop();
+
+  LineRenderer& renderer_;
+
+  std::array<Command, kQueueSize> queue_;
+  // 積んだ要素と取り出した要素の通し番号。積む側と取り出す側で
+  // キャッシュラインを共有しないように離して置く。
+  alignas(64) std::atomic<std::size_t> write_index_{0};
+  alignas(64) std::atomic<std::size_t> read_index_{0};
+
+  std::mutex mutex_;
+  bool is_stopping_{false};
+  // 処理を積んだことを描画のスレッドに通知する。
+  std::condition_variable work_available_;
+  // キューが空になったことをSyncに通知する。
+  std::condition_variable all_done_;
+
+  std::thread worker_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_RENDER_THREAD_H_
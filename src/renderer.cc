@@ -3,32 +3,16 @@
 #include <SDL.h>
 
 #include <array>
-#include <utility>
+#include <cstdint>
 
+#include "dmg_palette.h"
+#include "lcd.h"
 #include "utils.h"
 
 using namespace gbemu;
 
-namespace {
-
-SDL_Color LcdColorToSdlColor(lcd::GbLcdColor color) {
-  switch (color) {
-    case lcd::kWhite:
-      return {232, 232, 232, 255};
-    case lcd::kLightGray:
-      return {160, 160, 160, 255};
-    case lcd::kDarkGray:
-      return {88, 88, 88, 255};
-    case lcd::kBlack:
-      return {16, 16, 16, 255};
-    default:
-      UNREACHABLE("Invalid LCD Color: %d", color);
-  }
-}
-
-};  // namespace
-
-Renderer::Renderer(int screen_scale)
+Renderer::Renderer(int screen_scale, const DmgPalette& palette,
+                   bool vsync_allowed)
     : screen_scale_(screen_scale <= 0 ? 1 : screen_scale), vsync_(false) {
   int screen_width = lcd::kWidth * screen_scale_;
   int screen_height = lcd::kHeight * screen_scale_;
@@ -43,8 +27,9 @@ Renderer::Renderer(int screen_scale)
   int disp = SDL_GetWindowDisplayIndex(window_);
   SDL_DisplayMode mode;
   SDL_GetCurrentDisplayMode(disp, &mode);
+  refresh_rate_ = mode.refresh_rate;
   Uint32 renderer_flags = SDL_RENDERER_ACCELERATED;
-  if (mode.refresh_rate == 60) {
+  if (vsync_allowed && mode.refresh_rate == 60) {
     renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
     vsync_ = true;
   }
@@ -68,27 +53,46 @@ Renderer::Renderer(int screen_scale)
     Error("Not supported scaling rate");
   }
   pixel_size_ = drawable_width / lcd::kWidth;
+
+  // LCDの1ピクセルをテクスチャの1ピクセルとし、転送時に拡大する。
+  // 拡大は最近傍補間（SDLの既定）で行うので、ピクセルの境界はぼやけない。
+  texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+                               SDL_TEXTUREACCESS_STREAMING, lcd::kWidth,
+                               lcd::kHeight);
+  if (texture_ == nullptr) {
+    Error("SDL_CreateTexture Error: %s", SDL_GetError());
+  }
+
+  // 4階調の色はフレームごとに変わらないので、先にピクセルの値にしておく
+  for (int i = 0; i < lcd::kColorNum; i++) {
+    argb_colors_[i] = 0xFF000000 | palette.colors[i];
+  }
 }
 
 Renderer::~Renderer() {
+  SDL_DestroyTexture(texture_);
   SDL_DestroyRenderer(renderer_);
   SDL_DestroyWindow(window_);
 }
 
 void Renderer::Render(const GbLcdPixelMatrix& buffer) const {
-  SDL_SetRenderDrawColor(renderer_, 0xFF, 0xFF, 0xFF, 0xFF);
-  SDL_RenderClear(renderer_);
-  for (int i = 0; i < lcd::kHeight; i++) {
-    for (int j = 0; j < lcd::kWidth; j++) {
-      SDL_Color color = LcdColorToSdlColor(buffer[i][j]);
-      SDL_Rect rect;
-      rect.x = j * pixel_size_;
-      rect.y = i * pixel_size_;
-      rect.w = pixel_size_;
-      rect.h = pixel_size_;
-      SDL_SetRenderDrawColor(renderer_, color.r, color.g, color.b, color.a);
-      SDL_RenderFillRect(renderer_, &rect);
+  void* pixels;
+  int pitch;
+  if (SDL_LockTexture(texture_, nullptr, &pixels, &pitch) != 0) {
+    Error("SDL_LockTexture Error: %s", SDL_GetError());
+  }
+  // LCDの色を表で引いて、テクスチャに1回の走査で書き込む
+  for (int y = 0; y < lcd::kHeight; y++) {
+    auto* row = reinterpret_cast<std::uint32_t*>(static_cast<char*>(pixels) +
+                                                 y * pitch);
+    for (int x = 0; x < lcd::kWidth; x++) {
+      row[x] = argb_colors_[buffer[y][x]];
     }
   }
+  SDL_UnlockTexture(texture_);
+
+  SDL_Rect rect{0, 0, lcd::kWidth * pixel_size_, lcd::kHeight * pixel_size_};
+  SDL_RenderClear(renderer_);
+  SDL_RenderCopy(renderer_, texture_, nullptr, &rect);
   SDL_RenderPresent(renderer_);
 }
@@ -4,28 +4,40 @@
 #include <SDL.h>
 
 #include <array>
+#include <cstdint>
 
-#include "ppu.h"
+#include "dmg_palette.h"
+#include "lcd.h"
 
 namespace gbemu {
 
 // ゲームボーイの画面を描画するクラス。
 // 160x144（HiDPIの場合は擬似解像度換算）の整数倍のサイズのウインドウに描画する。
-// 倍率はコンストラクタで指定する。
+// 倍率と4階調の色はコンストラクタで指定する。
+// vsync_allowedがtrueでディスプレイのリフレッシュレートが60Hzなら垂直同期を使う。
+// 画面は160x144のテクスチャに書き込んでから、ウインドウに拡大して転送する。
 class Renderer {
  public:
-  Renderer(int screen_scale = 1);
+  Renderer(int screen_scale = 1,
+           const DmgPalette& palette = kDefaultDmgPalette,
+           bool vsync_allowed = true);
   ~Renderer();
   void Render(const GbLcdPixelMatrix& pixels) const;
   bool vsync() { return vsync_; }
+  // ディスプレイのリフレッシュレート（Hz）。分からなければ0。
+  int refresh_rate() { return refresh_rate_; }
 
  private:
   int screen_scale_;  // ウインドウのサイズの拡大率
   int pixel_size_;  // ゲームボーイのLCDの1ピクセルを、1辺何ピクセルの正方形で表現するか
                     // このピクセル数はHiDPIかどうかに関係なくディスプレイの実際のピクセル数を指す
   bool vsync_;      // 垂直同期
+  int refresh_rate_;
   SDL_Window* window_;
   SDL_Renderer* renderer_;
+  SDL_Texture* texture_;
+  // LCDの色からテクスチャのピクセル（ARGB8888）への変換表
+  std::array<std::uint32_t, lcd::kColorNum> argb_colors_;
 };
 
 }  // namespace gbemu
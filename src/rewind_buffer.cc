@@ -0,0 +1,134 @@
+#include "rewind_buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "gameboy.h"
+#include "utils.h"
+#include "xor_delta.h"
+
+namespace gbemu {
+
+RewindBuffer::RewindBuffer(const Config& config) : config_(config) {
+  ASSERT(config_.interval > 0, "interval must be positive.");
+  ASSERT(config_.keyframe_interval > 0, "keyframe_interval must be positive.");
+}
+
+void RewindBuffer::Push(const GameBoy& gb) {
+  is_at_latest_ = false;
+  if (--frames_until_snapshot_ != 0) {
+    return;
+  }
+  frames_until_snapshot_ = config_.interval;
+
+  gb.SaveState(state_);
+  const Snapshot* keyframe = GetLatestKeyframe();
+  // 作業領域で符号化してから必要な大きさだけ確保してコピーする
+  Snapshot snapshot;
+  if (keyframe == nullptr ||
+      deltas_since_keyframe_ + 1 >= config_.keyframe_interval ||
+      keyframe->data.size() != state_.size()) {
+    snapshot.data.assign(state_.begin(), state_.end());
+    snapshot.is_keyframe = true;
+    deltas_since_keyframe_ = 0;
+  } else {
+    EncodeXorDelta(state_.data(), keyframe->data.data(), state_.size(),
+                   delta_);
+    snapshot.data.assign(delta_.begin(), delta_.end());
+    snapshot.is_keyframe = false;
+    deltas_since_keyframe_++;
+  }
+  memory_usage_ += snapshot.data.size();
+  snapshots_.push_back(std::move(snapshot));
+  is_at_latest_ = true;
+
+  EvictOldest();
+}
+
+bool RewindBuffer::Rewind(GameBoy& gb) {
+  // 現在の状態が最新のスナップショットそのものなら、その1つ前に戻る
+  if (is_at_latest_) {
+    if (snapshots_.size() < 2) {
+      return false;
+    }
+    DropNewest();
+  }
+  if (snapshots_.empty()) {
+    return false;
+  }
+
+  Decode(snapshots_.size() - 1, state_);
+  bool loaded = gb.LoadState(state_);
+  ASSERT(loaded, "Failed to load a rewind snapshot.");
+  is_at_latest_ = true;
+  frames_until_snapshot_ = config_.interval;
+  return true;
+}
+
+void RewindBuffer::Clear() {
+  while (!snapshots_.empty()) {
+    DropNewest();
+  }
+  frames_until_snapshot_ = 1;
+  is_at_latest_ = false;
+}
+
+const RewindBuffer::Snapshot* RewindBuffer::GetLatestKeyframe() const {
+  for (auto i = snapshots_.rbegin(), e = snapshots_.rend(); i != e; i++) {
+    if (i->is_keyframe) {
+      return &*i;
+    }
+  }
+  return nullptr;
+}
+
+void RewindBuffer::Decode(std::size_t index,
+                          std::vector<std::uint8_t>& state) const {
+  std::size_t keyframe_index = index;
+  while (!snapshots_[keyframe_index].is_keyframe) {
+    ASSERT(keyframe_index > 0, "Rewind snapshot has no keyframe.");
+    keyframe_index--;
+  }
+  const std::vector<std::uint8_t>& keyframe = snapshots_[keyframe_index].data;
+  state.assign(keyframe.begin(), keyframe.end());
+  if (keyframe_index != index) {
+    const std::vector<std::uint8_t>& delta = snapshots_[index].data;
+    bool ok =
+        ApplyXorDelta(delta.data(), delta.size(), state.data(), state.size());
+    ASSERT(ok, "Corrupted rewind snapshot.");
+  }
+}
+
+void RewindBuffer::DropNewest() {
+  memory_usage_ -= snapshots_.back().data.size();
+  snapshots_.pop_back();
+
+  // 次に記録する差分の基準となるキーフレームまでの数を数え直す
+  deltas_since_keyframe_ = 0;
+  for (auto i = snapshots_.rbegin(), e = snapshots_.rend();
+       i != e && !i->is_keyframe; i++) {
+    deltas_since_keyframe_++;
+  }
+}
+
+void RewindBuffer::EvictOldest() {
+  while (memory_usage_ > config_.memory_budget) {
+    // 最新のスナップショットが依存するキーフレームは捨てない
+    std::size_t group_end = 1;
+    while (group_end < snapshots_.size() &&
+           !snapshots_[group_end].is_keyframe) {
+      group_end++;
+    }
+    if (group_end == snapshots_.size()) {
+      return;
+    }
+    for (std::size_t i = 0; i < group_end; i++) {
+      memory_usage_ -= snapshots_.front().data.size();
+      snapshots_.pop_front();
+    }
+  }
+}
+
+}  // namespace gbemu
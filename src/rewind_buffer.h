@@ -0,0 +1,95 @@
+#ifndef GBEMU_REWIND_BUFFER_H_
+#define GBEMU_REWIND_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "gameboy.h"
+
+namespace gbemu {
+
+// 巻き戻しのためにセーブステートを一定のメモリ量の範囲で記録するクラス。
+// 数回に1回はセーブステートをそのまま記録し（キーフレーム）、
+// それ以外は直前のキーフレームとのXORをとってゼロの連続を詰めた差分として記録する。
+// 1フレームで変化するメモリはわずかなので、差分はほとんどゼロになる。
+// 上限を超えたら古いキーフレームから順に、それに依存する差分ごと捨てる。
+// Example:
+//   RewindBuffer rewind(RewindBuffer::Config{});
+//   for (;;) {
+//     if (is_rewinding) {
+//       rewind.Rewind(gb);
+//     } else {
+//       gb.Step();
+//       rewind.Push(gb);
+//     }
+//   }
+class RewindBuffer {
+ public:
+  struct Config {
+    // スナップショットを記録する間隔（フレーム数）
+    unsigned interval{1};
+    // キーフレームを記録する間隔（スナップショット数）
+    unsigned keyframe_interval{60};
+    // 記録するスナップショットの合計サイズの上限（バイト数）
+    std::size_t memory_budget{32 * 1024 * 1024};
+  };
+
+  explicit RewindBuffer(const Config& config);
+
+  // 1フレーム進めるごとに呼ぶ。interval回に1回スナップショットを記録する。
+  void Push(const GameBoy& gb);
+
+  // 1つ前のスナップショットの状態に戻す。
+  // 現在の状態より前のスナップショットがなければ何もせずにfalseを返す。
+  bool Rewind(GameBoy& gb);
+
+  // 記録をすべて捨てる。
+  void Clear();
+
+  // 記録しているスナップショットの数。
+  std::size_t num_snapshots() const { return snapshots_.size(); }
+
+  // 記録しているスナップショットの合計サイズ（バイト数）。
+  std::size_t memory_usage() const { return memory_usage_; }
+
+ private:
+  struct Snapshot {
+    // キーフレームならセーブステートそのもの、そうでなければ差分
+    std::vector<std::uint8_t> data;
+    bool is_keyframe;
+  };
+
+  // 最新のスナップショットが依存するキーフレームを得る。
+  // スナップショットがなければnullptrを返す。
+  const Snapshot* GetLatestKeyframe() const;
+
+  // スナップショットをセーブステートに戻す。
+  void Decode(std::size_t index, std::vector<std::uint8_t>& state) const;
+
+  // 最新のスナップショットを捨てる。
+  void DropNewest();
+
+  // 上限を超えている間、最も古いキーフレームとそれに依存する差分を捨てる。
+  void EvictOldest();
+
+  Config config_;
+  std::deque<Snapshot> snapshots_;
+  std::size_t memory_usage_{0};
+
+  // 最後のキーフレームの後に記録した差分の数
+  unsigned deltas_since_keyframe_{0};
+  // 次のスナップショットまでの残りフレーム数
+  unsigned frames_until_snapshot_{1};
+  // 現在の状態が最新のスナップショットと一致しているかどうか
+  bool is_at_latest_{false};
+
+  // セーブステートと差分の作業領域
+  std::vector<std::uint8_t> state_;
+  std::vector<std::uint8_t> delta_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_REWIND_BUFFER_H_
@@ -0,0 +1,255 @@
+#include "rom_builder.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "cartridge_header.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+constexpr std::size_t kBankSize = 0x4000;
+constexpr std::uint16_t kEntryPoint = 0x100;
+constexpr std::uint16_t kCodeStart = 0x150;
+
+// ヘッダに置くロゴ。ブートROMがこれを検証する。
+constexpr std::uint8_t kLogo[] = {
+    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83,
+    0x00, 0x0C, 0x00, 0x0D, 0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E,
+    0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99, 0xBB, 0xBB, 0x67, 0x63,
+    0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E};
+
+std::uint8_t GetCartridgeTypeCode(CartridgeType type) {
+  switch (type) {
+    case CartridgeType::kRomOnly:
+      return 0x00;
+    case CartridgeType::kMbc1:
+      return 0x01;
+    default:
+      UNREACHABLE("Unsupported cartridge type.");
+  }
+}
+
+unsigned ToIndex(Reg8 reg) { return static_cast<unsigned>(reg); }
+unsigned ToIndex(Reg16 reg) { return static_cast<unsigned>(reg); }
+
+}  // namespace
+
+RomBuilder::RomBuilder(const std::string& title, CartridgeType type,
+                       unsigned num_banks)
+    : rom_(num_banks * kBankSize, 0xFF),
+      title_(title),
+      type_(type),
+      offset_(0),
+      bank_(0) {
+  ASSERT(num_banks >= 2 && (num_banks & (num_banks - 1)) == 0,
+         "Invalid number of ROM banks: %u", num_banks);
+  ASSERT(type == CartridgeType::kMbc1 || num_banks == 2,
+         "ROM Only cartridge must have 2 banks.");
+  ASSERT(title.size() <= 15, "Title is too long: %s", title.c_str());
+  GetCartridgeTypeCode(type);  // 対応していない種別はここで落とす
+
+  offset_ = kEntryPoint;
+  Nop();
+  Db({0xC3, kCodeStart & 0xFF, kCodeStart >> 8});  // jp $0150
+  offset_ = kCodeStart;
+}
+
+void RomBuilder::SetBank(unsigned bank) {
+  ASSERT(bank * kBankSize < rom_.size(), "Invalid ROM bank: %u", bank);
+  bank_ = bank;
+  offset_ = bank == 0 ? kCodeStart : bank * kBankSize;
+}
+
+void RomBuilder::SetVectorAddress(std::uint16_t address) {
+  ASSERT(address < kEntryPoint, "Invalid vector address: 0x%04X", address);
+  bank_ = 0;
+  offset_ = address;
+}
+
+std::uint16_t RomBuilder::address() const {
+  return (offset_ % kBankSize) + (bank_ == 0 ? 0 : kBankSize);
+}
+
+RomBuilder::Label RomBuilder::NewLabel() {
+  labels_.push_back(-1);
+  return Label{static_cast<unsigned>(labels_.size() - 1)};
+}
+
+void RomBuilder::Bind(Label label) {
+  ASSERT(labels_.at(label.id) == -1, "Label is bound twice.");
+  labels_[label.id] = address();
+}
+
+void RomBuilder::Db(std::initializer_list<std::uint8_t> bytes) {
+  for (std::uint8_t byte : bytes) {
+    ASSERT(offset_ < (bank_ + 1) * kBankSize, "ROM bank %u overflowed.",
+           bank_);
+    rom_[offset_++] = byte;
+  }
+}
+
+void RomBuilder::Db(const std::vector<std::uint8_t>& bytes) {
+  for (std::uint8_t byte : bytes) {
+    Db({byte});
+  }
+}
+
+void RomBuilder::Ld(Reg8 dst, Reg8 src) {
+  ASSERT(dst != Reg8::kHlIndirect || src != Reg8::kHlIndirect,
+         "ld (hl),(hl) is halt.");
+  Db({static_cast<std::uint8_t>(0x40 + ToIndex(dst) * 8 + ToIndex(src))});
+}
+
+void RomBuilder::Ld(Reg8 dst, std::uint8_t value) {
+  Db({static_cast<std::uint8_t>(0x06 + ToIndex(dst) * 8), value});
+}
+
+void RomBuilder::Ld(Reg16 dst, std::uint16_t value) {
+  Db({static_cast<std::uint8_t>(0x01 + ToIndex(dst) * 16),
+      static_cast<std::uint8_t>(value & 0xFF),
+      static_cast<std::uint8_t>(value >> 8)});
+}
+
+void RomBuilder::StoreA(Reg16 address) {
+  ASSERT(address == Reg16::kBc || address == Reg16::kDe,
+         "Only (bc) and (de) are supported.");
+  Db({static_cast<std::uint8_t>(0x02 + ToIndex(address) * 16)});
+}
+
+void RomBuilder::LoadA(Reg16 address) {
+  ASSERT(address == Reg16::kBc || address == Reg16::kDe,
+         "Only (bc) and (de) are supported.");
+  Db({static_cast<std::uint8_t>(0x0A + ToIndex(address) * 16)});
+}
+
+void RomBuilder::StoreA(std::uint16_t address) {
+  Db({0xEA, static_cast<std::uint8_t>(address & 0xFF),
+      static_cast<std::uint8_t>(address >> 8)});
+}
+
+void RomBuilder::LoadA(std::uint16_t address) {
+  Db({0xFA, static_cast<std::uint8_t>(address & 0xFF),
+      static_cast<std::uint8_t>(address >> 8)});
+}
+
+void RomBuilder::WriteIo(std::uint8_t port, std::uint8_t value) {
+  Ld(Reg8::kA, value);
+  Ldh(port);
+}
+
+void RomBuilder::Alu(AluOp op, Reg8 src) {
+  Db({static_cast<std::uint8_t>(0x80 + static_cast<unsigned>(op) * 8 +
+                                ToIndex(src))});
+}
+
+void RomBuilder::Alu(AluOp op, std::uint8_t value) {
+  Db({static_cast<std::uint8_t>(0xC6 + static_cast<unsigned>(op) * 8), value});
+}
+
+void RomBuilder::Inc(Reg8 reg) {
+  Db({static_cast<std::uint8_t>(0x04 + ToIndex(reg) * 8)});
+}
+
+void RomBuilder::Dec(Reg8 reg) {
+  Db({static_cast<std::uint8_t>(0x05 + ToIndex(reg) * 8)});
+}
+
+void RomBuilder::Inc(Reg16 reg) {
+  Db({static_cast<std::uint8_t>(0x03 + ToIndex(reg) * 16)});
+}
+
+void RomBuilder::Dec(Reg16 reg) {
+  Db({static_cast<std::uint8_t>(0x0B + ToIndex(reg) * 16)});
+}
+
+void RomBuilder::Swap(Reg8 reg) {
+  Db({0xCB, static_cast<std::uint8_t>(0x30 + ToIndex(reg))});
+}
+
+void RomBuilder::Jr(Label target) { EmitBranch(0x18, target, true); }
+
+void RomBuilder::Jr(Condition condition, Label target) {
+  EmitBranch(0x20 + static_cast<unsigned>(condition) * 8, target, true);
+}
+
+void RomBuilder::Jp(Label target) { EmitBranch(0xC3, target, false); }
+
+void RomBuilder::Jp(Condition condition, Label target) {
+  EmitBranch(0xC2 + static_cast<unsigned>(condition) * 8, target, false);
+}
+
+void RomBuilder::Call(Label target) { EmitBranch(0xCD, target, false); }
+
+void RomBuilder::EmitBranch(std::uint8_t opcode, Label target,
+                            bool is_relative) {
+  ASSERT(target.id < labels_.size(), "Invalid label.");
+  Db({opcode});
+  std::size_t offset = offset_;
+  // 分岐先は後で書き込む
+  if (is_relative) {
+    Db({0x00});
+  } else {
+    Db({0x00, 0x00});
+  }
+  fixups_.push_back(Fixup{offset, target, is_relative, address()});
+}
+
+std::vector<std::uint8_t> RomBuilder::Build() {
+  for (const Fixup& fixup : fixups_) {
+    int target = labels_[fixup.label.id];
+    if (target == -1) {
+      Error("Branch to an unbound label.");
+    }
+    if (fixup.is_relative) {
+      int displacement = target - fixup.next_address;
+      if (displacement < -128 || 127 < displacement) {
+        Error("Relative branch is too far: %d", displacement);
+      }
+      rom_[fixup.offset] = static_cast<std::uint8_t>(displacement);
+    } else {
+      rom_[fixup.offset] = target & 0xFF;
+      rom_[fixup.offset + 1] = target >> 8;
+    }
+  }
+
+  // ヘッダ
+  std::copy(std::begin(kLogo), std::end(kLogo), rom_.begin() + 0x104);
+  std::fill(rom_.begin() + 0x134, rom_.begin() + 0x144, 0x00);
+  std::copy(title_.begin(), title_.end(), rom_.begin() + 0x134);
+  std::fill(rom_.begin() + 0x144, rom_.begin() + 0x14D, 0x00);
+  rom_[0x147] = GetCartridgeTypeCode(type_);
+  unsigned size_code = 0;
+  while ((std::size_t{32 * 1024} << size_code) < rom_.size()) {
+    size_code++;
+  }
+  rom_[0x148] = size_code;
+  rom_[0x149] = 0x00;  // RAMなし
+  rom_[0x14A] = 0x01;  // 海外向け
+
+  // ヘッダのチェックサム
+  std::uint8_t header_checksum = 0;
+  for (std::size_t i = 0x134; i < 0x14D; i++) {
+    header_checksum = header_checksum - rom_[i] - 1;
+  }
+  rom_[0x14D] = header_checksum;
+
+  // ROM全体のチェックサム（$014E-$014Fを除く全バイトの和）
+  std::uint16_t global_checksum = 0;
+  for (std::size_t i = 0; i < rom_.size(); i++) {
+    if (i != 0x14E && i != 0x14F) {
+      global_checksum += rom_[i];
+    }
+  }
+  rom_[0x14E] = global_checksum >> 8;
+  rom_[0x14F] = global_checksum & 0xFF;
+  return rom_;
+}
+
+}  // namespace gbemu
@@ -0,0 +1,143 @@
+#ifndef GBEMU_ROM_BUILDER_H_
+#define GBEMU_ROM_BUILDER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "cartridge_header.h"
+
+namespace gbemu {
+
+// SM83のレジスタ。値は命令のエンコーディングでの番号と一致する。
+enum class Reg8 { kB, kC, kD, kE, kH, kL, kHlIndirect, kA };
+enum class Reg16 { kBc, kDe, kHl, kSp };
+// 条件分岐の条件
+enum class Condition { kNz, kZ, kNc, kC };
+// 8ビットの算術論理演算
+enum class AluOp { kAdd, kAdc, kSub, kSbc, kAnd, kXor, kOr, kCp };
+
+// 命令を1つずつ書き込んでROMイメージを組み立てるクラス（小さなアセンブラ）。
+// ベンチマークやテスト用のROMをプログラムの中で生成するために使う。
+// $0100にはnop; jp $0150を置き、コードは$0150から書き始める。
+// Buildでヘッダ（ロゴ、タイトル、種別、サイズ、チェックサム）を書き込むので、
+// 生成したROMはそのままCartridgeに読み込める。
+// Example:
+//   RomBuilder builder("EXAMPLE", CartridgeType::kRomOnly, 2);
+//   RomBuilder::Label loop = builder.NewLabel();
+//   builder.Bind(loop);
+//   builder.Inc(Reg8::kA);
+//   builder.Jr(loop);
+//   std::vector<std::uint8_t> rom = builder.Build();
+class RomBuilder {
+ public:
+  // 分岐先を表すラベル。NewLabelで作り、Bindで位置を決める。
+  struct Label {
+    unsigned id;
+  };
+
+  // num_banksは16KiBのROMバンクの数（2, 4, 8, ...）。
+  // typeはROM Onlyか、RAMを持たないMBC1のみ対応する。
+  RomBuilder(const std::string& title, CartridgeType type, unsigned num_banks);
+
+  // 書き込み位置を指定したバンクの先頭（バンク0なら$0150）に移す。
+  void SetBank(unsigned bank);
+
+  // 書き込み位置をバンク0の$0000〜$00FF（RSTや割り込みのベクタ）の
+  // addressに移す。
+  void SetVectorAddress(std::uint16_t address);
+
+  // 書き込み位置のCPUから見たアドレス。
+  std::uint16_t address() const;
+
+  Label NewLabel();
+  // ラベルを現在の書き込み位置に置く。
+  void Bind(Label label);
+
+  // 任意のバイト列を書き込む。
+  void Db(std::initializer_list<std::uint8_t> bytes);
+  void Db(const std::vector<std::uint8_t>& bytes);
+
+  void Nop() { Db({0x00}); }
+  void Halt() { Db({0x76}); }
+  void Di() { Db({0xF3}); }
+  void Ei() { Db({0xFB}); }
+  void Ret() { Db({0xC9}); }
+  void Reti() { Db({0xD9}); }
+
+  // ld r,r'
+  void Ld(Reg8 dst, Reg8 src);
+  // ld r,n
+  void Ld(Reg8 dst, std::uint8_t value);
+  // ld rr,nn
+  void Ld(Reg16 dst, std::uint16_t value);
+  // ld (bc),a / ld (de),a
+  void StoreA(Reg16 address);
+  // ld a,(bc) / ld a,(de)
+  void LoadA(Reg16 address);
+  // ld (hl+),a
+  void StoreAHlInc() { Db({0x22}); }
+  // ld a,(hl+)
+  void LoadAHlInc() { Db({0x2A}); }
+  // ld (nn),a
+  void StoreA(std::uint16_t address);
+  // ld a,(nn)
+  void LoadA(std::uint16_t address);
+  // ldh (n),a
+  void Ldh(std::uint8_t port) { Db({0xE0, port}); }
+  // ldh a,(n)
+  void LdhA(std::uint8_t port) { Db({0xF0, port}); }
+  // ld a,n; ldh (n),a
+  void WriteIo(std::uint8_t port, std::uint8_t value);
+
+  // add a,r などの算術論理演算
+  void Alu(AluOp op, Reg8 src);
+  // add a,n などの算術論理演算
+  void Alu(AluOp op, std::uint8_t value);
+  void Inc(Reg8 reg);
+  void Dec(Reg8 reg);
+  void Inc(Reg16 reg);
+  void Dec(Reg16 reg);
+  // swap r
+  void Swap(Reg8 reg);
+  // rlca
+  void Rlca() { Db({0x07}); }
+
+  void Jr(Label target);
+  void Jr(Condition condition, Label target);
+  void Jp(Label target);
+  void Jp(Condition condition, Label target);
+  void Call(Label target);
+
+  // ヘッダとチェックサムを書き込み、ROMイメージを返す。
+  // 位置の決まっていないラベルへの分岐があればプログラムを終了する。
+  std::vector<std::uint8_t> Build();
+
+ private:
+  struct Fixup {
+    // 分岐先のアドレスを書き込むROM上の位置
+    std::size_t offset;
+    Label label;
+    bool is_relative;
+    // 分岐命令の次の命令のアドレス（相対分岐のときに使う）
+    std::uint16_t next_address;
+  };
+
+  void EmitBranch(std::uint8_t opcode, Label target, bool is_relative);
+
+  std::vector<std::uint8_t> rom_;
+  std::string title_;
+  CartridgeType type_;
+  // 書き込み位置（ROM上のオフセット）とそのバンク
+  std::size_t offset_;
+  unsigned bank_;
+  // 各ラベルのCPUから見たアドレス。-1なら位置が決まっていない。
+  std::vector<int> labels_;
+  std::vector<Fixup> fixups_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_ROM_BUILDER_H_
@@ -0,0 +1,109 @@
+#include "rom_test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "audio_sink.h"
+#include "cartridge.h"
+#include "frame_hash.h"
+#include "gameboy.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+// outputのbegin以降にpatternsのいずれかが現れたら、そのパターンをmatchedに入れる。
+bool FindPattern(const std::string& output, std::size_t begin,
+                 const std::vector<std::string>& patterns,
+                 std::string& matched) {
+  for (const std::string& pattern : patterns) {
+    if (output.find(pattern, begin) != std::string::npos) {
+      matched = pattern;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+const char* RomTestResult::GetStatusName(Status status) {
+  switch (status) {
+    case Status::kPassed:
+      return "passed";
+    case Status::kFailed:
+      return "failed";
+    case Status::kTimeout:
+      return "timeout";
+  }
+  UNREACHABLE("Invalid status.");
+}
+
+RomTestResult RunRomTest(const std::vector<std::uint8_t>& rom,
+                         const RomTestConfig& config) {
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::uint8_t> ram;
+  Cartridge cartridge(rom, &ram);
+  NullAudioSink audio;
+  GameBoy gb(&cartridge, audio);
+  gb.CaptureSerialOutput();
+
+  // パターンがフレームの境界をまたいでも見つかるように、
+  // 前回確かめた位置から最も長いパターンの長さ-1だけ戻って探す
+  std::size_t max_pattern_size = 1;
+  for (const auto* patterns : {&config.pass_patterns, &config.fail_patterns}) {
+    for (const std::string& pattern : *patterns) {
+      max_pattern_size = std::max(max_pattern_size, pattern.size());
+    }
+  }
+  std::size_t checked_size = 0;
+
+  RomTestResult result{};
+  result.status = RomTestResult::Status::kTimeout;
+  result.reason = "cycle budget exhausted";
+  while (gb.elapsed_cycles() < config.max_cycles) {
+    gb.Step();
+    result.frames++;
+
+    const std::string& output = gb.GetSerialOutput();
+    if (output.size() != checked_size) {
+      std::size_t begin = checked_size >= max_pattern_size - 1
+                              ? checked_size - (max_pattern_size - 1)
+                              : 0;
+      checked_size = output.size();
+      std::string matched;
+      if (FindPattern(output, begin, config.fail_patterns, matched)) {
+        result.status = RomTestResult::Status::kFailed;
+        result.reason = "serial: " + matched;
+        break;
+      }
+      if (FindPattern(output, begin, config.pass_patterns, matched)) {
+        result.status = RomTestResult::Status::kPassed;
+        result.reason = "serial: " + matched;
+        break;
+      }
+    }
+    if (config.pass_frame_hash != 0 &&
+        HashFrame(gb.GetPpuBuffer()) == config.pass_frame_hash) {
+      result.status = RomTestResult::Status::kPassed;
+      result.reason = "frame hash";
+      break;
+    }
+  }
+
+  result.cycles = gb.elapsed_cycles();
+  result.frame_hash = HashFrame(gb.GetPpuBuffer());
+  result.serial_output = gb.GetSerialOutput();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  result.seconds = elapsed.count();
+  return result;
+}
+
+}  // namespace gbemu
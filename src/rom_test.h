@@ -0,0 +1,50 @@
+#ifndef GBEMU_ROM_TEST_H_
+#define GBEMU_ROM_TEST_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gbemu {
+
+// テストROMの実行条件。
+struct RomTestConfig {
+  // シリアル出力にこれらのいずれかが現れたら成功とする
+  std::vector<std::string> pass_patterns{"Passed"};
+  // シリアル出力にこれらのいずれかが現れたら失敗とする
+  std::vector<std::string> fail_patterns{"Failed"};
+  // 0でなければ、画面のハッシュ値（HashFrame）がこの値になったら成功とする
+  std::uint64_t pass_frame_hash{0};
+  // 実行するT-cycle数の上限。超えたらタイムアウトとする（既定値は約60秒分）
+  std::uint64_t max_cycles{60ULL * 4194304};
+};
+
+// テストROMの実行結果。
+struct RomTestResult {
+  enum class Status { kPassed, kFailed, kTimeout };
+
+  Status status;
+  // 判定の根拠（一致したパターンなど）
+  std::string reason;
+  // 実行したフレーム数とT-cycle数
+  unsigned frames;
+  std::uint64_t cycles;
+  // 最後のフレームの画面のハッシュ値
+  std::uint64_t frame_hash;
+  // シリアル出力
+  std::string serial_output;
+  // 実行にかかった時間（秒）
+  double seconds;
+
+  static const char* GetStatusName(Status status);
+};
+
+// テストROMをヘッドレスで速度制限なしに実行する。
+// シリアル出力はメモリに蓄積し、1フレームごとに成功・失敗の条件を確かめて、
+// どちらかを満たすかサイクル数の上限に達した時点で止める。
+RomTestResult RunRomTest(const std::vector<std::uint8_t>& rom,
+                         const RomTestConfig& config);
+
+}  // namespace gbemu
+
+#endif  // GBEMU_ROM_TEST_H_
@@ -0,0 +1,82 @@
+#include "run_ahead.h"
+
+#include <chrono>
+
+#include "gameboy.h"
+#include "ppu.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+// 1秒あたりのフレーム数（4194304Hz / 70224サイクル）
+constexpr double kFramesPerSecond = 4194304.0 / GameBoy::kCyclesPerFrame;
+
+double SecondsBetween(std::chrono::steady_clock::time_point begin,
+                      std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+}  // namespace
+
+RunAhead::RunAhead(GameBoy& gb, unsigned num_frames, GameBoy* shadow)
+    : gb_(gb), num_frames_(num_frames), shadow_(shadow) {
+  if (shadow_ != nullptr) {
+    // 先読みした音声は出力しない
+    shadow_->set_audio_enabled(false);
+  }
+}
+
+const GbLcdPixelMatrix& RunAhead::Step() {
+  auto frame_begin = std::chrono::steady_clock::now();
+  gb_.Step();
+  frame_end_ns_ = GetMonotonicNs();
+  auto run_ahead_begin = std::chrono::steady_clock::now();
+  frame_seconds_ += SecondsBetween(frame_begin, run_ahead_begin);
+  num_steps_++;
+  if (num_frames_ == 0) {
+    return gb_.GetPpuBuffer();
+  }
+
+  gb_.SaveState(state_);
+  GameBoy& ahead = shadow_ != nullptr ? *shadow_ : gb_;
+  if (shadow_ != nullptr) {
+    bool loaded = shadow_->LoadState(state_);
+    ASSERT(loaded, "The shadow instance must run the same ROM.");
+  } else {
+    gb_.set_audio_enabled(false);
+  }
+
+  // 最後のフレームだけを描画する
+  ahead.set_video_enabled(false);
+  for (unsigned i = 1; i < num_frames_; i++) {
+    ahead.Step();
+  }
+  ahead.set_video_enabled(true);
+  ahead.Step();
+
+  if (shadow_ == nullptr) {
+    // 状態を戻すとバッファも戻るので、先に画面を取っておく
+    frame_ = gb_.GetPpuBuffer();
+    gb_.LoadState(state_);
+    gb_.set_audio_enabled(true);
+  }
+  run_ahead_seconds_ +=
+      SecondsBetween(run_ahead_begin, std::chrono::steady_clock::now());
+  return shadow_ != nullptr ? shadow_->GetPpuBuffer() : frame_;
+}
+
+double RunAhead::GetLatencySavedMs() const {
+  return num_frames_ * 1000.0 / kFramesPerSecond;
+}
+
+double RunAhead::GetOverhead() const {
+  return frame_seconds_ > 0 ? run_ahead_seconds_ / frame_seconds_ : 0;
+}
+
+double RunAhead::GetAverageFrameMs() const {
+  return num_steps_ > 0 ? frame_seconds_ * 1000.0 / num_steps_ : 0;
+}
+
+}  // namespace gbemu
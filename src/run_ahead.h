@@ -0,0 +1,68 @@
+#ifndef GBEMU_RUN_AHEAD_H_
+#define GBEMU_RUN_AHEAD_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "gameboy.h"
+#include "ppu.h"
+
+namespace gbemu {
+
+// 入力の遅延を隠すために、現在の入力のまま数フレーム先まで進めた画面を表示する仕組み。
+// ゲームは入力を受け取ってから1〜2フレーム後に画面へ反映することが多いので、
+// 毎フレーム状態を保存してnum_framesフレーム先を描画し、状態を元に戻す。
+// 先読みのフレームは最後の1フレームを除いて描画も音声の出力も行わない。
+//
+// 別のインスタンス（shadow）を渡すと、先読みはそちらで行う。
+// メインのインスタンスの状態を書き戻さずに済み、
+// 音声はメインのインスタンスが出力したものだけになる。
+// shadowは同じROMから作ったものでなければならない。
+// Example:
+//   RunAhead run_ahead(gb, 2);
+//   for (;;) {
+//     renderer.Render(run_ahead.Step());
+//   }
+class RunAhead {
+ public:
+  RunAhead(GameBoy& gb, unsigned num_frames, GameBoy* shadow = nullptr);
+
+  // 1フレーム進め、num_framesフレーム先の画面を返す。
+  // 戻り値は次にStepを呼ぶまで有効。
+  const GbLcdPixelMatrix& Step();
+
+  unsigned num_frames() const { return num_frames_; }
+
+  // 直前のStepで本来のフレームを進め終えた時刻（GetMonotonicNs）。
+  // 先読みを始める前の時刻なので、先読みにかかった時間は含まない。
+  std::uint64_t frame_end_ns() const { return frame_end_ns_; }
+
+  // 先読みで短縮した入力遅延（ミリ秒）。
+  double GetLatencySavedMs() const;
+
+  // 本来のフレームの処理時間に対する、先読みに要した時間の割合。
+  double GetOverhead() const;
+
+  // 本来のフレームの平均処理時間（ミリ秒）。
+  double GetAverageFrameMs() const;
+
+ private:
+  GameBoy& gb_;
+  unsigned num_frames_;
+  GameBoy* shadow_;
+
+  // 先読みする前の状態
+  std::vector<std::uint8_t> state_;
+  // 先読みした画面。メインのインスタンスで先読みしたときに使う。
+  GbLcdPixelMatrix frame_{};
+  std::uint64_t frame_end_ns_{0};
+
+  // 処理時間の集計
+  std::uint64_t num_steps_{0};
+  double frame_seconds_{0};
+  double run_ahead_seconds_{0};
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_RUN_AHEAD_H_
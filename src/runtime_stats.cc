@@ -0,0 +1,181 @@
+#include "runtime_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <ostream>
+#include <vector>
+
+#include "step_profile.h"
+
+namespace gbemu {
+
+namespace {
+
+constexpr std::uint64_t kReportIntervalNs = 1000000000;
+
+// 昇順に並べた値のp（0〜1）パーセンタイル（nearest-rank法）。
+std::uint64_t GetPercentile(const std::vector<std::uint64_t>& sorted,
+                            double p) {
+  std::size_t rank = static_cast<std::size_t>(std::ceil(p * sorted.size()));
+  return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1];
+}
+
+double ToMicroseconds(std::uint64_t ns) { return ns / 1000.0; }
+
+}  // namespace
+
+const char* RuntimeStats::GetSectionName(Section section) {
+  static const char* const kNames[kNumSections] = {
+      "cpu", "dma", "timer", "apu", "ppu", "render", "audio"};
+  return kNames[section];
+}
+
+RuntimeStats::Scope::~Scope() {
+  if (stats_ == nullptr) {
+    return;
+  }
+  std::uint64_t end = Now();
+  stats_->Add(section_, begin_, end);
+  stats_->WriteTraceEvent(GetSectionName(section_), begin_, end);
+}
+
+RuntimeStats::RuntimeStats(std::ostream& report, std::ostream* trace)
+    : report_(report),
+      trace_(trace),
+      start_ns_(Now()),
+      last_report_ns_(start_ns_) {
+  if (trace_ != nullptr) {
+    *trace_ << "[\n";
+  }
+}
+
+RuntimeStats::~RuntimeStats() {
+  if (trace_ != nullptr) {
+    *trace_ << "\n]\n";
+    trace_->flush();
+  }
+}
+
+void RuntimeStats::BeginFrame() {
+  profile_at_frame_begin_ = profile_;
+  current_ns_.fill(0);
+  current_calls_.fill(0);
+  frame_begin_ns_ = Now();
+}
+
+void RuntimeStats::EndFrame() {
+  std::uint64_t now = Now();
+
+  // エミュレーションの各コンポーネントはプロファイルの増分から求める
+  SectionTimes times = current_ns_;
+  std::uint64_t instructions =
+      profile_.instructions - profile_at_frame_begin_.instructions;
+  for (int i = 0; i < StepProfile::kNumComponents; i++) {
+    times[i] =
+        profile_.nanoseconds[i] - profile_at_frame_begin_.nanoseconds[i];
+    calls_[i] += instructions;
+  }
+  for (int i = StepProfile::kNumComponents; i < kNumSections; i++) {
+    calls_[i] += current_calls_[i];
+  }
+  frame_ns_.push_back(now - frame_begin_ns_);
+  section_ns_.push_back(times);
+
+  if (trace_ != nullptr) {
+    WriteTraceEvent("frame", frame_begin_ns_, now);
+    // コンポーネントは細かく入れ替わるので、フレームごとの合計をカウンタにする
+    char buffer[64];
+    *trace_ << ",\n{\"name\":\"emulation_us\",\"ph\":\"C\",\"pid\":1,\"ts\":";
+    std::snprintf(buffer, sizeof(buffer), "%.3f",
+                  ToMicroseconds(frame_begin_ns_ - start_ns_));
+    *trace_ << buffer << ",\"args\":{";
+    for (int i = 0; i < StepProfile::kNumComponents; i++) {
+      std::snprintf(buffer, sizeof(buffer), "%s\"%s\":%.3f", i ? "," : "",
+                    GetSectionName(static_cast<Section>(i)),
+                    ToMicroseconds(times[i]));
+      *trace_ << buffer;
+    }
+    *trace_ << "}}";
+  }
+
+  if (now - last_report_ns_ >= kReportIntervalNs) {
+    Report(now);
+  }
+}
+
+void RuntimeStats::Add(Section section, std::uint64_t begin_ns,
+                       std::uint64_t end_ns) {
+  current_ns_[section] += end_ns - begin_ns;
+  current_calls_[section]++;
+}
+
+std::uint64_t RuntimeStats::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void RuntimeStats::Report(std::uint64_t now) {
+  std::size_t num_frames = frame_ns_.size();
+  std::vector<std::uint64_t> sorted(frame_ns_);
+  std::sort(sorted.begin(), sorted.end());
+  std::uint64_t total = std::accumulate(sorted.begin(), sorted.end(),
+                                        std::uint64_t{0});
+  char line[160];
+  std::snprintf(line, sizeof(line),
+                "stats: %zu frames in %.2f s, frame %.3f ms "
+                "(p50 %.3f, p95 %.3f, p99 %.3f)\n",
+                num_frames, (now - last_report_ns_) / 1e9,
+                total / 1e6 / num_frames, GetPercentile(sorted, 0.5) / 1e6,
+                GetPercentile(sorted, 0.95) / 1e6,
+                GetPercentile(sorted, 0.99) / 1e6);
+  report_ << line;
+  std::snprintf(line, sizeof(line), "  %-7s %12s %10s %10s %10s %10s\n",
+                "section", "calls/frame", "avg(us)", "p50(us)", "p95(us)",
+                "p99(us)");
+  report_ << line;
+  for (int i = 0; i < kNumSections; i++) {
+    for (std::size_t frame = 0; frame < num_frames; frame++) {
+      sorted[frame] = section_ns_[frame][i];
+    }
+    std::sort(sorted.begin(), sorted.end());
+    total = std::accumulate(sorted.begin(), sorted.end(), std::uint64_t{0});
+    std::snprintf(line, sizeof(line),
+                  "  %-7s %12.1f %10.1f %10.1f %10.1f %10.1f\n",
+                  GetSectionName(static_cast<Section>(i)),
+                  static_cast<double>(calls_[i]) / num_frames,
+                  ToMicroseconds(total) / num_frames,
+                  ToMicroseconds(GetPercentile(sorted, 0.5)),
+                  ToMicroseconds(GetPercentile(sorted, 0.95)),
+                  ToMicroseconds(GetPercentile(sorted, 0.99)));
+    report_ << line;
+  }
+  report_.flush();
+
+  frame_ns_.clear();
+  section_ns_.clear();
+  calls_.fill(0);
+  last_report_ns_ = now;
+}
+
+void RuntimeStats::WriteTraceEvent(const char* name, std::uint64_t begin_ns,
+                                   std::uint64_t end_ns) {
+  if (trace_ == nullptr) {
+    return;
+  }
+  char buffer[160];
+  std::snprintf(buffer, sizeof(buffer),
+                "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                is_first_trace_event_ ? "" : ",\n", name,
+                ToMicroseconds(begin_ns - start_ns_),
+                ToMicroseconds(end_ns - begin_ns));
+  *trace_ << buffer;
+  is_first_trace_event_ = false;
+}
+
+}  // namespace gbemu
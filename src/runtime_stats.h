@@ -0,0 +1,136 @@
+#ifndef GBEMU_RUNTIME_STATS_H_
+#define GBEMU_RUNTIME_STATS_H_
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "audio_sink.h"
+#include "step_profile.h"
+
+namespace gbemu {
+
+// 実行中の処理時間を計測し、1秒ごとに直近1秒間の統計を表示するクラス。
+// エミュレーションの各コンポーネントはGameBoy::set_profileに渡したプロファイルで、
+// 画面の描画と音声の出力はScopeとTimedAudioSinkで計測する。
+// トレースの出力先を渡すと、chrome://tracingやPerfettoで読める
+// trace event形式のJSONも書き出す。
+// Example:
+//   RuntimeStats stats(std::cerr, nullptr);
+//   gb.set_profile(stats.profile());
+//   for (;;) {
+//     stats.BeginFrame();
+//     gb.Step();
+//     {
+//       RuntimeStats::Scope scope(&stats, RuntimeStats::kRender);
+//       renderer.Render(gb.GetPpuBuffer());
+//     }
+//     stats.EndFrame();
+//   }
+class RuntimeStats {
+ public:
+  // 計測する区間。先頭はStepProfile::Componentと同じ並び。
+  // APUの時間には音声の出力（kAudio）の時間も含まれる。
+  enum Section {
+    kCpu,
+    kDma,
+    kTimer,
+    kApu,
+    kPpu,
+    kRender,
+    kAudio,
+    kNumSections
+  };
+
+  static const char* GetSectionName(Section section);
+
+  // 区間の処理時間を加算するオブジェクト。
+  // 生成から破棄までの時間を加算し、トレースにも書き出す。
+  // statsがnullptrなら何もしない。
+  class Scope {
+   public:
+    Scope(RuntimeStats* stats, Section section)
+        : stats_(stats), section_(section), begin_(stats ? Now() : 0) {}
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    RuntimeStats* stats_;
+    Section section_;
+    std::uint64_t begin_;
+  };
+
+  // reportは統計の出力先。traceがnullptrでなければトレースを書き出す。
+  RuntimeStats(std::ostream& report, std::ostream* trace);
+  ~RuntimeStats();
+
+  RuntimeStats(const RuntimeStats&) = delete;
+  RuntimeStats& operator=(const RuntimeStats&) = delete;
+
+  // エミュレータに加算させるプロファイル。
+  StepProfile* profile() { return &profile_; }
+
+  // フレームの始まりと終わりに呼ぶ。
+  // EndFrameは前回の表示から1秒以上たっていたら統計を表示する。
+  void BeginFrame();
+  void EndFrame();
+
+  // 区間の処理時間（begin_nsからend_nsまで）を加算する。
+  void Add(Section section, std::uint64_t begin_ns, std::uint64_t end_ns);
+
+  // 計測に使う時刻（ナノ秒）。
+  static std::uint64_t Now();
+
+ private:
+  using SectionTimes = std::array<std::uint64_t, kNumSections>;
+
+  // 直近1秒間の統計を表示し、記録を捨てる。
+  void Report(std::uint64_t now);
+
+  // trace eventを1つ書き出す。
+  void WriteTraceEvent(const char* name, std::uint64_t begin_ns,
+                       std::uint64_t end_ns);
+
+  std::ostream& report_;
+  std::ostream* trace_;
+  bool is_first_trace_event_{true};
+  std::uint64_t start_ns_;
+
+  StepProfile profile_;
+  // BeginFrameの時点のprofile_
+  StepProfile profile_at_frame_begin_;
+  std::uint64_t frame_begin_ns_{0};
+  // 現在のフレームの描画と音声の出力の処理時間と回数
+  SectionTimes current_ns_{};
+  SectionTimes current_calls_{};
+
+  // 直近の表示からの各フレームの記録
+  std::uint64_t last_report_ns_;
+  std::vector<std::uint64_t> frame_ns_;
+  std::vector<SectionTimes> section_ns_;
+  SectionTimes calls_{};
+};
+
+// PushSampleの処理時間をRuntimeStatsのkAudioに加算して出力先に渡すAudioSink。
+class TimedAudioSink : public AudioSink {
+ public:
+  TimedAudioSink(AudioSink& sink, RuntimeStats& stats)
+      : sink_(sink), stats_(stats) {}
+
+  void PushSample(double left, double right) override {
+    std::uint64_t begin = RuntimeStats::Now();
+    sink_.PushSample(left, right);
+    stats_.Add(RuntimeStats::kAudio, begin, RuntimeStats::Now());
+  }
+
+ private:
+  AudioSink& sink_;
+  RuntimeStats& stats_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_RUNTIME_STATS_H_
@@ -0,0 +1,88 @@
+#ifndef GBEMU_SAVE_STATE_H_
+#define GBEMU_SAVE_STATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "utils.h"
+
+namespace gbemu {
+
+// セーブステートのバイト列に値を順に書き込むクラス。
+// 値はホストのバイトオーダーのまま詰めて格納する。
+class StateWriter {
+ public:
+  // bufferの内容を空にしてから書き込む。
+  // bufferの容量は維持されるので、同じbufferを使い回せばメモリの確保は起きない。
+  explicit StateWriter(std::vector<std::uint8_t>& buffer) : buffer_(buffer) {
+    buffer_.clear();
+  }
+
+  template <class T>
+  void Write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Only trivially copyable values can be written.");
+    WriteBytes(&value, sizeof(T));
+  }
+
+  void WriteBytes(const void* data, std::size_t size) {
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+    buffer_.insert(buffer_.end(), bytes, bytes + size);
+  }
+
+  // 書き込み済みのバイト数を得る。
+  std::size_t size() const { return buffer_.size(); }
+
+  // 書き込み済みの位置にある値を上書きする。
+  template <class T>
+  void Overwrite(std::size_t offset, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Only trivially copyable values can be written.");
+    ASSERT(offset + sizeof(T) <= buffer_.size(), "Invalid offset: %zu",
+           offset);
+    std::memcpy(buffer_.data() + offset, &value, sizeof(T));
+  }
+
+ private:
+  std::vector<std::uint8_t>& buffer_;
+};
+
+// セーブステートのバイト列から値を順に読み出すクラス。
+// StateWriterで書き込んだのと同じ順序・同じ型で読み出すこと。
+class StateReader {
+ public:
+  StateReader(const std::uint8_t* data, std::size_t size)
+      : data_(data), size_(size) {}
+
+  template <class T>
+  T Read() {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Only trivially copyable values can be read.");
+    T value;
+    ReadBytes(&value, sizeof(T));
+    return value;
+  }
+
+  // バイト列の末尾を超えて読み出そうとするのは設計の誤りなので、
+  // 呼び出し側はあらかじめ全体のサイズを検証しておくこと。
+  void ReadBytes(void* data, std::size_t size) {
+    ASSERT(position_ + size <= size_, "Save state is truncated.");
+    std::memcpy(data, data_ + position_, size);
+    position_ += size;
+  }
+
+  // まだ読み出していないバイト数を得る。
+  std::size_t remaining() const { return size_ - position_; }
+
+ private:
+  const std::uint8_t* data_;
+  std::size_t size_;
+  std::size_t position_{0};
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_SAVE_STATE_H_
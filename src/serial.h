@@ -3,13 +3,16 @@
 
 #include <cstdint>
 #include <iostream>
+#include <string>
 
 #include "command_line.h"
+#include "save_state.h"
 
 namespace gbemu {
 
 // シリアル通信機能を表すクラス。
 // 送信データを標準出力するだけの実装になっている。
+// キャプチャを有効にすると、標準出力する代わりに内部のバッファに蓄積する。
 class Serial {
  public:
   std::uint8_t sb() const { return sb_; }
@@ -18,16 +21,42 @@ class Serial {
   void set_sc(std::uint8_t value) {
     sc_ = value;
     sc_ &= ~(0b10000001U);
+    if (value != 0x81) {
+      return;
+    }
+    if (is_capturing_) {
+      captured_output_.push_back(static_cast<char>(sb_));
+      return;
+    }
     // --debugフラグがない場合に限り、シリアル出力を標準出力に接続
     // --debugフラグがあるときは接続しない（デバッグ出力と混ざってぐちゃぐちゃになるので）
-    if (!options.debug() && value == 0x81) {
+    if (!options.debug()) {
       std::cout << static_cast<unsigned char>(sb_) << std::flush;
     }
   }
 
+  // 送信データのキャプチャを開始する。
+  void StartCapture() { is_capturing_ = true; }
+  // キャプチャした送信データを取得する。
+  const std::string& captured_output() const { return captured_output_; }
+
+  // 状態をセーブステートに書き出す。
+  // キャプチャした送信データはエミュレータの外側の情報なので含めない。
+  void SaveState(StateWriter& writer) const {
+    writer.Write(sb_);
+    writer.Write(sc_);
+  }
+  // セーブステートから状態を復元する。
+  void LoadState(StateReader& reader) {
+    sb_ = reader.Read<std::uint8_t>();
+    sc_ = reader.Read<std::uint8_t>();
+  }
+
  private:
   std::uint8_t sb_{};
   std::uint8_t sc_{};
+  bool is_capturing_{false};
+  std::string captured_output_;
 };
 
 }  // namespace gbemu
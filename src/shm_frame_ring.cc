@@ -0,0 +1,181 @@
+#include "shm_frame_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "lcd.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+constexpr char kMagic[8] = {'G', 'B', 'E', 'M', 'U', 'F', 'B', '\0'};
+
+static_assert(sizeof(GbLcdPixelMatrix) == lcd::kTotalPixelNum);
+static_assert(sizeof(ShmFrameRingHeader) % 8 == 0);
+
+std::size_t GetRingSize(unsigned slot_count) {
+  return sizeof(ShmFrameRingHeader) + slot_count * sizeof(ShmFrameSlot);
+}
+
+}  // namespace
+
+ShmFrameWriter::ShmFrameWriter(const std::string& name, unsigned slot_count)
+    : name_(name), size_(GetRingSize(slot_count)) {
+  ASSERT(slot_count > 0, "slot_count must be positive.");
+
+  // 前回の実行で残ったものがあれば消してから作る
+  shm_unlink(name_.c_str());
+  int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    Error("shm_open failed: %s: %s", name_.c_str(), std::strerror(errno));
+  }
+  if (ftruncate(fd, size_) != 0) {
+    Error("ftruncate failed: %s: %s", name_.c_str(), std::strerror(errno));
+  }
+  memory_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory_ == MAP_FAILED) {
+    Error("mmap failed: %s: %s", name_.c_str(), std::strerror(errno));
+  }
+
+  header_ = new (memory_) ShmFrameRingHeader{};
+  header_->version = kShmFrameRingVersion;
+  header_->slot_count = slot_count;
+  header_->slot_size = sizeof(ShmFrameSlot);
+  header_->width = lcd::kWidth;
+  header_->height = lcd::kHeight;
+  slots_ = reinterpret_cast<ShmFrameSlot*>(header_ + 1);
+  for (unsigned i = 0; i < slot_count; i++) {
+    new (&slots_[i]) ShmFrameSlot{};
+  }
+  // 読み出し側がヘッダを書き終える前に開かないように、マジックは最後に書く
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header_->magic, kMagic, sizeof(kMagic));
+}
+
+ShmFrameWriter::~ShmFrameWriter() {
+  munmap(memory_, size_);
+  shm_unlink(name_.c_str());
+}
+
+void ShmFrameWriter::PushFrame(const GbLcdPixelMatrix& frame,
+                               std::uint64_t vblank_ns) {
+  std::uint64_t frame_number = ++frame_number_;
+  ShmFrameSlot& slot = slots_[frame_number % header_->slot_count];
+
+  // sequenceを奇数にしている間に中身を書き換える
+  std::uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.frame_number = frame_number;
+  slot.vblank_ns = vblank_ns;
+  std::memcpy(slot.pixels, frame.data(), lcd::kTotalPixelNum);
+  slot.publish_ns = GetMonotonicNs();
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+
+  header_->latest_frame.store(frame_number, std::memory_order_release);
+}
+
+ShmFrameReader::~ShmFrameReader() {
+  if (memory_ != nullptr) {
+    munmap(memory_, size_);
+  }
+}
+
+bool ShmFrameReader::Open(const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<std::size_t>(st.st_size) < sizeof(ShmFrameRingHeader)) {
+    close(fd);
+    return false;
+  }
+  std::size_t size = st.st_size;
+  void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+
+  // マジックを確かめてから残りのヘッダを読む
+  auto header = static_cast<const ShmFrameRingHeader*>(memory);
+  bool is_valid = std::memcmp(header->magic, kMagic, sizeof(kMagic)) == 0;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  is_valid = is_valid && header->version == kShmFrameRingVersion &&
+             header->slot_count > 0 &&
+             header->slot_size == sizeof(ShmFrameSlot) &&
+             header->width == lcd::kWidth && header->height == lcd::kHeight &&
+             size >= GetRingSize(header->slot_count);
+  if (!is_valid) {
+    munmap(memory, size);
+    return false;
+  }
+
+  if (memory_ != nullptr) {
+    munmap(memory_, size_);
+  }
+  memory_ = memory;
+  size_ = size;
+  header_ = header;
+  slots_ = reinterpret_cast<const ShmFrameSlot*>(header_ + 1);
+  return true;
+}
+
+std::uint64_t ShmFrameReader::GetLatestFrame() const {
+  ASSERT(header_ != nullptr, "The ring is not open.");
+  return header_->latest_frame.load(std::memory_order_acquire);
+}
+
+bool ShmFrameReader::Read(std::uint64_t frame_number, Frame& frame) const {
+  for (;;) {
+    std::uint64_t latest = GetLatestFrame();
+    if (latest == 0 || latest < frame_number) {
+      return false;
+    }
+    // リングに残っている最も古いフレームより前は読めない
+    std::uint64_t slot_count = header_->slot_count;
+    std::uint64_t oldest = latest >= slot_count ? latest - slot_count + 1 : 1;
+    if (ReadSlot(std::max(frame_number, oldest), frame)) {
+      return true;
+    }
+    // 読んでいる間に上書きされたので、最新のフレームの番号から数え直す
+  }
+}
+
+bool ShmFrameReader::ReadSlot(std::uint64_t frame_number, Frame& frame) const {
+  const ShmFrameSlot& slot = slots_[frame_number % header_->slot_count];
+  for (;;) {
+    std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence % 2 != 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    frame.frame_number = slot.frame_number;
+    frame.vblank_ns = slot.vblank_ns;
+    frame.publish_ns = slot.publish_ns;
+    std::memcpy(frame.pixels.data(), slot.pixels, lcd::kTotalPixelNum);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+      return frame.frame_number == frame_number;
+    }
+  }
+}
+
+}  // namespace gbemu
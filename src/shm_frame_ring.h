@@ -0,0 +1,149 @@
+#ifndef GBEMU_SHM_FRAME_RING_H_
+#define GBEMU_SHM_FRAME_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "frame_sink.h"
+#include "lcd.h"
+
+namespace gbemu {
+
+// POSIXの共有メモリ（shm_open + mmap）に置く、画面のリングバッファの形式。
+// 同じマシンの別のプロセスが、ソケットを介さずにエミュレータの画面を読める。
+// 数値はホストのバイトオーダーで、すべての領域は8バイト境界に揃える。
+//   ShmFrameRingHeader
+//   ShmFrameSlot × slot_count
+// フレームには1から順に番号を振り、番号nのフレームは(n % slot_count)番目の
+// スロットに書く。各スロットはseqlockで保護する。書き込み側はsequenceを奇数に
+// してから中身を書き、書き終えたら偶数に戻す。読み出し側は中身を読む前後で
+// sequenceが同じ偶数であれば、書き込みと重ならずに読めたとみなす。
+// 時刻はCLOCK_MONOTONICのナノ秒で、同じマシンのプロセス間で比較できる。
+
+// 共有メモリの先頭に置くヘッダ。
+struct ShmFrameRingHeader {
+  // "GBEMUFB\0"
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t slot_count;
+  // 1スロットのバイト数
+  std::uint32_t slot_size;
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t reserved;
+  // 最後に書き終えたフレームの番号。まだなければ0。
+  std::atomic<std::uint64_t> latest_frame;
+};
+
+// 1フレーム分のスロット。
+struct ShmFrameSlot {
+  // seqlockの通し番号。奇数の間は書き込み中。
+  std::atomic<std::uint64_t> sequence;
+  std::uint64_t frame_number;
+  // エミュレータがフレームを完成させた時刻
+  // （本来のフレームのStepから戻った時刻で、先読みの前）
+  std::uint64_t vblank_ns;
+  // スロットへの書き込みを終えた時刻
+  std::uint64_t publish_ns;
+  // 行優先に並べた各ピクセルの色（GbLcdColorの値）
+  std::uint8_t pixels[lcd::kTotalPixelNum];
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "The seqlock must be usable across processes.");
+static_assert(sizeof(ShmFrameSlot) % 8 == 0);
+
+// 共有メモリの形式のバージョン。
+constexpr std::uint32_t kShmFrameRingVersion = 1;
+
+// 画面を共有メモリのリングバッファに書き込むFrameSink。
+// 書き込み側はつねに1つで、読み出し側を待たない。読み出しが遅れると
+// 古いフレームは上書きされる。共有メモリは破棄するときに削除する。
+// Example:
+//   ShmFrameWriter writer("/gbemu-frames");
+//   for (;;) {
+//     gb.Step();
+//     writer.PushFrame(gb.GetPpuBuffer(), GetMonotonicNs());
+//   }
+class ShmFrameWriter : public FrameSink {
+ public:
+  // nameの共有メモリを作ってslot_countフレーム分の領域を確保する。
+  // nameは'/'で始まる名前（shm_openを参照）。同名のものがあれば作り直す。
+  // 作れなければプログラムを終了する。
+  explicit ShmFrameWriter(const std::string& name, unsigned slot_count = 8);
+  ~ShmFrameWriter() override;
+
+  ShmFrameWriter(const ShmFrameWriter&) = delete;
+  ShmFrameWriter& operator=(const ShmFrameWriter&) = delete;
+
+  void PushFrame(const GbLcdPixelMatrix& frame,
+                 std::uint64_t vblank_ns) override;
+
+  // 書き込んだフレームの数。
+  std::uint64_t num_frames() const { return frame_number_; }
+
+ private:
+  std::string name_;
+  void* memory_{};
+  std::size_t size_{};
+  ShmFrameRingHeader* header_{};
+  ShmFrameSlot* slots_{};
+  std::uint64_t frame_number_{0};
+};
+
+// 共有メモリのリングバッファから画面を読み出すクラス。
+// 読み出し側はいくつあってもよく、書き込み側には何も書き込まない。
+// Example:
+//   ShmFrameReader reader;
+//   if (!reader.Open("/gbemu-frames")) { ... }
+//   ShmFrameReader::Frame frame;
+//   std::uint64_t next = 1;
+//   for (;;) {
+//     if (reader.Read(next, frame)) {
+//       Consume(frame);
+//       next = frame.frame_number + 1;
+//     }
+//   }
+class ShmFrameReader {
+ public:
+  // 読み出した1フレーム分の画面と時刻。
+  struct Frame {
+    std::uint64_t frame_number;
+    std::uint64_t vblank_ns;
+    std::uint64_t publish_ns;
+    GbLcdPixelMatrix pixels;
+  };
+
+  ShmFrameReader() = default;
+  ~ShmFrameReader();
+
+  ShmFrameReader(const ShmFrameReader&) = delete;
+  ShmFrameReader& operator=(const ShmFrameReader&) = delete;
+
+  // nameの共有メモリを開く。存在しないか形式が違えばfalseを返す。
+  bool Open(const std::string& name);
+
+  // 最後に書き終えたフレームの番号を得る。まだなければ0。
+  std::uint64_t GetLatestFrame() const;
+
+  // 番号frame_number以降で読めるうち最も古いフレームを読み出す。
+  // 読み出しが遅れて上書きされたフレームは飛ばす。
+  // まだ書かれていなければfalseを返す。
+  bool Read(std::uint64_t frame_number, Frame& frame) const;
+
+ private:
+  // スロットを書き込みと重ならずに読めるまで読み直し、
+  // 読めたフレームの番号がframe_numberならtrueを返す。
+  bool ReadSlot(std::uint64_t frame_number, Frame& frame) const;
+
+  void* memory_{};
+  std::size_t size_{};
+  const ShmFrameRingHeader* header_{};
+  const ShmFrameSlot* slots_{};
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_SHM_FRAME_RING_H_
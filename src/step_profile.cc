@@ -0,0 +1,28 @@
+#include "step_profile.h"
+
+#include <chrono>
+#include <cstdint>
+
+namespace gbemu {
+
+double ProfileClock::GetNanosecondsPerTick() {
+#ifdef GBEMU_PROFILE_USE_TSC
+  // 10ミリ秒の間に進んだTSCをsteady_clockと比べる
+  static const double kNanosecondsPerTick = [] {
+    auto begin = std::chrono::steady_clock::now();
+    std::uint64_t begin_ticks = Now();
+    std::chrono::steady_clock::time_point end;
+    do {
+      end = std::chrono::steady_clock::now();
+    } while (end - begin < std::chrono::milliseconds(10));
+    std::uint64_t ticks = Now() - begin_ticks;
+    std::chrono::duration<double, std::nano> elapsed = end - begin;
+    return ticks > 0 ? elapsed.count() / ticks : 1.0;
+  }();
+  return kNanosecondsPerTick;
+#else
+  return 1.0;
+#endif
+}
+
+}  // namespace gbemu
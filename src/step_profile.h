@@ -0,0 +1,57 @@
+#ifndef GBEMU_STEP_PROFILE_H_
+#define GBEMU_STEP_PROFILE_H_
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define GBEMU_PROFILE_USE_TSC
+#endif
+
+namespace gbemu {
+
+// 処理時間の計測に使う時計。
+// 命令ごとに何度も読むので、x86ではTSCを読み、それ以外ではsteady_clockを使う。
+class ProfileClock {
+ public:
+  // 現在の時刻（単位はtick）。
+  static std::uint64_t Now() {
+#ifdef GBEMU_PROFILE_USE_TSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  // 1tickあたりのナノ秒数。TSCの場合は初回の呼び出しで較正する。
+  static double GetNanosecondsPerTick();
+};
+
+// GameBoy::StepWithProfileで計測する、コンポーネントごとの処理時間の内訳。
+// 値は呼び出しのたびに加算していく。
+struct StepProfile {
+  // 計測するコンポーネント。
+  // CPUの時間にはCPUが行うメモリアクセスの時間も含まれる。
+  enum Component { kCpu, kDma, kTimer, kApu, kPpu, kNumComponents };
+
+  // コンポーネントの名前を得る。
+  static const char* GetComponentName(Component component) {
+    static const char* const kNames[kNumComponents] = {"cpu", "dma", "timer",
+                                                       "apu", "ppu"};
+    return kNames[component];
+  }
+
+  // コンポーネントごとの処理時間（ナノ秒）
+  std::uint64_t nanoseconds[kNumComponents]{};
+  // 実行した命令の数（割り込みの処理とHALT中の1サイクルも1つと数える）
+  std::uint64_t instructions{};
+  // 進めたフレームの数
+  std::uint64_t frames{};
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_STEP_PROFILE_H_
@@ -0,0 +1,112 @@
+#include "thread_pool.h"
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace gbemu {
+
+ThreadPool::ThreadPool(unsigned num_threads) {
+  if (num_threads == 0) {
+    num_threads = GetHardwareConcurrency();
+  }
+  for (unsigned i = 0; i < num_threads; i++) {
+    queues_.push_back(std::make_unique<WorkQueue>());
+  }
+  for (unsigned i = 0; i < num_threads; i++) {
+    workers_.emplace_back([this, i] { WorkerLoop(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  task_available_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+unsigned ThreadPool::GetHardwareConcurrency() {
+  unsigned n = std::thread::hardware_concurrency();
+  return n == 0 ? 1 : n;
+}
+
+void ThreadPool::Submit(Task task) {
+  unsigned index = next_queue_.fetch_add(1) % queues_.size();
+  {
+    std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+    queues_[index]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    num_queued_++;
+    num_pending_++;
+  }
+  task_available_.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  all_done_.wait(lock, [this] { return num_pending_ == 0; });
+}
+
+bool ThreadPool::PopTask(unsigned index, Task& task) {
+  // 自分のキューの末尾から取り出す
+  {
+    WorkQueue& own = *queues_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+
+  // 他のワーカーのキューの先頭から盗む
+  for (unsigned i = 1; i < queues_.size(); i++) {
+    WorkQueue& victim = *queues_[(index + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(unsigned index) {
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_available_.wait(lock,
+                           [this] { return is_stopping_ || num_queued_ > 0; });
+      if (num_queued_ == 0) {
+        // 終了要求があり、残っているタスクもない
+        return;
+      }
+      num_queued_--;
+    }
+
+    // num_queued_を1つ減らした権利で必ずどこかのキューからタスクを1つ取り出せる
+    Task task;
+    while (!PopTask(index, task)) {
+      std::this_thread::yield();
+    }
+    task();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      num_pending_--;
+      if (num_pending_ == 0) {
+        all_done_.notify_all();
+      }
+    }
+  }
+}
+
+}  // namespace gbemu
@@ -0,0 +1,81 @@
+#ifndef GBEMU_THREAD_POOL_H_
+#define GBEMU_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gbemu {
+
+// ワークスティーリングを行うスレッドプール。
+// ワーカーごとにタスクのキューを持ち、自分のキューは末尾から取り出す。
+// 自分のキューが空になったら他のワーカーのキューの先頭からタスクを盗む。
+// Example:
+//   ThreadPool pool;  // ハードウェアのスレッド数だけワーカーを作る
+//   for (auto& job : jobs) {
+//     pool.Submit([&job] { job.Run(); });
+//   }
+//   pool.Wait();
+class ThreadPool {
+ public:
+  using Task = std::function<void()>;
+
+  // 指定した数のワーカーを起動する。0を指定するとハードウェアのスレッド数とする。
+  explicit ThreadPool(unsigned num_threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // タスクを投入する。タスクはワーカーのキューに順番に振り分ける。
+  void Submit(Task task);
+
+  // 投入したすべてのタスクが完了するまで待つ。
+  void Wait();
+
+  // ワーカーの数を取得する。
+  unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+  // ハードウェアのスレッド数を返す。取得できなければ1を返す。
+  static unsigned GetHardwareConcurrency();
+
+ private:
+  // ワーカーごとのタスクのキュー。
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // ワーカーの処理。
+  void WorkerLoop(unsigned index);
+
+  // ワーカーindexが次に実行するタスクを取り出す。
+  // 自分のキューが空なら他のキューから盗む。取り出せなければfalseを返す。
+  bool PopTask(unsigned index, Task& task);
+
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
+  std::vector<std::thread> workers_;
+
+  // 次にタスクを振り分けるキューの番号。
+  std::atomic<unsigned> next_queue_{0};
+
+  // キューに入っているタスクの数と、完了していないタスクの数。
+  // どちらもmutex_の保護下で更新する。
+  unsigned num_queued_{0};
+  unsigned num_pending_{0};
+  bool is_stopping_{false};
+  std::mutex mutex_;
+  // タスクの投入と終了要求をワーカーに通知する。
+  std::condition_variable task_available_;
+  // すべてのタスクの完了をWaitに通知する。
+  std::condition_variable all_done_;
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_THREAD_POOL_H_
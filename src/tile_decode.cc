@@ -0,0 +1,19 @@
+#include "tile_decode.h"
+
+#include <cstdint>
+
+namespace gbemu {
+
+PackedTileRow DecodeTileRowScalar(std::uint8_t lower, std::uint8_t upper) {
+  PackedTileRow result = 0;
+  for (int i = 0; i < 8; i++) {
+    unsigned shift_amount = 7 - i;
+    unsigned lower_bit = (lower >> shift_amount) & 1;
+    unsigned upper_bit = (upper >> shift_amount) & 1;
+    PackedTileRow color_id = (upper_bit << 1) | lower_bit;
+    result |= color_id << tile_decode_internal::GetByteShift(i);
+  }
+  return result;
+}
+
+}  // namespace gbemu
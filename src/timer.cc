@@ -1,6 +1,7 @@
 #include "timer.h"
 
 #include "interrupt.h"
+#include "save_state.h"
 #include "utils.h"
 
 namespace gbemu {
@@ -52,4 +53,18 @@ void Timer::Run(unsigned tcycle) {
   }
 }
 
+void Timer::SaveState(StateWriter& writer) const {
+  writer.Write(tima_);
+  writer.Write(tma_);
+  writer.Write(tac_);
+  writer.Write(counter_);
+}
+
+void Timer::LoadState(StateReader& reader) {
+  tima_ = reader.Read<std::uint8_t>();
+  tma_ = reader.Read<std::uint8_t>();
+  tac_ = reader.Read<std::uint8_t>();
+  counter_ = reader.Read<std::uint16_t>();
+}
+
 }  // namespace gbemu
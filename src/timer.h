@@ -4,6 +4,7 @@
 #include <cstdint>
 
 #include "interrupt.h"
+#include "save_state.h"
 
 namespace gbemu {
 
@@ -24,6 +25,11 @@ class Timer {
   // 指定したクロック数だけ状態を進める。
   void Run(unsigned tcycle);
 
+  // 状態をセーブステートに書き出す。
+  void SaveState(StateWriter& writer) const;
+  // セーブステートから状態を復元する。
+  void LoadState(StateReader& reader);
+
  private:
   // 1クロックだけ状態を進める。
   void Step();
@@ -1,9 +1,16 @@
 #include "utils.h"
 
+#include <time.h>
+
+#include <algorithm>
 #include <cstdarg>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
 
 namespace gbemu {
 
@@ -26,6 +33,88 @@ void WarnUser(const char* fmt, ...) {
   std::fprintf(stderr, "\n");
 }
 
+std::vector<std::uint8_t> LoadBinary(const std::string& path) {
+  // ファイルをオープン
+  std::ifstream ifs(path, std::ios_base::in | std::ios_base::binary);
+  if (ifs.fail()) {
+    Error("File cannot open: %s", path.c_str());
+  }
+
+  // ファイルを読み出す
+  std::istreambuf_iterator<char> it_ifs_begin(ifs);
+  std::istreambuf_iterator<char> it_ifs_end{};
+  std::vector<std::uint8_t> data(it_ifs_begin, it_ifs_end);
+  if (ifs.fail()) {
+    Error("File cannot read: %s", path.c_str());
+  }
+
+  // ファイルをクローズ
+  ifs.close();
+  if (ifs.fail()) {
+    Error("File cannot close: %s", path.c_str());
+  }
+
+  return data;
+}
+
+void OutputBinary(const std::string& path,
+                  const std::vector<std::uint8_t>& data) {
+  std::ofstream ofs(path, std::ios_base::out | std::ios_base::binary);
+  if (ofs.fail()) {
+    Error("File cannot open: %s", path.c_str());
+  }
+  std::ostreambuf_iterator<char> it_ofs(ofs);
+  std::copy(std::cbegin(data), std::cend(data), it_ofs);
+  if (ofs.fail()) {
+    Error("File cannot read: %s", path.c_str());
+  }
+  ofs.close();
+  if (ofs.fail()) {
+    Error("File cannot close: %s", path.c_str());
+  }
+}
+
+std::string EscapeJson(const std::string& str) {
+  std::string result;
+  result.reserve(str.size());
+  for (unsigned char c : str) {
+    switch (c) {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      case '\r':
+        result += "\\r";
+        break;
+      case '\t':
+        result += "\\t";
+        break;
+      default:
+        if (c < 0x20 || c >= 0x7F) {
+          // 制御文字とASCII外の文字は\u00XXの形式にする
+          char buf[8];
+          std::snprintf(buf, sizeof(buf), "\\u%04X", c);
+          result += buf;
+        } else {
+          result += static_cast<char>(c);
+        }
+        break;
+    }
+  }
+  return result;
+}
+
+std::uint64_t GetMonotonicNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
 std::uint16_t ConcatUInt(std::uint8_t lower, std::uint8_t upper) {
   return lower | (static_cast<std::uint16_t>(upper) << 8);
 }
@@ -6,6 +6,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <limits>
+#include <string>
+#include <vector>
 
 namespace gbemu {
 
@@ -74,6 +76,23 @@ namespace gbemu {
 // メッセージの末尾は改行される。
 void WarnUser(const char* fmt, ...);
 
+// 指定したパスのファイルをバイナリファイルとして読み出す。
+// 読み出しに失敗したらプログラムを終了する。
+std::vector<std::uint8_t> LoadBinary(const std::string& path);
+
+// 指定したパスのファイルにバイナリデータを書き出す。
+// 書き出しに失敗したらプログラムを終了する。
+void OutputBinary(const std::string& path,
+                  const std::vector<std::uint8_t>& data);
+
+// 文字列をJSONの文字列リテラルとして埋め込めるようにエスケープする。
+// 前後のダブルクォーテーションは付加しない。
+std::string EscapeJson(const std::string& str);
+
+// CLOCK_MONOTONICの現在時刻をナノ秒で得る。
+// 同じマシンのプロセス間で比較できる。
+std::uint64_t GetMonotonicNs();
+
 std::uint16_t ConcatUInt(std::uint8_t lower, std::uint8_t upper);
 
 // 第posビットからbitsビット分を切り出す
@@ -0,0 +1,219 @@
+#include "vec_env.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cartridge.h"
+#include "gameboy.h"
+#include "joypad.h"
+#include "key_input.h"
+#include "lcd.h"
+#include "observation.h"
+#include "ppu.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace gbemu {
+
+namespace {
+
+ObservationEncoder::Config MakeEncoderConfig(const VecEnv::Config& config) {
+  ObservationEncoder::Config encoder_config;
+  encoder_config.width = config.observation_width;
+  encoder_config.height = config.observation_height;
+  encoder_config.filter = config.observation_filter;
+  return encoder_config;
+}
+
+}  // namespace
+
+VecEnv::VecEnv(const std::vector<std::uint8_t>& rom, const Config& config)
+    : rom_(rom),
+      config_(config),
+      instances_(config.num_envs),
+      encoder_(MakeEncoderConfig(config)) {
+  ASSERT(config_.num_envs > 0, "num_envs must be positive.");
+  ASSERT(config_.frame_skip > 0, "frame_skip must be positive.");
+
+  for (Instance& instance : instances_) {
+    PowerOn(instance);
+  }
+
+  // 呼び出し元のスレッドも処理に加わるので、ワーカーは1つ少なくてよい
+  unsigned num_threads = config_.num_threads != 0
+                             ? config_.num_threads
+                             : ThreadPool::GetHardwareConcurrency();
+  for (unsigned i = 1; i < num_threads && i < config_.num_envs; i++) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+VecEnv::~VecEnv() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  step_started_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void VecEnv::PowerOn(Instance& instance) {
+  instance.gb.reset();
+  instance.ram.clear();
+  instance.cartridge = std::make_unique<Cartridge>(rom_, &instance.ram);
+  instance.gb = std::make_unique<GameBoy>(instance.cartridge.get(), audio_);
+  instance.gb->CaptureSerialOutput();
+  ResetRenderInterval(instance);
+  instance.pressed_keys = 0;
+}
+
+void VecEnv::ResetRenderInterval(Instance& instance) {
+  if (config_.max_pool_frames) {
+    // 描画するフレームはStepInstanceで選ぶ
+    instance.gb->set_render_interval(1);
+  } else {
+    // 観測に使う、各Stepの最後のフレームだけを描画する
+    instance.gb->set_render_interval(config_.frame_skip);
+  }
+}
+
+void VecEnv::Reset(unsigned index, std::uint8_t* observation) {
+  ASSERT(index < instances_.size(), "Invalid index: %u", index);
+  PowerOn(instances_[index]);
+  WriteObservation(instances_[index], false, observation);
+}
+
+void VecEnv::ResetAll(std::uint8_t* observations) {
+  for (unsigned i = 0; i < instances_.size(); i++) {
+    Reset(i, observations + i * observation_size());
+  }
+}
+
+bool VecEnv::Reset(unsigned index, const std::vector<std::uint8_t>& state,
+                   std::uint8_t* observation) {
+  ASSERT(index < instances_.size(), "Invalid index: %u", index);
+  Instance& instance = instances_[index];
+  if (!instance.gb->LoadState(state)) {
+    return false;
+  }
+
+  // 次のStepで正しく差分をとれるよう、押しているキーを復元した状態に合わせる
+  instance.pressed_keys = GetPressedKeyMask(*instance.gb);
+  // 次のStepの最後のフレームを描画するように数え直す
+  ResetRenderInterval(instance);
+  WriteObservation(instance, false, observation);
+  return true;
+}
+
+void VecEnv::SaveState(unsigned index,
+                       std::vector<std::uint8_t>& buffer) const {
+  ASSERT(index < instances_.size(), "Invalid index: %u", index);
+  instances_[index].gb->SaveState(buffer);
+}
+
+void VecEnv::Step(const std::uint8_t* actions, std::uint8_t* observations) {
+  // ワーカーが参照する値は、処理の開始（next_index_のリセット）より前に設定する
+  actions_ = actions;
+  observations_ = observations;
+  num_finished_ = 0;
+  next_index_ = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+  }
+  step_started_.notify_all();
+
+  ProcessInstances();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  step_finished_.wait(lock,
+                      [this] { return num_finished_ == instances_.size(); });
+}
+
+void VecEnv::WorkerLoop() {
+  unsigned seen_generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      step_started_.wait(lock, [this, seen_generation] {
+        return is_stopping_ || generation_ != seen_generation;
+      });
+      if (is_stopping_) {
+        return;
+      }
+      seen_generation = generation_;
+    }
+    ProcessInstances();
+  }
+}
+
+void VecEnv::ProcessInstances() {
+  const unsigned num_envs = instances_.size();
+  for (;;) {
+    unsigned index = next_index_.fetch_add(1);
+    if (index >= num_envs) {
+      return;
+    }
+    StepInstance(index, actions_[index],
+                 observations_ + index * observation_size());
+    if (num_finished_.fetch_add(1) + 1 == num_envs) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      step_finished_.notify_all();
+    }
+  }
+}
+
+void VecEnv::StepInstance(unsigned index, std::uint8_t action,
+                          std::uint8_t* observation) {
+  Instance& instance = instances_[index];
+  GameBoy& gb = *instance.gb;
+
+  // 前回から変化したキーだけを押す/離す
+  std::uint8_t changed = action ^ instance.pressed_keys;
+  for (Joypad::Key key : kAllKeys) {
+    std::uint8_t mask = GetKeyMask(key);
+    if ((changed & mask) == 0) {
+      continue;
+    }
+    if (action & mask) {
+      gb.PressKey(key);
+    } else {
+      gb.ReleaseKey(key);
+    }
+  }
+  instance.pressed_keys = action;
+
+  for (unsigned i = 0; i < config_.frame_skip; i++) {
+    if (config_.max_pool_frames) {
+      // 最後の2フレームだけを描画し、最後のフレームに進む前に1つ目を写しておく
+      gb.set_video_enabled(i + 2 >= config_.frame_skip);
+      if (i + 1 == config_.frame_skip) {
+        instance.previous_frame = gb.GetPpuBuffer();
+      }
+    }
+    gb.Step();
+  }
+  WriteObservation(instance, true, observation);
+}
+
+void VecEnv::WriteObservation(const Instance& instance, bool pooled,
+                              std::uint8_t* observation) const {
+  // 画面を縮小してグレースケールにする
+  const GbLcdPixelMatrix* previous =
+      pooled && config_.max_pool_frames ? &instance.previous_frame : nullptr;
+  encoder_.Encode(instance.gb->GetPpuBuffer(), previous, observation);
+  std::uint8_t* dst = observation + screen_size();
+
+  // 指定したアドレスのメモリの値を続けて書き出す
+  for (std::uint16_t address : config_.ram_addresses) {
+    *dst++ = instance.gb->Read8(address);
+  }
+}
+
+}  // namespace gbemu
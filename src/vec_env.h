@@ -0,0 +1,163 @@
+#ifndef GBEMU_VEC_ENV_H_
+#define GBEMU_VEC_ENV_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "audio_sink.h"
+#include "cartridge.h"
+#include "gameboy.h"
+#include "key_input.h"
+#include "lcd.h"
+#include "observation.h"
+
+namespace gbemu {
+
+// 強化学習向けに、同じROMを動かす複数のGameBoyを歩調を揃えて進めるクラス。
+// 各インスタンスの観測（縮小したグレースケールの画面と指定したRAMの値）は、
+// 呼び出し側が用意した1つの連続したバッファに書き出す。
+// 画面の縮小とグレースケールへの変換はObservationEncoderで行う。
+// Step中にメモリの確保は行わない。
+// Example:
+//   VecEnv::Config config;
+//   config.num_envs = 64;
+//   VecEnv env(rom, config);
+//   std::vector<std::uint8_t> obs(config.num_envs * env.observation_size());
+//   std::vector<std::uint8_t> actions(config.num_envs);
+//   env.ResetAll(obs.data());
+//   for (;;) {
+//     ChooseActions(obs, actions);
+//     env.Step(actions.data(), obs.data());
+//   }
+class VecEnv {
+ public:
+  struct Config {
+    // インスタンスの数
+    unsigned num_envs{1};
+    // 1回のStepで進めるフレーム数
+    unsigned frame_skip{4};
+    // 観測する画面のサイズ
+    unsigned observation_width{84};
+    unsigned observation_height{84};
+    // 観測する画面の縮小の方法
+    ObservationEncoder::Filter observation_filter{
+        ObservationEncoder::Filter::kArea};
+    // trueなら各Stepの最後の2フレームのピクセルごとに暗い方をとって観測にする。
+    // 1フレームおきに点滅するObjectを観測から取りこぼさないようにする。
+    bool max_pool_frames{false};
+    // 観測に含めるメモリのアドレス（CPUから見たアドレス）
+    std::vector<std::uint16_t> ram_addresses{};
+    // ワーカースレッドの数。0ならハードウェアのスレッド数とする。
+    unsigned num_threads{0};
+  };
+
+  // ROMはインスタンス間で共有し、VecEnvより長く生存していなければならない。
+  VecEnv(const std::vector<std::uint8_t>& rom, const Config& config);
+  ~VecEnv();
+
+  VecEnv(const VecEnv&) = delete;
+  VecEnv& operator=(const VecEnv&) = delete;
+
+  // インスタンス1つ分の観測のバイト数。
+  // 画面（observation_width * observation_height）の後ろにRAMの値が続く。
+  std::size_t observation_size() const {
+    return screen_size() + config_.ram_addresses.size();
+  }
+
+  unsigned num_envs() const { return config_.num_envs; }
+
+  // 各インスタンスにキー入力を与えてframe_skipフレーム進め、観測を書き出す。
+  // actions[i]はi番目のインスタンスで押しているキーのビットマスクで、
+  // ビット位置はJoypad::Keyの値に対応する（GetKeyMaskを参照）。
+  // observationsはnum_envs * observation_sizeバイトの領域を指していること。
+  void Step(const std::uint8_t* actions, std::uint8_t* observations);
+
+  // index番目のインスタンスを電源投入直後の状態に戻し、観測を書き出す。
+  // observationはobservation_sizeバイトの領域を指していること。
+  void Reset(unsigned index, std::uint8_t* observation);
+
+  // すべてのインスタンスを電源投入直後の状態に戻し、観測を書き出す。
+  void ResetAll(std::uint8_t* observations);
+
+  // index番目のインスタンスをセーブステートの状態に戻し、観測を書き出す。
+  // 電源投入から始めるより速く、エピソードの開始位置を任意に選べる。
+  // セーブステートが不正ならインスタンスを変更せずにfalseを返す。
+  bool Reset(unsigned index, const std::vector<std::uint8_t>& state,
+             std::uint8_t* observation);
+
+  // index番目のインスタンスの現在の状態をセーブステートとして書き出す。
+  void SaveState(unsigned index, std::vector<std::uint8_t>& buffer) const;
+
+  // キーに対応するactionsのビットマスクを得る。
+  static std::uint8_t GetKeyMask(Joypad::Key key) {
+    return gbemu::GetKeyMask(key);
+  }
+
+ private:
+  // 1つのエミュレータのインスタンス。
+  struct Instance {
+    std::vector<std::uint8_t> ram;
+    std::unique_ptr<Cartridge> cartridge;
+    std::unique_ptr<GameBoy> gb;
+    // 現在押しているキーのビットマスク
+    std::uint8_t pressed_keys{};
+    // max_pool_framesのときに使う、最後から2番目のフレームの写し
+    GbLcdPixelMatrix previous_frame{};
+  };
+
+  std::size_t screen_size() const { return encoder_.size(); }
+
+  // インスタンスを電源投入直後の状態で作り直す。
+  void PowerOn(Instance& instance);
+
+  // 各Stepで観測に使うフレームだけを描画するように数え直す。
+  void ResetRenderInterval(Instance& instance);
+
+  // インスタンスを1回分進め、観測を書き出す。
+  void StepInstance(unsigned index, std::uint8_t action,
+                    std::uint8_t* observation);
+
+  // インスタンスの観測を書き出す。
+  // pooledがtrueならmax_pool_framesに従って直前のフレームと合わせる。
+  void WriteObservation(const Instance& instance, bool pooled,
+                        std::uint8_t* observation) const;
+
+  // ワーカースレッドの処理。
+  void WorkerLoop();
+
+  // 現在のStepで未処理のインスタンスがなくなるまで処理する。
+  void ProcessInstances();
+
+  const std::vector<std::uint8_t>& rom_;
+  Config config_;
+  std::vector<Instance> instances_;
+  NullAudioSink audio_;
+  ObservationEncoder encoder_;
+
+  // Stepの引数。ワーカースレッドから参照する。
+  const std::uint8_t* actions_{};
+  std::uint8_t* observations_{};
+
+  // 次に処理するインスタンスの番号と、処理を終えたインスタンスの数
+  std::atomic<unsigned> next_index_{0};
+  std::atomic<unsigned> num_finished_{0};
+
+  // ワーカースレッドの同期。
+  // Stepのたびにgeneration_を進めてワーカーを起こす。
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable step_started_;
+  std::condition_variable step_finished_;
+  unsigned generation_{0};
+  bool is_stopping_{false};
+};
+
+}  // namespace gbemu
+
+#endif  // GBEMU_VEC_ENV_H_
@@ -0,0 +1,91 @@
+#include "xor_delta.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "byte_io.h"
+
+namespace gbemu {
+
+namespace {
+
+// これより短い一致はゼロの連続として切り出さずに差分のバイト列に含める。
+constexpr std::size_t kMinZeroRun = 4;
+
+// aとbがi番目から一致している長さを求める。8バイトずつ比較する。
+std::size_t CountEqual(const std::uint8_t* a, const std::uint8_t* b,
+                       std::size_t i, std::size_t n) {
+  std::size_t begin = i;
+  while (i + 8 <= n) {
+    std::uint64_t x, y;
+    std::memcpy(&x, a + i, 8);
+    std::memcpy(&y, b + i, 8);
+    if (x != y) {
+      break;
+    }
+    i += 8;
+  }
+  while (i < n && a[i] == b[i]) {
+    i++;
+  }
+  return i - begin;
+}
+
+}  // namespace
+
+void EncodeXorDelta(const std::uint8_t* a, const std::uint8_t* b,
+                    std::size_t n, std::vector<std::uint8_t>& out) {
+  out.clear();
+  std::size_t i = 0;
+  while (i < n) {
+    std::size_t zero_run = CountEqual(a, b, i, n);
+    i += zero_run;
+    if (i == n) {
+      break;
+    }
+
+    // 十分に長い一致が現れるまでを非ゼロのバイト列とする
+    std::size_t literal_begin = i;
+    while (i < n) {
+      if (a[i] != b[i]) {
+        i++;
+        continue;
+      }
+      std::size_t equal = CountEqual(a, b, i, n);
+      if (equal >= kMinZeroRun || i + equal == n) {
+        break;
+      }
+      i += equal;
+    }
+
+    AppendVarint(out, zero_run);
+    AppendVarint(out, i - literal_begin);
+    for (std::size_t j = literal_begin; j < i; j++) {
+      out.push_back(a[j] ^ b[j]);
+    }
+  }
+}
+
+bool ApplyXorDelta(const std::uint8_t* delta, std::size_t delta_size,
+                   std::uint8_t* state, std::size_t n) {
+  const std::uint8_t* p = delta;
+  const std::uint8_t* end = p + delta_size;
+  std::size_t i = 0;
+  while (p < end) {
+    std::uint64_t zero_run, literal_size;
+    if (!ReadVarint(p, end, zero_run) || !ReadVarint(p, end, literal_size) ||
+        zero_run > n - i || literal_size > n - i - zero_run ||
+        literal_size > static_cast<std::size_t>(end - p)) {
+      return false;
+    }
+    i += zero_run;
+    for (std::size_t j = 0; j < literal_size; j++) {
+      state[i++] ^= *p++;
+    }
+  }
+  return true;
+}
+
+}  // namespace gbemu
@@ -0,0 +1,26 @@
+#ifndef GBEMU_XOR_DELTA_H_
+#define GBEMU_XOR_DELTA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gbemu {
+
+// 同じ大きさの2つのバイト列の差分の符号化。
+// 2つのXORをとり、（ゼロの長さ、非ゼロの長さ、非ゼロのバイト列）の繰り返しに
+// 詰める。長さはvarint（7ビットずつ下位から詰めた可変長整数）で書く。
+// 末尾のゼロの連続は書かない。ほとんど同じバイト列の差分はごく小さくなる。
+
+// aとbのnバイトの差分をoutに書き出す。outの元の内容は捨てる。
+void EncodeXorDelta(const std::uint8_t* a, const std::uint8_t* b,
+                    std::size_t n, std::vector<std::uint8_t>& out);
+
+// bの内容が入ったnバイトのstateに差分を適用してaに戻す。
+// 差分が壊れていたらfalseを返す（stateは途中まで書き換わる）。
+bool ApplyXorDelta(const std::uint8_t* delta, std::size_t delta_size,
+                   std::uint8_t* state, std::size_t n);
+
+}  // namespace gbemu
+
+#endif  // GBEMU_XOR_DELTA_H_
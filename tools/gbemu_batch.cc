@@ -0,0 +1,204 @@
+// ROMとキー入力スクリプトの組（ジョブ）をまとめてヘッドレスで実行するツール。
+//
+// マニフェストには1行に1つのジョブを次の形式で書く（#以降はコメント）。
+//   <rom_file> <frames> [<input_script>]
+// 相対パスはマニフェストのあるディレクトリを基準とし、
+// builtin:<name> はベンチマーク用に生成するROMを表す。
+//
+// キー入力スクリプトには1行に1つのイベントを次の形式で書く。
+//   <frame> press|release a|b|select|start|right|left|up|down
+// イベントは指定したフレームを進める直前に適用する。
+//
+// 各ジョブの結果（最終フレームのハッシュ値とシリアル出力）はJSON Linesで
+// 標準出力に書き出し、全体のスループットは標準エラー出力に書き出す。
+// ヘッダが不正なROMのジョブは実行せず、"error"を持つ行を書き出して
+// 終了コード1で終了する。
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "audio_sink.h"
+#include "cartridge.h"
+#include "frame_hash.h"
+#include "gameboy.h"
+#include "job_manifest.h"
+#include "joypad.h"
+#include "key_input.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+using namespace gbemu;
+
+namespace {
+
+using Job = ManifestJob;
+
+struct JobResult {
+  std::uint64_t frame_hash;
+  std::string serial_output;
+  double seconds;
+};
+
+JobResult RunJob(const Job& job) {
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::uint8_t> ram;
+  Cartridge cartridge(*job.rom, &ram);
+  NullAudioSink audio;
+  GameBoy gb(&cartridge, audio);
+  gb.CaptureSerialOutput();
+
+  std::size_t next_event = 0;
+  for (unsigned frame = 0; frame < job.frames; frame++) {
+    if (job.inputs != nullptr) {
+      ApplyInputEvents(*job.inputs, frame, next_event, gb);
+    }
+    gb.Step();
+  }
+
+  JobResult result;
+  result.frame_hash = HashFrame(gb.GetPpuBuffer());
+  result.serial_output = gb.GetSerialOutput();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  result.seconds = elapsed.count();
+  return result;
+}
+
+std::string ErrorToJson(const Job& job, const std::string& error) {
+  std::ostringstream oss;
+  oss << "{\"job\":" << job.id << ",\"rom\":\"" << EscapeJson(job.rom_path)
+      << "\",\"frames\":" << job.frames << ",\"error\":\""
+      << EscapeJson(error) << "\"}";
+  return oss.str();
+}
+
+std::string ResultToJson(const Job& job, const JobResult& result) {
+  std::ostringstream oss;
+  oss << "{\"job\":" << job.id << ",\"rom\":\"" << EscapeJson(job.rom_path)
+      << "\",\"frames\":" << job.frames << ",\"hash\":\""
+      << FrameHashToString(result.frame_hash) << "\",\"serial\":\""
+      << EscapeJson(result.serial_output) << "\",\"seconds\":" << result.seconds
+      << ",\"fps\":" << (job.frames / result.seconds) << "}";
+  return oss.str();
+}
+
+// すべてのジョブを指定したスレッド数で実行し、経過時間（秒）を返す。
+// print_resultsがtrueなら各ジョブの結果を完了した順に標準出力する。
+double RunJobs(const std::vector<Job>& jobs, unsigned num_threads,
+               bool print_results) {
+  std::mutex output_mutex;
+  auto start = std::chrono::steady_clock::now();
+  {
+    ThreadPool pool(num_threads);
+    for (const Job& job : jobs) {
+      pool.Submit([&job, &output_mutex, print_results] {
+        JobResult result = RunJob(job);
+        if (print_results) {
+          std::string json = ResultToJson(job, result);
+          std::lock_guard<std::mutex> lock(output_mutex);
+          std::cout << json << std::endl;
+        }
+      });
+    }
+    pool.Wait();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+[[noreturn]] void Usage() {
+  Error(
+      "Usage: gbemu-batch [--threads <n>] [--scaling] <manifest_file>\n"
+      "  --threads <n>  number of worker threads (default: all cores)\n"
+      "  --scaling      measure throughput with 1, 2, 4, ... threads");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  unsigned num_threads = ThreadPool::GetHardwareConcurrency();
+  bool scaling = false;
+  std::string manifest_path;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      num_threads = std::atoi(argv[++i]);
+      if (num_threads == 0) {
+        Usage();
+      }
+    } else if (arg == "--scaling") {
+      scaling = true;
+    } else if (manifest_path.empty() && arg[0] != '-') {
+      manifest_path = arg;
+    } else {
+      Usage();
+    }
+  }
+  if (manifest_path.empty()) {
+    Usage();
+  }
+
+  // ROMが不正だとワーカーのスレッドの中でプログラムが終了してしまうので、
+  // 先に調べて実行するジョブから外す
+  Manifest manifest(manifest_path);
+  std::vector<Job> jobs;
+  bool has_error = false;
+  for (const Job& job : manifest.jobs()) {
+    std::string error;
+    if (Cartridge::Validate(*job.rom, error)) {
+      jobs.push_back(job);
+    } else {
+      std::cout << ErrorToJson(job, error) << std::endl;
+      has_error = true;
+    }
+  }
+  if (jobs.empty()) {
+    return has_error ? 1 : 0;
+  }
+  std::uint64_t total_frames = 0;
+  for (const Job& job : jobs) {
+    total_frames += job.frames;
+  }
+
+  if (!scaling) {
+    double seconds = RunJobs(jobs, num_threads, true);
+    std::fprintf(stderr,
+                 "%zu jobs, %llu frames, %u threads: %.3f s, %.1f frames/s\n",
+                 jobs.size(), static_cast<unsigned long long>(total_frames),
+                 num_threads, seconds, total_frames / seconds);
+    return has_error ? 1 : 0;
+  }
+
+  // スレッド数を1から倍々に増やして（最後は指定した数で）スループットを測る
+  std::vector<unsigned> thread_counts;
+  for (unsigned n = 1; n < num_threads; n *= 2) {
+    thread_counts.push_back(n);
+  }
+  thread_counts.push_back(num_threads);
+
+  std::fprintf(stderr, "threads   seconds    frames/s  speedup  efficiency\n");
+  double base_fps = 0;
+  for (unsigned n : thread_counts) {
+    double seconds = RunJobs(jobs, n, false);
+    double fps = total_frames / seconds;
+    if (n == 1) {
+      base_fps = fps;
+    }
+    double speedup = fps / base_fps;
+    std::fprintf(stderr, "%7u %9.3f %11.1f %8.2f %10.2f\n", n, seconds, fps,
+                 speedup, speedup / n);
+    std::cout << "{\"threads\":" << n << ",\"seconds\":" << seconds
+              << ",\"fps\":" << fps << ",\"speedup\":" << speedup << "}"
+              << std::endl;
+  }
+  return has_error ? 1 : 0;
+}
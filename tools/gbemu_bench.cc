@@ -0,0 +1,295 @@
+// エミュレータの速度を計測するベンチマーク。
+//
+// 特定の処理に負荷をかける組み込みのROM（bench_roms.h）と、
+// 引数で指定したROM（Blarggのcpu_instrsなど）を
+// ウインドウを開かずに速度制限なしで指定フレーム数だけ動かし、
+// 1秒あたりのフレーム数と命令数、コンポーネントごとの処理時間の内訳を出力する。
+//
+// 速度は計測を挟まないGameBoy::Step()で測り、--repeat回のうち最速の値をとる。
+// 内訳は別にGameBoy::StepWithProfile()で動かして測る。
+// PPUのタイルのキャッシュのヒット率とフレームあたりのデコード回数も出力する。
+// --render-threadを指定すると、ピクセルの生成を別スレッドで行う。
+//
+// --json <file>を指定すると結果をJSON Lines（1行1ワークロード）で書き出す。
+// --compare <file>を指定すると、以前に書き出した結果と比べて
+// --threshold（%）を超えて遅くなったワークロードを報告し、終了コード1で終了する。
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "audio_sink.h"
+#include "bench_roms.h"
+#include "cartridge.h"
+#include "gameboy.h"
+#include "ppu.h"
+#include "step_profile.h"
+#include "utils.h"
+
+using namespace gbemu;
+
+namespace {
+
+struct BenchResult {
+  std::string name;
+  unsigned frames;
+  double fps;
+  // 1秒あたりの命令数
+  double ips;
+  // コンポーネントごとの処理時間の割合
+  double shares[StepProfile::kNumComponents];
+  // タイルのキャッシュのヒット率（タイルを引かなかったら負）と、
+  // 1フレームあたりのタイルのデコード回数
+  double tile_hit_rate;
+  double tile_decodes_per_frame;
+};
+
+// 時刻の取得1回あたりのコスト（ナノ秒）を測る。
+double MeasureClockOverheadNs() {
+  constexpr int kIterations = 1000000;
+  std::uint64_t start = ProfileClock::Now();
+  std::uint64_t last = start;
+  for (int i = 0; i < kIterations; i++) {
+    last = ProfileClock::Now();
+  }
+  return (last - start) * ProfileClock::GetNanosecondsPerTick() / kIterations;
+}
+
+BenchResult RunWorkload(const BenchRom& workload, unsigned frames,
+                        unsigned repeat, bool render_thread,
+                        double clock_overhead_ns) {
+  BenchResult result{workload.name, frames, 0, 0, {}, 0, 0};
+  NullAudioSink audio;
+
+  // 計測を挟まずに速度を測る
+  for (unsigned i = 0; i < repeat; i++) {
+    std::vector<std::uint8_t> ram;
+    Cartridge cartridge(workload.rom, &ram);
+    GameBoy gb(&cartridge, audio);
+    gb.CaptureSerialOutput();
+    gb.set_render_thread_enabled(render_thread);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned frame = 0; frame < frames; frame++) {
+      gb.Step();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    result.fps = std::max(result.fps, frames / elapsed.count());
+  }
+
+  // 内訳を測る。各区間には時刻の取得1回分のコストが含まれるので差し引く
+  std::vector<std::uint8_t> ram;
+  Cartridge cartridge(workload.rom, &ram);
+  GameBoy gb(&cartridge, audio);
+  gb.CaptureSerialOutput();
+  gb.set_render_thread_enabled(render_thread);
+  StepProfile profile;
+  for (unsigned frame = 0; frame < frames; frame++) {
+    gb.StepWithProfile(profile);
+  }
+  double times[StepProfile::kNumComponents];
+  double total = 0;
+  for (int i = 0; i < StepProfile::kNumComponents; i++) {
+    times[i] = std::max(0.0, profile.nanoseconds[i] -
+                                 profile.instructions * clock_overhead_ns);
+    total += times[i];
+  }
+  for (int i = 0; i < StepProfile::kNumComponents; i++) {
+    result.shares[i] = total > 0 ? times[i] / total : 0;
+  }
+  result.ips =
+      result.fps * static_cast<double>(profile.instructions) / profile.frames;
+
+  const Ppu::TileCacheStats& tile_stats = gb.GetTileCacheStats();
+  result.tile_hit_rate =
+      tile_stats.lookups > 0
+          ? 1 - static_cast<double>(tile_stats.decodes) / tile_stats.lookups
+          : -1;
+  result.tile_decodes_per_frame =
+      static_cast<double>(tile_stats.decodes) / frames;
+  return result;
+}
+
+std::string ResultToJson(const BenchResult& result) {
+  std::ostringstream oss;
+  oss << "{\"workload\":\"" << EscapeJson(result.name)
+      << "\",\"frames\":" << result.frames << ",\"fps\":" << result.fps
+      << ",\"ips\":" << result.ips;
+  for (int i = 0; i < StepProfile::kNumComponents; i++) {
+    oss << ",\""
+        << StepProfile::GetComponentName(
+               static_cast<StepProfile::Component>(i))
+        << "\":" << result.shares[i];
+  }
+  oss << ",\"tile_hit_rate\":" << result.tile_hit_rate
+      << ",\"tile_decodes_per_frame\":" << result.tile_decodes_per_frame
+      << "}";
+  return oss.str();
+}
+
+// JSONの1行から文字列または数値の値を取り出す。
+// このツールが書き出した形式だけを読めればよいので、キーを探すだけにする。
+bool FindJsonValue(const std::string& line, const std::string& key,
+                   std::string& value) {
+  std::string pattern = "\"" + key + "\":";
+  auto pos = line.find(pattern);
+  if (pos == std::string::npos) {
+    return false;
+  }
+  pos += pattern.size();
+  if (pos < line.size() && line[pos] == '"') {
+    auto end = line.find('"', pos + 1);
+    if (end == std::string::npos) {
+      return false;
+    }
+    value = line.substr(pos + 1, end - pos - 1);
+    return true;
+  }
+  auto end = line.find_first_of(",}", pos);
+  value = line.substr(pos, end - pos);
+  return true;
+}
+
+// 以前に書き出した結果を読み込み、ワークロード名からfpsを引く表を作る。
+std::map<std::string, double> LoadBaseline(const std::string& path) {
+  std::ifstream ifs(path);
+  if (ifs.fail()) {
+    Error("File cannot open: %s", path.c_str());
+  }
+  std::map<std::string, double> baseline;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    std::string name, fps;
+    if (FindJsonValue(line, "workload", name) &&
+        FindJsonValue(line, "fps", fps)) {
+      baseline[name] = std::atof(fps.c_str());
+    }
+  }
+  return baseline;
+}
+
+[[noreturn]] void Usage() {
+  Error(
+      "Usage: gbemu-bench [--frames <n>] [--repeat <n>] [--json <file>]\n"
+      "                   [--compare <file>] [--threshold <percent>]\n"
+      "                   [--render-thread] [<rom_file>...]\n"
+      "  --frames <n>           frames per workload (default: 600)\n"
+      "  --repeat <n>           runs per workload; the best is taken "
+      "(default: 3)\n"
+      "  --json <file>          write the results as JSON Lines\n"
+      "  --compare <file>       compare with results written by --json\n"
+      "  --threshold <percent>  slowdown reported as a regression "
+      "(default: 5)\n"
+      "  --render-thread        generate pixels on a separate thread");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  unsigned frames = 600;
+  unsigned repeat = 3;
+  double threshold = 5;
+  bool render_thread = false;
+  std::string json_path, baseline_path;
+  std::vector<std::string> rom_paths;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--frames" && has_value) {
+      frames = std::atoi(argv[++i]);
+    } else if (arg == "--repeat" && has_value) {
+      repeat = std::atoi(argv[++i]);
+    } else if (arg == "--json" && has_value) {
+      json_path = argv[++i];
+    } else if (arg == "--compare" && has_value) {
+      baseline_path = argv[++i];
+    } else if (arg == "--threshold" && has_value) {
+      threshold = std::atof(argv[++i]);
+    } else if (arg == "--render-thread") {
+      render_thread = true;
+    } else if (arg[0] != '-') {
+      rom_paths.push_back(arg);
+    } else {
+      Usage();
+    }
+  }
+  if (frames == 0 || repeat == 0) {
+    Usage();
+  }
+
+  std::vector<BenchRom> workloads = BuildBenchRoms();
+  for (const std::string& path : rom_paths) {
+    workloads.push_back(
+        {std::filesystem::path(path).stem().string(), LoadBinary(path)});
+  }
+
+  double clock_overhead_ns = MeasureClockOverheadNs();
+  std::printf("%-20s %7s %10s %8s", "workload", "frames", "fps", "MIPS");
+  for (int i = 0; i < StepProfile::kNumComponents; i++) {
+    std::printf(" %6s", StepProfile::GetComponentName(
+                            static_cast<StepProfile::Component>(i)));
+  }
+  std::printf(" %7s %9s\n", "tile hit", "decodes/f");
+
+  std::vector<BenchResult> results;
+  for (const BenchRom& workload : workloads) {
+    BenchResult result = RunWorkload(workload, frames, repeat, render_thread,
+                                     clock_overhead_ns);
+    std::printf("%-20s %7u %10.1f %8.2f", result.name.c_str(), result.frames,
+                result.fps, result.ips / 1e6);
+    for (double share : result.shares) {
+      std::printf(" %5.1f%%", share * 100);
+    }
+    if (result.tile_hit_rate >= 0) {
+      std::printf(" %7.1f%% %9.1f\n", result.tile_hit_rate * 100,
+                  result.tile_decodes_per_frame);
+    } else {
+      std::printf(" %8s %9s\n", "-", "-");
+    }
+    std::fflush(stdout);
+    results.push_back(result);
+  }
+  std::printf("(cpu includes memory accesses made by the CPU)\n");
+  std::printf("(tile cache: %zu bytes)\n", Ppu::GetTileCacheSize());
+
+  if (!json_path.empty()) {
+    std::ofstream ofs(json_path);
+    if (ofs.fail()) {
+      Error("File cannot open: %s", json_path.c_str());
+    }
+    for (const BenchResult& result : results) {
+      ofs << ResultToJson(result) << "\n";
+    }
+  }
+
+  if (baseline_path.empty()) {
+    return 0;
+  }
+  std::map<std::string, double> baseline = LoadBaseline(baseline_path);
+  bool has_regression = false;
+  std::printf("\n%-20s %10s %10s %8s\n", "workload", "baseline", "fps",
+              "change");
+  for (const BenchResult& result : results) {
+    auto i = baseline.find(result.name);
+    if (i == baseline.end() || i->second <= 0) {
+      std::printf("%-20s %10s %10.1f %8s\n", result.name.c_str(), "-",
+                  result.fps, "new");
+      continue;
+    }
+    double change = (result.fps / i->second - 1) * 100;
+    bool is_regression = change < -threshold;
+    has_regression |= is_regression;
+    std::printf("%-20s %10.1f %10.1f %+7.1f%%%s\n", result.name.c_str(),
+                i->second, result.fps, change,
+                is_regression ? "  REGRESSION" : "");
+  }
+  return has_regression ? 1 : 0;
+}
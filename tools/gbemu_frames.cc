@@ -0,0 +1,144 @@
+// 画面の記録（gbemu --record-framesなどが書き出すもの）を扱うツール。
+//
+// info:   フレーム数、キーフレームの数と1フレームあたりのバイト数を表示する。
+// to-png: フレームを連番のPNG（frame_000000.png、...）として書き出す。
+//         --start、--count、--stepで書き出すフレームを選ぶ。
+// 形式はframe_record.hを参照。
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "frame_hash.h"
+#include "frame_record.h"
+#include "lcd.h"
+#include "png_writer.h"
+#include "utils.h"
+
+using namespace gbemu;
+
+namespace {
+
+[[noreturn]] void Usage() {
+  Error(
+      "Usage:\n"
+      "  gbemu-frames info <record_file>\n"
+      "  gbemu-frames to-png [--start <n>] [--count <n>] [--step <n>]\n"
+      "                      <record_file> <out_dir>");
+}
+
+// 記録を開く。開けないか形式が違えばプログラムを終了する。
+void OpenRecord(const std::string& path, std::ifstream& ifs,
+                FrameRecordReader& reader) {
+  if (ifs.fail()) {
+    Error("File cannot open: %s", path.c_str());
+  }
+  if (!reader.Open()) {
+    Error("Invalid frame record: %s", path.c_str());
+  }
+  if (!reader.is_complete()) {
+    WarnUser("The frame record has no index (truncated?): %s", path.c_str());
+  }
+}
+
+int Info(int argc, char* argv[]) {
+  if (argc != 3) {
+    Usage();
+  }
+  std::string path = argv[2];
+  std::ifstream ifs(path, std::ios::binary);
+  FrameRecordReader reader(ifs);
+  OpenRecord(path, ifs, reader);
+
+  // 最後まで復号して、壊れていないことも確かめる
+  GbLcdPixelMatrix frame;
+  std::uint64_t hash = 0;
+  for (std::uint64_t i = 0; i < reader.num_frames(); i++) {
+    if (!reader.Read(i, frame)) {
+      Error("The frame record is corrupted at frame %llu.",
+            static_cast<unsigned long long>(i));
+    }
+    hash = HashFrame(frame);
+  }
+
+  std::uint64_t bytes = std::filesystem::file_size(path);
+  std::uint64_t frames = reader.num_frames();
+  std::printf("frames:          %llu\n",
+              static_cast<unsigned long long>(frames));
+  std::printf("keyframes:       %zu\n", reader.num_keyframes());
+  std::printf("bytes:           %llu\n",
+              static_cast<unsigned long long>(bytes));
+  if (frames != 0) {
+    std::printf("bytes per frame: %.1f (raw 2bpp: %d)\n",
+                static_cast<double>(bytes) / frames, lcd::kTotalPixelNum / 4);
+    std::printf("last frame hash: %s\n", FrameHashToString(hash).c_str());
+  }
+  return 0;
+}
+
+int ToPng(int argc, char* argv[]) {
+  std::string record_path, out_dir;
+  std::uint64_t start = 0;
+  std::uint64_t count = UINT64_MAX;
+  std::uint64_t step = 1;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--start" && i + 1 < argc) {
+      start = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--count" && i + 1 < argc) {
+      count = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--step" && i + 1 < argc) {
+      step = std::strtoull(argv[++i], nullptr, 10);
+    } else if (record_path.empty() && arg[0] != '-') {
+      record_path = arg;
+    } else if (out_dir.empty() && arg[0] != '-') {
+      out_dir = arg;
+    } else {
+      Usage();
+    }
+  }
+  if (record_path.empty() || out_dir.empty() || step == 0) {
+    Usage();
+  }
+
+  std::ifstream ifs(record_path, std::ios::binary);
+  FrameRecordReader reader(ifs);
+  OpenRecord(record_path, ifs, reader);
+  std::filesystem::create_directories(out_dir);
+
+  GbLcdPixelMatrix frame;
+  unsigned written = 0;
+  for (std::uint64_t i = start; i < reader.num_frames() && written < count;
+       i += step) {
+    if (!reader.Read(i, frame)) {
+      Error("The frame record is corrupted at frame %llu.",
+            static_cast<unsigned long long>(i));
+    }
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%06llu.png",
+                  static_cast<unsigned long long>(i));
+    WriteFramePng((std::filesystem::path(out_dir) / name).string(), frame);
+    written++;
+  }
+  std::printf("%u frames written to %s\n", written, out_dir.c_str());
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    Usage();
+  }
+  std::string command = argv[1];
+  if (command == "info") {
+    return Info(argc, argv);
+  }
+  if (command == "to-png") {
+    return ToPng(argc, argv);
+  }
+  Usage();
+}
@@ -0,0 +1,294 @@
+// 画面のハッシュ値をゴールデン（期待値）と照合する回帰テストのツール。
+//
+// マニフェスト（gbemu-batchと同じ形式）のジョブをヘッドレスで実行し、
+// 毎フレームの画面のハッシュ値（HashFrame）をゴールデンファイルと比べる。
+// 高速化のための変更で画面の出力が1ピクセルでも変わっていないかを確かめるためのもの。
+// --updateを指定するとゴールデンファイルを今の出力で書き直す。
+//
+// ゴールデンファイルには1行に1つのジョブを次の形式で書く。
+//   <rom_file> <frames> <フレーム0のハッシュ値> <フレーム1のハッシュ値> ...
+//
+// 結果はジョブごとにJSON Linesで標準出力に、集計は標準エラー出力に書き出し、
+// 一致しなかったジョブがあれば終了コード1で終了する。
+// --dump-dirを指定すると、最初に一致しなかったフレームをPNGで書き出す。
+// --render-intervalを指定するとnフレームごとに1フレームだけ描画して
+// （GameBoy::set_render_interval）、描画したフレームだけを照合する。
+// 描画を省いても描画したフレームの画面が変わらないことを確かめるためのもの。
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "audio_sink.h"
+#include "cartridge.h"
+#include "frame_hash.h"
+#include "gameboy.h"
+#include "job_manifest.h"
+#include "key_input.h"
+#include "png_writer.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+using namespace gbemu;
+
+namespace {
+
+// 1つのジョブのゴールデン
+struct Golden {
+  std::string rom_path;
+  std::vector<std::uint64_t> frame_hashes;
+};
+
+struct JobResult {
+  std::vector<std::uint64_t> frame_hashes;
+  // 最初に一致しなかったフレーム（一致したら-1）
+  int first_mismatch{-1};
+  // 書き出したPNGのパス
+  std::string png_path;
+};
+
+// ゴールデンファイルを読み込む。読み込みに失敗したらプログラムを終了する。
+std::vector<Golden> LoadGoldens(const std::string& path) {
+  std::ifstream ifs(path);
+  if (ifs.fail()) {
+    Error("File cannot open: %s", path.c_str());
+  }
+  std::vector<Golden> goldens;
+  std::string line;
+  unsigned line_number = 0;
+  while (std::getline(ifs, line)) {
+    line_number++;
+    std::istringstream iss(line);
+    Golden golden;
+    unsigned frames;
+    if (!(iss >> golden.rom_path)) {
+      continue;  // 空行
+    }
+    if (!(iss >> frames)) {
+      Error("Invalid golden file: %s:%u", path.c_str(), line_number);
+    }
+    std::string hash;
+    while (iss >> hash) {
+      golden.frame_hashes.push_back(std::strtoull(hash.c_str(), nullptr, 16));
+    }
+    if (golden.frame_hashes.size() != frames) {
+      Error("Invalid golden file: %s:%u", path.c_str(), line_number);
+    }
+    goldens.push_back(std::move(golden));
+  }
+  return goldens;
+}
+
+void SaveGoldens(const std::string& path, const std::vector<Golden>& goldens) {
+  std::ofstream ofs(path);
+  if (ofs.fail()) {
+    Error("File cannot open: %s", path.c_str());
+  }
+  for (const Golden& golden : goldens) {
+    ofs << golden.rom_path << ' ' << golden.frame_hashes.size();
+    for (std::uint64_t hash : golden.frame_hashes) {
+      ofs << ' ' << FrameHashToString(hash);
+    }
+    ofs << '\n';
+  }
+}
+
+// ジョブを実行して毎フレームのハッシュ値を記録する。
+// expectedがnullptrでなければ照合し、dump_pathが空でなければ
+// 最初に一致しなかったフレームをPNGで書き出す。
+// render_intervalフレームごとに1フレームだけ描画し、描画しなかったフレームは
+// 照合しない（ハッシュ値にはゴールデンの値を入れておく）。
+JobResult RunJob(const ManifestJob& job, const Golden* expected,
+                 const std::string& dump_path, unsigned render_interval) {
+  std::vector<std::uint8_t> ram;
+  Cartridge cartridge(*job.rom, &ram);
+  NullAudioSink audio;
+  GameBoy gb(&cartridge, audio);
+  gb.CaptureSerialOutput();
+  gb.set_render_interval(render_interval);
+
+  JobResult result;
+  result.frame_hashes.reserve(job.frames);
+  std::size_t next_event = 0;
+  for (unsigned frame = 0; frame < job.frames; frame++) {
+    if (job.inputs != nullptr) {
+      ApplyInputEvents(*job.inputs, frame, next_event, gb);
+    }
+    gb.Step();
+    if (!gb.is_frame_rendered()) {
+      ASSERT(expected != nullptr, "Every frame is rendered when updating.");
+      result.frame_hashes.push_back(frame < expected->frame_hashes.size()
+                                        ? expected->frame_hashes[frame]
+                                        : 0);
+      continue;
+    }
+    std::uint64_t hash = HashFrame(gb.GetPpuBuffer());
+    result.frame_hashes.push_back(hash);
+    if (expected != nullptr && result.first_mismatch < 0 &&
+        (frame >= expected->frame_hashes.size() ||
+         expected->frame_hashes[frame] != hash)) {
+      result.first_mismatch = frame;
+      if (!dump_path.empty()) {
+        WriteFramePng(dump_path, gb.GetPpuBuffer());
+        result.png_path = dump_path;
+      }
+    }
+  }
+  if (expected != nullptr && result.first_mismatch < 0 &&
+      expected->frame_hashes.size() != job.frames) {
+    result.first_mismatch = job.frames;  // ゴールデンの方が長い
+  }
+  return result;
+}
+
+std::string ResultToJson(const ManifestJob& job, const Golden& expected,
+                         const JobResult& result) {
+  std::ostringstream oss;
+  oss << "{\"job\":" << job.id << ",\"rom\":\"" << EscapeJson(job.rom_path)
+      << "\",\"frames\":" << job.frames << ",\"status\":\""
+      << (result.first_mismatch < 0 ? "ok" : "mismatch") << "\"";
+  if (result.first_mismatch >= 0) {
+    unsigned frame = result.first_mismatch;
+    oss << ",\"first_mismatch\":" << frame << ",\"expected\":\""
+        << (frame < expected.frame_hashes.size()
+                ? FrameHashToString(expected.frame_hashes[frame])
+                : "")
+        << "\",\"actual\":\""
+        << (frame < result.frame_hashes.size()
+                ? FrameHashToString(result.frame_hashes[frame])
+                : "")
+        << "\"";
+    if (!result.png_path.empty()) {
+      oss << ",\"png\":\"" << EscapeJson(result.png_path) << "\"";
+    }
+  }
+  oss << "}";
+  return oss.str();
+}
+
+[[noreturn]] void Usage() {
+  Error(
+      "Usage: gbemu-golden [options] <manifest_file> <golden_file>\n"
+      "  --update          rewrite the golden file with the current output\n"
+      "  --dump-dir <dir>  write the first mismatching frame of each job as "
+      "PNG\n"
+      "  --threads <n>     number of worker threads (default: all cores)\n"
+      "  --render-interval <n>\n"
+      "                    render every nth frame and check only those");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  bool update = false;
+  std::string dump_dir;
+  unsigned num_threads = ThreadPool::GetHardwareConcurrency();
+  unsigned render_interval = 1;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--update") {
+      update = true;
+    } else if (arg == "--dump-dir" && has_value) {
+      dump_dir = argv[++i];
+    } else if (arg == "--threads" && has_value) {
+      num_threads = std::atoi(argv[++i]);
+      if (num_threads == 0) {
+        Usage();
+      }
+    } else if (arg == "--render-interval" && has_value) {
+      render_interval = std::atoi(argv[++i]);
+      if (render_interval == 0) {
+        Usage();
+      }
+    } else if (arg[0] != '-') {
+      paths.push_back(arg);
+    } else {
+      Usage();
+    }
+  }
+  if (paths.size() != 2 || (update && render_interval != 1)) {
+    Usage();
+  }
+  const std::string& manifest_path = paths[0];
+  const std::string& golden_path = paths[1];
+
+  Manifest manifest(manifest_path);
+  const std::vector<ManifestJob>& jobs = manifest.jobs();
+  std::vector<Golden> goldens;
+  if (!update) {
+    goldens = LoadGoldens(golden_path);
+    if (goldens.size() != jobs.size()) {
+      Error("The golden file has %zu jobs but the manifest has %zu.",
+            goldens.size(), jobs.size());
+    }
+    for (std::size_t i = 0; i < jobs.size(); i++) {
+      if (goldens[i].rom_path != jobs[i].rom_path) {
+        Error("Job %zu is %s in the golden file but %s in the manifest.", i,
+              goldens[i].rom_path.c_str(), jobs[i].rom_path.c_str());
+      }
+    }
+    if (!dump_dir.empty()) {
+      std::filesystem::create_directories(dump_dir);
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<JobResult> results(jobs.size());
+  {
+    ThreadPool pool(num_threads);
+    for (std::size_t i = 0; i < jobs.size(); i++) {
+      pool.Submit([&, i] {
+        const Golden* expected = update ? nullptr : &goldens[i];
+        std::string dump_path;
+        if (expected != nullptr && !dump_dir.empty()) {
+          std::string stem =
+              std::filesystem::path(jobs[i].rom_path).stem().string();
+          std::replace(stem.begin(), stem.end(), ':', '_');  // builtin:<name>
+          dump_path = (std::filesystem::path(dump_dir) /
+                       ("job" + std::to_string(i) + "_" + stem + ".png"))
+                          .string();
+        }
+        results[i] = RunJob(jobs[i], expected, dump_path, render_interval);
+      });
+    }
+    pool.Wait();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  if (update) {
+    std::vector<Golden> new_goldens;
+    for (std::size_t i = 0; i < jobs.size(); i++) {
+      new_goldens.push_back(
+          Golden{jobs[i].rom_path, std::move(results[i].frame_hashes)});
+    }
+    SaveGoldens(golden_path, new_goldens);
+    std::fprintf(stderr, "%zu jobs written to %s in %.3f s\n", jobs.size(),
+                 golden_path.c_str(), elapsed.count());
+    return 0;
+  }
+
+  unsigned num_ok = 0;
+  for (std::size_t i = 0; i < jobs.size(); i++) {
+    std::cout << ResultToJson(jobs[i], goldens[i], results[i]) << "\n";
+    if (results[i].first_mismatch < 0) {
+      num_ok++;
+    }
+  }
+  std::cout << std::flush;
+  std::fprintf(stderr, "%u/%zu jobs match in %.3f s\n", num_ok, jobs.size(),
+               elapsed.count());
+  return num_ok == jobs.size() ? 0 : 1;
+}
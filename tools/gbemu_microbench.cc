@@ -0,0 +1,285 @@
+// 描画などの小さなカーネルの実装を比べるマイクロベンチマーク。
+// タイルの行のデコード（tile_decode.h）、レイヤの合成（line_composite.h）、
+// 観測の作成（observation.h）を計測する。
+//
+// 各カーネルの実装ごとに、まず基準となるスカラー実装と全入力で結果が
+// 一致することを確かめ、次に1回の呼び出しにかかる時間を計測する。
+// 一致しない実装があれば終了コード1で終了する。
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "lcd.h"
+#include "line_composite.h"
+#include "observation.h"
+#include "tile_decode.h"
+#include "utils.h"
+
+using namespace gbemu;
+
+namespace {
+
+using TileDecoder = PackedTileRow (*)(std::uint8_t, std::uint8_t);
+
+struct TileDecoderEntry {
+  const char* name;
+  TileDecoder decode;
+};
+
+// 計測結果を捨てられないようにするための書き込み先
+volatile std::uint64_t g_sink;
+
+// タイルの行のデコーダをすべての入力で基準の実装と比べる。
+bool VerifyTileDecoder(TileDecoder decode) {
+  for (unsigned lower = 0; lower < 256; lower++) {
+    for (unsigned upper = 0; upper < 256; upper++) {
+      if (decode(lower, upper) != DecodeTileRowScalar(lower, upper)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// 1回のデコードにかかる時間（ナノ秒）を計測する。
+// 入力はVRAMの内容に近づけるために疑似乱数で作る。
+double MeasureTileDecoder(TileDecoder decode, unsigned iterations) {
+  std::vector<std::uint8_t> tiles(8192);
+  std::uint32_t state = 1;
+  for (std::uint8_t& byte : tiles) {
+    state = state * 1103515245 + 12345;
+    byte = state >> 16;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::uint64_t sum = 0;
+  for (unsigned i = 0; i < iterations; i++) {
+    for (std::size_t j = 0; j < tiles.size(); j += 2) {
+      sum += decode(tiles[j], tiles[j + 1]);
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  g_sink = sum;
+  return elapsed.count() / (static_cast<double>(iterations) * tiles.size() / 2);
+}
+
+using LineCompositor = void (*)(const LinePlanes&, const LinePalettes&,
+                                GbLcdPixelRow&);
+
+struct LineCompositorEntry {
+  const char* name;
+  LineCompositor composite;
+};
+
+// 合成の入力になる疑似乱数のラインを作る。
+// 各レイヤのピクセルの有無とカラーID、Objectの属性とパレットをばらつかせる。
+struct RandomLine {
+  LinePlanes planes;
+  LinePalettes palettes;
+};
+
+std::vector<RandomLine> MakeRandomLines(std::size_t n) {
+  std::uint32_t state = 1;
+  auto next = [&state] {
+    state = state * 1103515245 + 12345;
+    return static_cast<std::uint8_t>(state >> 16);
+  };
+  std::vector<RandomLine> lines(n);
+  for (RandomLine& line : lines) {
+    for (int x = 0; x < lcd::kWidth; x++) {
+      line.planes.background_ids[x] = next() & 3;
+      line.planes.background_mask[x] = (next() & 7) != 0 ? 0xFF : 0x00;
+      line.planes.object_ids[x] = (next() & 1) != 0 ? next() & 3 : 0;
+      line.planes.object_attributes[x] = next() & 0xF0;
+    }
+    line.palettes = LinePalettes{DecodePalette(next()), DecodePalette(next()),
+                                 DecodePalette(next())};
+  }
+  return lines;
+}
+
+// 合成の実装を疑似乱数のラインで基準の実装と比べる。
+bool VerifyLineCompositor(LineCompositor composite,
+                          const std::vector<RandomLine>& lines) {
+  for (const RandomLine& line : lines) {
+    GbLcdPixelRow expected, actual;
+    CompositeLineScalar(line.planes, line.palettes, expected);
+    composite(line.planes, line.palettes, actual);
+    if (expected != actual) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 1ラインの合成にかかる時間（ナノ秒）を計測する。
+double MeasureLineCompositor(LineCompositor composite,
+                             const std::vector<RandomLine>& lines,
+                             unsigned iterations) {
+  GbLcdPixelRow out;
+  auto start = std::chrono::steady_clock::now();
+  std::uint64_t sum = 0;
+  for (unsigned i = 0; i < iterations; i++) {
+    for (const RandomLine& line : lines) {
+      composite(line.planes, line.palettes, out);
+      sum += out[i % lcd::kWidth];
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  g_sink = sum;
+  return elapsed.count() / (static_cast<double>(iterations) * lines.size());
+}
+
+using ObservationKernel = void (ObservationEncoder::*)(
+    const GbLcdPixelMatrix&, const GbLcdPixelMatrix*, std::uint8_t*) const;
+
+struct ObservationKernelEntry {
+  const char* name;
+  ObservationKernel encode;
+};
+
+// 観測の作成の条件。
+struct ObservationCase {
+  const char* name;
+  unsigned width;
+  unsigned height;
+  ObservationEncoder::Filter filter;
+  bool max_pool;
+};
+
+// 疑似乱数の色で埋めたフレームを作る。
+GbLcdPixelMatrix MakeRandomFrame(std::uint32_t seed) {
+  GbLcdPixelMatrix frame;
+  for (GbLcdPixelRow& row : frame) {
+    for (lcd::GbLcdColor& color : row) {
+      seed = seed * 1103515245 + 12345;
+      color = static_cast<lcd::GbLcdColor>((seed >> 16) & 3);
+    }
+  }
+  return frame;
+}
+
+// 観測の作成の実装を基準の実装と比べ、1フレームにかかる時間（ナノ秒）を
+// 計測する。
+double MeasureObservationKernel(const ObservationEncoder& encoder,
+                                ObservationKernel encode,
+                                const GbLcdPixelMatrix& frame,
+                                const GbLcdPixelMatrix* previous,
+                                unsigned iterations, bool& ok) {
+  std::vector<std::uint8_t> expected(encoder.size()), actual(encoder.size());
+  encoder.EncodeScalar(frame, previous, expected.data());
+  (encoder.*encode)(frame, previous, actual.data());
+  ok = expected == actual;
+
+  auto start = std::chrono::steady_clock::now();
+  std::uint64_t sum = 0;
+  for (unsigned i = 0; i < iterations; i++) {
+    (encoder.*encode)(frame, previous, actual.data());
+    sum += actual[i % actual.size()];
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  g_sink = sum;
+  return elapsed.count() / iterations;
+}
+
+[[noreturn]] void Usage() {
+  Error("Usage: gbemu-microbench [--iterations <n>]");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  unsigned iterations = 2000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      iterations = std::atoi(argv[++i]);
+      if (iterations == 0) {
+        Usage();
+      }
+    } else {
+      Usage();
+    }
+  }
+
+  const std::vector<TileDecoderEntry> tile_decoders = {
+    {"scalar", DecodeTileRowScalar},
+    {"lut", DecodeTileRowLut},
+#ifdef GBEMU_TILE_DECODE_SSE2
+    {"sse2", DecodeTileRowSse2},
+#endif
+    {"default", DecodeTileRow},
+  };
+
+  bool all_ok = true;
+  std::printf("%-24s %10s %8s\n", "kernel", "ns/call", "verify");
+  for (const TileDecoderEntry& entry : tile_decoders) {
+    bool ok = VerifyTileDecoder(entry.decode);
+    all_ok = all_ok && ok;
+    double ns = MeasureTileDecoder(entry.decode, iterations);
+    std::printf("%-24s %10.3f %8s\n",
+                ("tile_decode/" + std::string(entry.name)).c_str(), ns,
+                ok ? "ok" : "MISMATCH");
+  }
+
+  const std::vector<LineCompositorEntry> line_compositors = {
+    {"scalar", CompositeLineScalar},
+#ifdef GBEMU_LINE_COMPOSITE_SSE2
+    {"sse2", CompositeLineSse2},
+#endif
+    {"default", CompositeLine},
+  };
+  // 1フレーム分のライン数の疑似乱数のラインを使う
+  std::vector<RandomLine> lines = MakeRandomLines(lcd::kHeight);
+  for (const LineCompositorEntry& entry : line_compositors) {
+    bool ok = VerifyLineCompositor(entry.composite, lines);
+    all_ok = all_ok && ok;
+    double ns = MeasureLineCompositor(entry.composite, lines, iterations / 10);
+    std::printf("%-24s %10.3f %8s\n",
+                ("composite_line/" + std::string(entry.name)).c_str(), ns,
+                ok ? "ok" : "MISMATCH");
+  }
+
+  const std::vector<ObservationKernelEntry> observation_kernels = {
+    {"scalar", &ObservationEncoder::EncodeScalar},
+#ifdef GBEMU_OBSERVATION_SSE2
+    {"sse2", &ObservationEncoder::EncodeSse2},
+#endif
+    {"default", &ObservationEncoder::Encode},
+  };
+  const std::vector<ObservationCase> observation_cases = {
+    {"area84", 84, 84, ObservationEncoder::Filter::kArea, false},
+    {"area84_pool", 84, 84, ObservationEncoder::Filter::kArea, true},
+    {"area80x72", 80, 72, ObservationEncoder::Filter::kArea, false},
+    {"nearest84_pool", 84, 84, ObservationEncoder::Filter::kNearest, true},
+  };
+  GbLcdPixelMatrix frame = MakeRandomFrame(1);
+  GbLcdPixelMatrix previous = MakeRandomFrame(2);
+  for (const ObservationCase& c : observation_cases) {
+    ObservationEncoder::Config config;
+    config.width = c.width;
+    config.height = c.height;
+    config.filter = c.filter;
+    ObservationEncoder encoder(config);
+    for (const ObservationKernelEntry& entry : observation_kernels) {
+      bool ok;
+      double ns = MeasureObservationKernel(
+          encoder, entry.encode, frame, c.max_pool ? &previous : nullptr,
+          iterations / 10, ok);
+      all_ok = all_ok && ok;
+      std::printf("%-24s %10.3f %8s\n",
+                  ("observation/" + std::string(c.name) + "/" + entry.name)
+                      .c_str(),
+                  ns, ok ? "ok" : "MISMATCH");
+    }
+  }
+  return all_ok ? 0 : 1;
+}
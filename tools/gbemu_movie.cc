@@ -0,0 +1,247 @@
+// キー入力のムービーを記録・再生するツール。
+//
+// record: キー入力スクリプト（gbemu-batchと同じ形式）に従ってヘッドレスで動かし、
+//         ムービーに記録する。--start-frameを指定すると、そのフレームまで進めた
+//         状態をセーブステートとして埋め込み、そこから記録する。
+// play:   ムービーを再生し、最終フレームのハッシュ値と処理速度をJSONで出力する。
+//         --verifyを指定すると記録されたハッシュ値と毎フレーム照合し、
+//         一致しなければ終了コード1で終了する。
+//         --recordと--record-audioを指定すると、再生した画面と音を
+//         Y4M（またはRGB24）とWAVで書き出す。--record-framesを指定すると、
+//         画面を2ビットの差分の形式（frame_record.hを参照）で書き出す。
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "audio_sink.h"
+#include "av_recorder.h"
+#include "cartridge.h"
+#include "frame_hash.h"
+#include "frame_record.h"
+#include "gameboy.h"
+#include "key_input.h"
+#include "movie.h"
+#include "utils.h"
+
+using namespace gbemu;
+
+namespace {
+
+[[noreturn]] void Usage() {
+  Error(
+      "Usage:\n"
+      "  gbemu-movie record --rom <rom_file> --frames <n> --out <movie_file>\n"
+      "                     [--input <input_script>] [--start-frame <n>]\n"
+      "                     [--hash-interval <n>]\n"
+      "  gbemu-movie play --rom <rom_file> [--verify] [--record <file|->]\n"
+      "                   [--record-format y4m|rgb] [--record-audio <wav>]\n"
+      "                   [--record-frames <file>] <movie_file>");
+}
+
+int Record(int argc, char* argv[]) {
+  std::string rom_path, out_path, script_path;
+  unsigned frames = 0;
+  unsigned start_frame = 0;
+  unsigned hash_interval = 1;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 == argc) {
+      Usage();
+    }
+    if (arg == "--rom") {
+      rom_path = argv[++i];
+    } else if (arg == "--frames") {
+      frames = std::atoi(argv[++i]);
+    } else if (arg == "--out") {
+      out_path = argv[++i];
+    } else if (arg == "--input") {
+      script_path = argv[++i];
+    } else if (arg == "--start-frame") {
+      start_frame = std::atoi(argv[++i]);
+    } else if (arg == "--hash-interval") {
+      hash_interval = std::atoi(argv[++i]);
+    } else {
+      Usage();
+    }
+  }
+  if (rom_path.empty() || out_path.empty() || frames == 0) {
+    Usage();
+  }
+
+  std::vector<std::uint8_t> rom = LoadBinary(rom_path);
+  InputScript script;
+  if (!script_path.empty()) {
+    script = LoadInputScript(script_path);
+  }
+  std::vector<std::uint8_t> ram;
+  Cartridge cartridge(rom, &ram);
+  NullAudioSink audio;
+  GameBoy gb(&cartridge, audio);
+  gb.CaptureSerialOutput();
+
+  // 開始フレームまで進めて、その状態から記録する
+  std::size_t next_event = 0;
+  unsigned frame = 0;
+  for (; frame < start_frame; frame++) {
+    ApplyInputEvents(script, frame, next_event, gb);
+    gb.Step();
+  }
+  std::vector<std::uint8_t> start_state;
+  if (start_frame != 0) {
+    start_state = gb.SaveState();
+  }
+
+  std::ofstream ofs(out_path, std::ios::binary);
+  if (ofs.fail()) {
+    Error("File cannot open: %s", out_path.c_str());
+  }
+  MovieRecorder recorder(ofs, rom, start_state, hash_interval);
+  for (; frame < start_frame + frames; frame++) {
+    ApplyInputEvents(script, frame, next_event, gb);
+    recorder.BeginFrame(gb);
+    gb.Step();
+    recorder.EndFrame(gb);
+  }
+  recorder.Finish();
+  std::printf("{\"frames\":%u,\"hash\":\"%s\",\"bytes\":%lld}\n", frames,
+              FrameHashToString(HashFrame(gb.GetPpuBuffer())).c_str(),
+              static_cast<long long>(ofs.tellp()));
+  return 0;
+}
+
+int Play(int argc, char* argv[]) {
+  std::string rom_path, movie_path;
+  bool verify = false;
+  AvRecorder::Config record_config;
+  std::string frames_path;
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--rom" && i + 1 < argc) {
+      rom_path = argv[++i];
+    } else if (arg == "--verify") {
+      verify = true;
+    } else if (arg == "--record" && i + 1 < argc) {
+      record_config.video_path = argv[++i];
+    } else if (arg == "--record-format" && i + 1 < argc) {
+      std::string format = argv[++i];
+      if (format == "y4m") {
+        record_config.video_format = AvRecorder::VideoFormat::kY4m;
+      } else if (format == "rgb") {
+        record_config.video_format = AvRecorder::VideoFormat::kRawRgb;
+      } else {
+        Usage();
+      }
+    } else if (arg == "--record-audio" && i + 1 < argc) {
+      record_config.audio_path = argv[++i];
+    } else if (arg == "--record-frames" && i + 1 < argc) {
+      frames_path = argv[++i];
+    } else if (movie_path.empty() && arg[0] != '-') {
+      movie_path = arg;
+    } else {
+      Usage();
+    }
+  }
+  if (rom_path.empty() || movie_path.empty()) {
+    Usage();
+  }
+
+  std::vector<std::uint8_t> rom = LoadBinary(rom_path);
+  std::ifstream ifs(movie_path, std::ios::binary);
+  if (ifs.fail()) {
+    Error("File cannot open: %s", movie_path.c_str());
+  }
+  // 記録するなら、JSONの出力と混ざらないように何かを出力する前に開く
+  std::unique_ptr<AvRecorder> recorder;
+  if (!record_config.video_path.empty() || !record_config.audio_path.empty()) {
+    recorder = std::make_unique<AvRecorder>(record_config);
+  }
+  std::ofstream frames_stream;
+  std::unique_ptr<FrameRecordWriter> frame_record;
+  if (!frames_path.empty()) {
+    frames_stream.open(frames_path, std::ios::binary);
+    if (frames_stream.fail()) {
+      Error("File cannot open: %s", frames_path.c_str());
+    }
+    frame_record = std::make_unique<FrameRecordWriter>(frames_stream);
+  }
+
+  std::vector<std::uint8_t> ram;
+  Cartridge cartridge(rom, &ram);
+  NullAudioSink null_audio;
+  AudioSink& audio = recorder != nullptr ? static_cast<AudioSink&>(*recorder)
+                                         : null_audio;
+  GameBoy gb(&cartridge, audio);
+  gb.CaptureSerialOutput();
+
+  MoviePlayer player(ifs);
+  if (!player.Open()) {
+    Error("Invalid movie file: %s", movie_path.c_str());
+  }
+  if (!player.Start(gb, rom)) {
+    Error("The movie was not recorded with this ROM: %s", rom_path.c_str());
+  }
+  player.set_verify(verify);
+
+  auto start = std::chrono::steady_clock::now();
+  while (player.Step(gb)) {
+    std::uint64_t vblank_ns = GetMonotonicNs();
+    if (recorder != nullptr) {
+      recorder->PushFrame(gb.GetPpuBuffer(), vblank_ns);
+    }
+    if (frame_record != nullptr) {
+      frame_record->PushFrame(gb.GetPpuBuffer(), vblank_ns);
+    }
+  }
+  if (recorder != nullptr) {
+    recorder->Finish();
+  }
+  if (frame_record != nullptr) {
+    frame_record->Finish();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  if (player.is_corrupted()) {
+    WarnUser("The movie is truncated or corrupted after frame %llu.",
+             static_cast<unsigned long long>(player.frame()));
+  }
+  std::cout << "{\"frames\":" << player.frame() << ",\"hash\":\""
+            << FrameHashToString(HashFrame(gb.GetPpuBuffer()))
+            << "\",\"serial\":\"" << EscapeJson(gb.GetSerialOutput())
+            << "\",\"seconds\":" << elapsed.count()
+            << ",\"fps\":" << (player.frame() / elapsed.count());
+  if (verify) {
+    std::cout << ",\"verified\":" << player.num_verified()
+              << ",\"mismatches\":" << player.num_mismatches()
+              << ",\"first_mismatch\":" << player.first_mismatch_frame();
+  }
+  std::cout << "}" << std::endl;
+
+  if (verify && (player.num_mismatches() != 0 || player.is_corrupted())) {
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    Usage();
+  }
+  std::string command = argv[1];
+  if (command == "record") {
+    return Record(argc, argv);
+  }
+  if (command == "play") {
+    return Play(argc, argv);
+  }
+  Usage();
+}
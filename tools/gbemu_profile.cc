@@ -0,0 +1,99 @@
+// ゲームのコードのどこでサイクルを消費しているかを調べるツール。
+//
+// ROMをヘッドレスで指定フレーム数だけ動かし、GuestProfilerで記録した
+// 呼び出しスタックごとのM-cycle数を折りたたみ形式（folded stacks）で書き出す。
+// 出力はflamegraph.plやspeedscopeにそのまま渡せる。
+// 標準出力にはサイクルを多く消費したPCを上位から表示する。
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "audio_sink.h"
+#include "cartridge.h"
+#include "gameboy.h"
+#include "guest_profiler.h"
+#include "key_input.h"
+#include "utils.h"
+
+using namespace gbemu;
+
+namespace {
+
+[[noreturn]] void Usage() {
+  Error(
+      "Usage: gbemu-profile --rom <rom_file> --frames <n> --out <folded_file>\n"
+      "                     [--input <input_script>] [--interval <mcycles>]\n"
+      "                     [--top <n>]");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string rom_path, out_path, script_path;
+  unsigned frames = 0;
+  unsigned top = 20;
+  GuestProfiler::Config config;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 == argc) {
+      Usage();
+    }
+    if (arg == "--rom") {
+      rom_path = argv[++i];
+    } else if (arg == "--frames") {
+      frames = std::atoi(argv[++i]);
+    } else if (arg == "--out") {
+      out_path = argv[++i];
+    } else if (arg == "--input") {
+      script_path = argv[++i];
+    } else if (arg == "--interval") {
+      config.sample_interval = std::atoi(argv[++i]);
+    } else if (arg == "--top") {
+      top = std::atoi(argv[++i]);
+    } else {
+      Usage();
+    }
+  }
+  if (rom_path.empty() || out_path.empty() || frames == 0 ||
+      config.sample_interval == 0) {
+    Usage();
+  }
+
+  std::vector<std::uint8_t> rom = LoadBinary(rom_path);
+  InputScript script;
+  if (!script_path.empty()) {
+    script = LoadInputScript(script_path);
+  }
+  std::vector<std::uint8_t> ram;
+  Cartridge cartridge(rom, &ram);
+  NullAudioSink audio;
+  GameBoy gb(&cartridge, audio);
+  gb.CaptureSerialOutput();
+  GuestProfiler profiler(cartridge, config);
+  gb.set_cpu_observer(&profiler);
+
+  std::size_t next_event = 0;
+  for (unsigned frame = 0; frame < frames; frame++) {
+    ApplyInputEvents(script, frame, next_event, gb);
+    gb.Step();
+  }
+
+  std::ofstream ofs(out_path);
+  if (ofs.fail()) {
+    Error("File cannot open: %s", out_path.c_str());
+  }
+  profiler.WriteFoldedStacks(ofs);
+
+  std::uint64_t total = profiler.total_cycles();
+  std::printf("%-10s %12s %7s\n", "bank:pc", "mcycles", "share");
+  for (const auto& [location, cycles] : profiler.GetHotLocations(top)) {
+    std::printf("%-10s %12llu %6.2f%%\n", location.c_str(),
+                static_cast<unsigned long long>(cycles),
+                total > 0 ? cycles * 100.0 / total : 0.0);
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+// ベンチマーク用のROMを生成してファイルに書き出すツール。
+// 出力先のディレクトリに<名前>.gbとして書き出す。
+// 名前を指定するとそのROMだけを書き出す。
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "bench_roms.h"
+#include "utils.h"
+
+using namespace gbemu;
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    Error("Usage: gbemu-romgen <out_dir> [<name>...]");
+  }
+  std::filesystem::path out_dir = argv[1];
+  std::vector<std::string> names(argv + 2, argv + argc);
+
+  std::vector<BenchRom> roms = BuildBenchRoms();
+  for (const std::string& name : names) {
+    bool found = false;
+    for (const BenchRom& rom : roms) {
+      found |= rom.name == name;
+    }
+    if (!found) {
+      Error("Unknown ROM name: %s", name.c_str());
+    }
+  }
+
+  std::filesystem::create_directories(out_dir);
+  for (const BenchRom& rom : roms) {
+    if (!names.empty() &&
+        std::find(names.begin(), names.end(), rom.name) == names.end()) {
+      continue;
+    }
+    std::string path = (out_dir / (rom.name + ".gb")).string();
+    OutputBinary(path, rom.rom);
+    std::printf("%s\n", path.c_str());
+  }
+  return 0;
+}
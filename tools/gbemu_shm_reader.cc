@@ -0,0 +1,122 @@
+// gbemu --shm-exportが共有メモリに書き込む画面を読み出すツール。
+// 読み出したフレーム数、読み出しが遅れて取りこぼしたフレーム数と、
+// エミュレータがフレームを完成させてから読み出せるまでの遅延を表示する。
+// 書き込みが5秒途絶えたら、それまでに読んだ分を表示して終了する。
+// 共有メモリの形式はshm_frame_ring.hを参照。
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "png_writer.h"
+#include "shm_frame_ring.h"
+#include "utils.h"
+
+using namespace gbemu;
+
+namespace {
+
+// この時間だけ新しいフレームが書かれなければ終了する
+constexpr std::uint64_t kTimeoutNs = 5'000'000'000;
+
+[[noreturn]] void Usage() {
+  Error(
+      "Usage: gbemu-shm-reader --name <name> [--frames <n>] "
+      "[--poll-us <n>] [--png <file>]");
+}
+
+// 遅延（ナノ秒）の分布を表示する。
+void PrintLatency(const char* label, std::vector<std::uint64_t>& latencies) {
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  double sum = 0;
+  for (std::uint64_t latency : latencies) {
+    sum += latency;
+  }
+  auto percentile = [&latencies](double p) {
+    return latencies[static_cast<std::size_t>(p * (latencies.size() - 1))] /
+           1000.0;
+  };
+  std::printf("%-16s avg %8.1f us  p50 %8.1f us  p99 %8.1f us  max %8.1f us\n",
+              label, sum / latencies.size() / 1000.0, percentile(0.5),
+              percentile(0.99), latencies.back() / 1000.0);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string name;
+  std::string png_path;
+  unsigned frames = 600;
+  unsigned poll_us = 100;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 == argc) {
+      Usage();
+    }
+    if (arg == "--name") {
+      name = argv[++i];
+    } else if (arg == "--frames") {
+      frames = std::atoi(argv[++i]);
+    } else if (arg == "--poll-us") {
+      poll_us = std::atoi(argv[++i]);
+    } else if (arg == "--png") {
+      png_path = argv[++i];
+    } else {
+      Usage();
+    }
+  }
+  if (name.empty() || frames == 0) {
+    Usage();
+  }
+
+  ShmFrameReader reader;
+  if (!reader.Open(name)) {
+    Error("Cannot open the shared memory: %s", name.c_str());
+  }
+
+  // 開いた時点より後に完成したフレームから読む
+  std::uint64_t next = reader.GetLatestFrame() + 1;
+  std::uint64_t dropped = 0;
+  // VBlankから書き込み完了まで、VBlankから読み出し完了までの遅延
+  std::vector<std::uint64_t> publish_latencies;
+  std::vector<std::uint64_t> read_latencies;
+  ShmFrameReader::Frame frame{};
+  unsigned count = 0;
+  std::uint64_t last_read_ns = GetMonotonicNs();
+  while (count < frames) {
+    if (!reader.Read(next, frame)) {
+      // 次のフレームはまだ書かれていない
+      if (GetMonotonicNs() - last_read_ns > kTimeoutNs) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(poll_us));
+      continue;
+    }
+    std::uint64_t now = GetMonotonicNs();
+    last_read_ns = now;
+    dropped += frame.frame_number - next;
+    next = frame.frame_number + 1;
+    publish_latencies.push_back(frame.publish_ns - frame.vblank_ns);
+    read_latencies.push_back(now - frame.vblank_ns);
+    count++;
+  }
+
+  std::printf("frames: %u read, %llu dropped (last frame %llu)\n", count,
+              static_cast<unsigned long long>(dropped),
+              static_cast<unsigned long long>(frame.frame_number));
+  PrintLatency("vblank->publish", publish_latencies);
+  PrintLatency("vblank->read", read_latencies);
+
+  if (!png_path.empty() && count != 0) {
+    WriteFramePng(png_path, frame.pixels);
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+// テストROM（Blarggのcpu_instrsなど）をヘッドレスで実行して合否を判定するツール。
+//
+// 各ROMを速度制限なしで動かし、シリアル出力に成功・失敗のパターンが現れるか、
+// 画面のハッシュ値が指定した値になるか、サイクル数の上限に達した時点で止める。
+// 結果はROMごとにJSON Linesで標準出力に、集計は標準エラー出力に書き出し、
+// 成功しなかったROMがあれば終了コード1で終了する。
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "frame_hash.h"
+#include "rom_test.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+using namespace gbemu;
+
+namespace {
+
+std::string ResultToJson(const std::string& rom_path,
+                         const RomTestResult& result) {
+  std::ostringstream oss;
+  oss << "{\"rom\":\"" << EscapeJson(rom_path) << "\",\"status\":\""
+      << RomTestResult::GetStatusName(result.status) << "\",\"reason\":\""
+      << EscapeJson(result.reason) << "\",\"frames\":" << result.frames
+      << ",\"cycles\":" << result.cycles << ",\"hash\":\""
+      << FrameHashToString(result.frame_hash) << "\",\"serial\":\""
+      << EscapeJson(result.serial_output)
+      << "\",\"seconds\":" << result.seconds << "}";
+  return oss.str();
+}
+
+[[noreturn]] void Usage() {
+  Error(
+      "Usage: gbemu-test [options] <rom_file>...\n"
+      "  --pass <pattern>     serial output meaning success (repeatable, "
+      "default: Passed)\n"
+      "  --fail <pattern>     serial output meaning failure (repeatable, "
+      "default: Failed)\n"
+      "  --frame-hash <hex>   frame hash meaning success\n"
+      "  --max-seconds <s>    emulated time limit (default: 60)\n"
+      "  --threads <n>        number of worker threads (default: all cores)");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  RomTestConfig config;
+  bool has_pass = false, has_fail = false;
+  unsigned num_threads = ThreadPool::GetHardwareConcurrency();
+  std::vector<std::string> rom_paths;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--pass" && has_value) {
+      // 指定したら既定のパターンは使わない
+      if (!has_pass) {
+        config.pass_patterns.clear();
+        has_pass = true;
+      }
+      config.pass_patterns.push_back(argv[++i]);
+    } else if (arg == "--fail" && has_value) {
+      if (!has_fail) {
+        config.fail_patterns.clear();
+        has_fail = true;
+      }
+      config.fail_patterns.push_back(argv[++i]);
+    } else if (arg == "--frame-hash" && has_value) {
+      config.pass_frame_hash = std::strtoull(argv[++i], nullptr, 16);
+    } else if (arg == "--max-seconds" && has_value) {
+      config.max_cycles =
+          static_cast<std::uint64_t>(std::atof(argv[++i]) * 4194304);
+    } else if (arg == "--threads" && has_value) {
+      num_threads = std::atoi(argv[++i]);
+      if (num_threads == 0) {
+        Usage();
+      }
+    } else if (arg[0] != '-') {
+      rom_paths.push_back(arg);
+    } else {
+      Usage();
+    }
+  }
+  if (rom_paths.empty()) {
+    Usage();
+  }
+
+  std::vector<std::vector<std::uint8_t>> roms;
+  for (const std::string& path : rom_paths) {
+    roms.push_back(LoadBinary(path));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<RomTestResult> results(roms.size());
+  {
+    ThreadPool pool(num_threads);
+    for (std::size_t i = 0; i < roms.size(); i++) {
+      pool.Submit([&, i] { results[i] = RunRomTest(roms[i], config); });
+    }
+    pool.Wait();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  unsigned num_passed = 0;
+  for (std::size_t i = 0; i < results.size(); i++) {
+    std::cout << ResultToJson(rom_paths[i], results[i]) << "\n";
+    if (results[i].status == RomTestResult::Status::kPassed) {
+      num_passed++;
+    }
+  }
+  std::cout << std::flush;
+  std::fprintf(stderr, "%u/%zu passed in %.3f s\n", num_passed,
+               results.size(), elapsed.count());
+  return num_passed == results.size() ? 0 : 1;
+}